@@ -0,0 +1,146 @@
+/**
+ * @file   briter_encoder.c
+ * @brief  Source file of transport independent Briter encoder interface.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder.h"
+#include <stddef.h>
+
+#ifdef BRITER_ENCODER_USE_RS485
+const Briter_Encoder_Ops_t BRITER_Encoder_RS485_Ops = {
+    BRITER_Encoder_RS485_Request,
+    BRITER_Encoder_RS485_GetLatest,
+    BRITER_Encoder_RS485_SetAddress,
+    BRITER_Encoder_RS485_SetBaudrate,
+    BRITER_Encoder_RS485_SetDataMode,
+    BRITER_Encoder_RS485_SetReturnTime,
+    BRITER_Encoder_RS485_SetDirection,
+    BRITER_Encoder_RS485_SetZero,
+};
+
+HAL_StatusTypeDef BRITER_Encoder_Init_RS485(Briter_Encoder_Dev_t *dev, Briter_Encoder_t *handler) {
+    if (!dev || !handler)
+	return HAL_ERROR;
+    dev->ops = &BRITER_Encoder_RS485_Ops;
+    dev->handle = handler;
+    dev->last_sequence = handler->sequence;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_Request(void *handle) {
+    return BRITER_RS485_GetEncoderValue_DMA((Briter_Encoder_t*) handle);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_GetLatest(const void *handle, Briter_Sample_t *sample) {
+    const Briter_Encoder_t *handler = (const Briter_Encoder_t*) handle;
+    //Value is written from UART interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sample->position = handler->encoder_value;
+    sample->timestamp = handler->timestamp;
+    sample->sequence = handler->sequence;
+    __set_PRIMASK(primask);
+    return sample->sequence ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetAddress(void *handle, uint8_t address) {
+    return BRITER_RS485_SetAddress((Briter_Encoder_t*) handle, address);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetBaudrate(void *handle, uint32_t bps) {
+    for (uint8_t i = RS485_ENC_BAUDRATE_9600; i <= RS485_ENC_BAUDRATE_115200; i++) {
+	if (BRITER_RS485_BaudrateValue((RS485_Enc_Baudrate_e) i) == bps)
+	    return BRITER_RS485_SetBaudrate((Briter_Encoder_t*) handle, (RS485_Enc_Baudrate_e) i);
+    }
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetDataMode(void *handle, Briter_Encoder_Mode_e mode) {
+    return BRITER_RS485_SetDataMode((Briter_Encoder_t*) handle,
+	    mode == BRITER_ENCODER_MODE_BACKHAUL ? RS485_ENC_MODE_BACKHAUL : RS485_ENC_MODE_QUERY);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetReturnTime(void *handle, uint16_t time) {
+    return BRITER_RS485_SetReturnTime((Briter_Encoder_t*) handle, time);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetDirection(void *handle, Briter_Encoder_Direction_e direction) {
+    return BRITER_RS485_SetDirection((Briter_Encoder_t*) handle,
+	    direction == BRITER_ENCODER_DIRECTION_COUNTERCLOCKWISE ? RS485_ENC_DIRECTION_COUNTERCLOCKWISE : RS485_ENC_DIRECTION_CLOCKWISE);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetZero(void *handle) {
+    return BRITER_RS485_SetZero((Briter_Encoder_t*) handle);
+}
+#endif
+
+#ifdef BRITER_ENCODER_USE_CAN
+const Briter_Encoder_Ops_t BRITER_Encoder_CAN_Ops = {
+    BRITER_Encoder_CAN_Request,
+    BRITER_Encoder_CAN_GetLatest,
+    BRITER_Encoder_CAN_SetAddress,
+    BRITER_Encoder_CAN_SetBaudrate,
+    BRITER_Encoder_CAN_SetDataMode,
+    BRITER_Encoder_CAN_SetReturnTime,
+    BRITER_Encoder_CAN_SetDirection,
+    BRITER_Encoder_CAN_SetZero,
+};
+
+HAL_StatusTypeDef BRITER_Encoder_Init_CAN(Briter_Encoder_Dev_t *dev, Briter_CAN_Handler_t *handler) {
+    if (!dev || !handler)
+	return HAL_ERROR;
+    dev->ops = &BRITER_Encoder_CAN_Ops;
+    dev->handle = handler;
+    dev->last_sequence = handler->sequence;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_Request(void *handle) {
+    return BRITER_CAN_ReadValue((Briter_CAN_Handler_t*) handle);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_GetLatest(const void *handle, Briter_Sample_t *sample) {
+    const Briter_CAN_Handler_t *handler = (const Briter_CAN_Handler_t*) handle;
+    //Value is written from CAN interrupt
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    sample->position = handler->position;
+    sample->timestamp = handler->timestamp;
+    sample->sequence = handler->sequence;
+    __set_PRIMASK(primask);
+    return sample->sequence ? HAL_OK : HAL_ERROR;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetAddress(void *handle, uint8_t address) {
+    return BRITER_CAN_SetAddress((Briter_CAN_Handler_t*) handle, address);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetBaudrate(void *handle, uint32_t bps) {
+    for (uint8_t i = BRITER_CAN_BAUDRATE_500K; i <= BRITER_CAN_BAUDRATE_100K; i++) {
+	if (BRITER_CAN_BaudrateValue((Briter_CAN_Baudrate_e) i) == bps)
+	    return BRITER_CAN_SetBaudrate((Briter_CAN_Handler_t*) handle, (Briter_CAN_Baudrate_e) i);
+    }
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetDataMode(void *handle, Briter_Encoder_Mode_e mode) {
+    return BRITER_CAN_SetDataMode((Briter_CAN_Handler_t*) handle,
+	    mode == BRITER_ENCODER_MODE_BACKHAUL ? BRITER_CAN_MODE_BACKHAUL : BRITER_CAN_MODE_QUERY);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetReturnTime(void *handle, uint16_t time) {
+    return BRITER_CAN_SetReturnTime((Briter_CAN_Handler_t*) handle, time);
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetDirection(void *handle, Briter_Encoder_Direction_e direction) {
+    //No direction command in CAN protocol
+    (void) handle;
+    (void) direction;
+    return HAL_ERROR;
+}
+
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetZero(void *handle) {
+    return BRITER_CAN_SetZero((Briter_CAN_Handler_t*) handle);
+}
+#endif
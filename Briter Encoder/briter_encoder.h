@@ -0,0 +1,237 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder.h
+  * @author  Ang Chin Xian
+  * @brief   Transport independent interface of Briter encoder.
+  *          One request/poll/latest sample and configuration API over
+  *          briter_encoder_rs485.h and briter_encoder_can.h handler.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Initialize RS485 or CAN handler with its own driver, then bind it to a
+      Briter_Encoder_Dev_t with BRITER_Encoder_Init_RS485()/_Init_CAN()
+  2. Receive path is still wired by the transport driver, refer to its how to
+      use section (RS485 DMA callback, bus scheduler, CAN dispatch)
+  3. Reading
+      - BRITER_Encoder_Request() send a read request without blocking
+      - BRITER_Encoder_Poll() return 1 once per new value
+      - BRITER_Encoder_GetLatest() return last value any time
+      - Position is decoded in the driver, byte order is handled there
+  4. Error is always reported as HAL status, never inside position
+  5. Binding
+      - Default, call go through Briter_Encoder_Ops_t table of the device,
+	RS485 and CAN encoder can be mixed
+      - Define BRITER_ENCODER_STATIC_RS485 or BRITER_ENCODER_STATIC_CAN for a
+	single transport build, call go straight to that transport and the
+	other driver is not needed
+  6. Operation not supported by a transport return HAL_ERROR, e.g. direction
+      over CAN
+*/
+#ifndef BRITER_ENCODER_H_
+#define BRITER_ENCODER_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+#include "briter_encoder_sample.h"
+
+#if defined(BRITER_ENCODER_STATIC_RS485) && defined(BRITER_ENCODER_STATIC_CAN)
+#error "Select only one of BRITER_ENCODER_STATIC_RS485 and BRITER_ENCODER_STATIC_CAN"
+#endif
+
+#if !defined(BRITER_ENCODER_STATIC_CAN)
+#include "briter_encoder_rs485.h"
+#define BRITER_ENCODER_USE_RS485
+#endif
+#if !defined(BRITER_ENCODER_STATIC_RS485)
+#include "briter_encoder_can.h"
+#define BRITER_ENCODER_USE_CAN
+#endif
+
+/** Data mode*/
+typedef enum {
+    BRITER_ENCODER_MODE_QUERY = 0x00, /*!< Encoder answer request only*/
+    BRITER_ENCODER_MODE_BACKHAUL, /*!< Encoder push value by itself*/
+} Briter_Encoder_Mode_e;
+
+/** Increasing direction*/
+typedef enum {
+    BRITER_ENCODER_DIRECTION_CLOCKWISE = 0x00,
+    BRITER_ENCODER_DIRECTION_COUNTERCLOCKWISE,
+} Briter_Encoder_Direction_e;
+
+/** Transport operation, member name match BRITER_Encoder_<transport>_<op>()*/
+typedef struct {
+    HAL_StatusTypeDef (*Request)(void *handle);
+    HAL_StatusTypeDef (*GetLatest)(const void *handle, Briter_Sample_t *sample);
+    HAL_StatusTypeDef (*SetAddress)(void *handle, uint8_t address);
+    HAL_StatusTypeDef (*SetBaudrate)(void *handle, uint32_t bps);
+    HAL_StatusTypeDef (*SetDataMode)(void *handle, Briter_Encoder_Mode_e mode);
+    HAL_StatusTypeDef (*SetReturnTime)(void *handle, uint16_t time);
+    HAL_StatusTypeDef (*SetDirection)(void *handle, Briter_Encoder_Direction_e direction);
+    HAL_StatusTypeDef (*SetZero)(void *handle);
+} Briter_Encoder_Ops_t;
+
+/** Encoder device*/
+typedef struct {
+    const Briter_Encoder_Ops_t *ops; /*!< Unused with static binding*/
+    void *handle; /*!< Briter_Encoder_t or Briter_CAN_Handler_t*/
+    uint32_t last_sequence; /*!< Sequence of last value given by BRITER_Encoder_Poll()*/
+} Briter_Encoder_Dev_t;
+
+#if defined(BRITER_ENCODER_STATIC_RS485)
+#define BRITER_ENCODER_OP(dev, op)	BRITER_Encoder_RS485_##op
+#elif defined(BRITER_ENCODER_STATIC_CAN)
+#define BRITER_ENCODER_OP(dev, op)	BRITER_Encoder_CAN_##op
+#else
+#define BRITER_ENCODER_OP(dev, op)	((dev)->ops->op)
+#endif
+
+/** @defgroup Briter_Encoder_Transport_Functions
+ * @{
+ */
+#ifdef BRITER_ENCODER_USE_RS485
+extern const Briter_Encoder_Ops_t BRITER_Encoder_RS485_Ops;
+HAL_StatusTypeDef BRITER_Encoder_RS485_Request(void *handle);
+HAL_StatusTypeDef BRITER_Encoder_RS485_GetLatest(const void *handle, Briter_Sample_t *sample);
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetAddress(void *handle, uint8_t address);
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetBaudrate(void *handle, uint32_t bps);
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetDataMode(void *handle, Briter_Encoder_Mode_e mode);
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetReturnTime(void *handle, uint16_t time);
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetDirection(void *handle, Briter_Encoder_Direction_e direction);
+HAL_StatusTypeDef BRITER_Encoder_RS485_SetZero(void *handle);
+#endif
+#ifdef BRITER_ENCODER_USE_CAN
+extern const Briter_Encoder_Ops_t BRITER_Encoder_CAN_Ops;
+HAL_StatusTypeDef BRITER_Encoder_CAN_Request(void *handle);
+HAL_StatusTypeDef BRITER_Encoder_CAN_GetLatest(const void *handle, Briter_Sample_t *sample);
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetAddress(void *handle, uint8_t address);
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetBaudrate(void *handle, uint32_t bps);
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetDataMode(void *handle, Briter_Encoder_Mode_e mode);
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetReturnTime(void *handle, uint16_t time);
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetDirection(void *handle, Briter_Encoder_Direction_e direction);
+HAL_StatusTypeDef BRITER_Encoder_CAN_SetZero(void *handle);
+#endif
+/**
+ * @}
+ */
+
+/** @defgroup Briter_Encoder_Exported_Functions
+ * @{
+ */
+#ifdef BRITER_ENCODER_USE_RS485
+/**
+* @brief  Bind RS485 handler to device.
+* @param  dev: encoder device
+* @param  handler: initialized RS485 handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Encoder_Init_RS485(Briter_Encoder_Dev_t *dev, Briter_Encoder_t *handler);
+#endif
+
+#ifdef BRITER_ENCODER_USE_CAN
+/**
+* @brief  Bind CAN handler to device.
+* @param  dev: encoder device
+* @param  handler: initialized CAN handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Encoder_Init_CAN(Briter_Encoder_Dev_t *dev, Briter_CAN_Handler_t *handler);
+#endif
+
+/**
+* @brief  Send read request, value arrive through transport receive path.
+* @param  dev: encoder device
+* @retval HAL status
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_Request(Briter_Encoder_Dev_t *dev) {
+    return BRITER_ENCODER_OP(dev, Request)(dev->handle);
+}
+
+/**
+* @brief  Get last received value.
+* @param  dev: encoder device
+* @param  sample: position, timestamp and number of value received
+* @retval HAL status, HAL_ERROR if no value received yet
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_GetLatest(const Briter_Encoder_Dev_t *dev, Briter_Sample_t *sample) {
+    return BRITER_ENCODER_OP(dev, GetLatest)(dev->handle, sample);
+}
+
+/**
+* @brief  Get value received since last poll.
+* @param  dev: encoder device
+* @param  sample: position, timestamp and number of value received
+* @retval 1 if new value, 0 if none
+*/
+static inline uint8_t BRITER_Encoder_Poll(Briter_Encoder_Dev_t *dev, Briter_Sample_t *sample) {
+    if (BRITER_Encoder_GetLatest(dev, sample) != HAL_OK || sample->sequence == dev->last_sequence)
+	return 0;
+    dev->last_sequence = sample->sequence;
+    return 1;
+}
+
+/**
+* @brief  Change encoder address, handler follow new address on success.
+* @param  dev: encoder device
+* @param  address: new address
+* @retval HAL status
+* @note   Over CAN call BRITER_CAN_ConfigFilter() again, refer to BRITER_CAN_SetAddress()
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_SetAddress(Briter_Encoder_Dev_t *dev, uint8_t address) {
+    return BRITER_ENCODER_OP(dev, SetAddress)(dev->handle, address);
+}
+
+/**
+* @brief  Change encoder baudrate, host peripheral must be changed by user.
+* @param  dev: encoder device
+* @param  bps: bit per second, must be one supported by transport
+* @retval HAL status
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_SetBaudrate(Briter_Encoder_Dev_t *dev, uint32_t bps) {
+    return BRITER_ENCODER_OP(dev, SetBaudrate)(dev->handle, bps);
+}
+
+/**
+* @brief  Set data mode to query or backhaul.
+* @param  dev: encoder device
+* @param  mode: refer to ::Briter_Encoder_Mode_e
+* @retval HAL status
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_SetDataMode(Briter_Encoder_Dev_t *dev, Briter_Encoder_Mode_e mode) {
+    return BRITER_ENCODER_OP(dev, SetDataMode)(dev->handle, mode);
+}
+
+/**
+* @brief  Set backhaul return time.
+* @param  dev: encoder device
+* @param  time: 0-65535 ms
+* @retval HAL status
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_SetReturnTime(Briter_Encoder_Dev_t *dev, uint16_t time) {
+    return BRITER_ENCODER_OP(dev, SetReturnTime)(dev->handle, time);
+}
+
+/**
+* @brief  Set increasing direction.
+* @param  dev: encoder device
+* @param  direction: refer to ::Briter_Encoder_Direction_e
+* @retval HAL status
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_SetDirection(Briter_Encoder_Dev_t *dev, Briter_Encoder_Direction_e direction) {
+    return BRITER_ENCODER_OP(dev, SetDirection)(dev->handle, direction);
+}
+
+/**
+* @brief  Set current position as zero.
+* @param  dev: encoder device
+* @retval HAL status
+*/
+static inline HAL_StatusTypeDef BRITER_Encoder_SetZero(Briter_Encoder_Dev_t *dev) {
+    return BRITER_ENCODER_OP(dev, SetZero)(dev->handle);
+}
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_H_ */
@@ -4,90 +4,577 @@
  */
 
 #include <briter_encoder_can.h>
-#include <stdlib.h>
+#include <briter_encoder_can_group.h>
+#include <briter_encoder_time.h>
+#include <briter_encoder_profile.h>
 #include <string.h>
 
+/** Data length of each command, index by (command - 1)*/
+static const uint8_t can_cmd_length[BRITER_CAN_CMD_COUNT] = {
+	4,	//BRITER_CAN_GET_VALUE
+	4,	//BRITER_CAN_SET_ID
+	4,	//BRITER_CAN_SET_BAUDRATE
+	4,	//BRITER_CAN_SET_MODE
+	5,	//BRITER_CAN_SET_RETURN_TIME, 16 bit little endian
+	4,	//BRITER_CAN_SET_ZERO
+};
+
+/** Frame waiting for free mailbox, ID and header come from handler*/
+typedef struct {
+	Briter_CAN_Handler_t* handler;
+	uint8_t data[BRITER_CAN_FRAME_SIZE];
+	uint8_t dlc;
+} CAN_Tx_Entry_t;
+
+/** Fixed capacity FIFO of one priority*/
+typedef struct {
+	CAN_Tx_Entry_t entry[BRITER_CAN_TX_QUEUE_SIZE];
+	uint8_t head;
+	uint8_t count;
+} CAN_Tx_Queue_t;
+
+/** Encoder registered on one CAN peripheral, index by address*/
+typedef struct {
+	CAN_HandleTypeDef* hcan;
+	Briter_CAN_Handler_t* handler[BRITER_CAN_MAX_ADDRESS];
+	uint8_t queue_enabled;
+	CAN_Tx_Queue_t queue[BRITER_CAN_PRIORITY_COUNT];	/*!<Index by ::Briter_CAN_Priority_e*/
+	Briter_CAN_Queue_Stats_t queue_stats;
+	Briter_CAN_Handler_t* tx_owner[3];	/*!<Read request in mailbox 0 to 2, for its timestamp*/
+} CAN_Registry_t;
+
+static CAN_Registry_t can_registry[BRITER_CAN_MAX_BUS];
+
 /** @defgroup briter_encoder_rs485 Private Functions
  * @{
  */
-static HAL_StatusTypeDef CAN_Tx(Briter_CAN_Handler_t* handler,Briter_CAN_Command_e cmd, uint8_t data_length, uint16_t selection);
+static CAN_Registry_t* CAN_Registry_Find(const CAN_HandleTypeDef* hcan);
+static CAN_Registry_t* CAN_Registry_Claim(CAN_HandleTypeDef* hcan);
+static HAL_StatusTypeDef CAN_Submit(Briter_CAN_Handler_t* handler, const uint8_t* data, uint8_t dlc);
+static HAL_StatusTypeDef CAN_Mailbox_Add(Briter_CAN_Handler_t* handler, const uint8_t* data, uint8_t dlc);
+static void CAN_Queue_Drain(CAN_Registry_t* registry);
+static void CAN_Shadow_Record(Briter_CAN_Handler_t* handler, const uint8_t* data, uint8_t dlc, HAL_StatusTypeDef status);
+static HAL_StatusTypeDef CAN_Filter_Write(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* filter, uint16_t* id, uint8_t count);
+static void CAN_Frame_Construct(Briter_CAN_Handler_t* handler);
+static HAL_StatusTypeDef CAN_Tx(Briter_CAN_Handler_t* handler,Briter_CAN_Command_e cmd, uint16_t selection);
 /**
  * @}
  */
 
 HAL_StatusTypeDef BRITER_CAN_Init(Briter_CAN_Handler_t* handler,uint8_t address, CAN_HandleTypeDef* hcan){
-	memset(handler, 0, sizeof(Briter_CAN_Handler_t));
 	if(handler == NULL || hcan == NULL)
 		return HAL_ERROR;
+	memset(handler, 0, sizeof(Briter_CAN_Handler_t));
 	handler->hcan = hcan;
 	handler->address = address;
+	handler->latest = BRITER_CAN_LATEST_NONE;
+	handler->model = BRITER_MODEL(CAN_4096X24);
+	CAN_Frame_Construct(handler);
+	BRITER_Shadow_Init(&handler->shadow);
 	return HAL_OK;
 }
 
 HAL_StatusTypeDef BRITER_CAN_ReadValue(Briter_CAN_Handler_t* handler){
-	return CAN_Tx(handler, BRITER_CAN_GET_VALUE, 4, 0);
+	BRITER_PROFILE_BEGIN();
+	//Read frame carry no selection, send template as it is
+	HAL_StatusTypeDef status = CAN_Submit(handler, handler->tx_frame[BRITER_CAN_GET_VALUE - 1], can_cmd_length[BRITER_CAN_GET_VALUE - 1]);
+	BRITER_PROFILE_END(BRITER_PROFILE_CAN_TX);
+	return status;
 }
 
 uint32_t BRITER_CAN_GetEncoderValue_Callback(Briter_CAN_Handler_t* handler, uint8_t *pData){
-	if(handler->address != pData[1] || pData[0] != 0x07 || pData[2] != BRITER_CAN_GET_VALUE)
+	if(handler->address != pData[1] || pData[0] != 0x07 || pData[2] != BRITER_CAN_GET_VALUE){
+		BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_MISMATCH);
 		return BRITER_CAN_ERROR;
-	handler->position = pData[3] << (0 * 8) | pData[4] << (1 * 8) | pData[5] << (2 * 8)
-					| pData[6] << (3 * 8);
+	}
+	handler->position = handler->model->decode(pData);
+	Briter_Sample_t sample;
+	sample.position = handler->position;
+	sample.timestamp = BRITER_Encoder_GetTick();
+	sample.sequence = handler->sequence++;
+	handler->timestamp = sample.timestamp;
+	//Single store so task always see matching position and timestamp
+	handler->latest = (sample.timestamp << BRITER_CAN_LATEST_POSITION_BITS) | (sample.position & BRITER_CAN_LATEST_POSITION_MASK);
+	BRITER_STATS_DONE(&handler->stats, sample.timestamp);
+	if(handler->ring != NULL)
+		BRITER_Sample_Ring_Push(handler->ring, &sample);
+	if(handler->group != NULL)
+		BRITER_CAN_Group_Receive(handler);
 	return handler->position;
 }
 
+HAL_StatusTypeDef BRITER_CAN_SetModel(Briter_CAN_Handler_t* handler, const Briter_Model_t* model){
+	//Latest sample pack position with timestamp in one word
+	if(model == NULL || model->modulus > BRITER_CAN_LATEST_POSITION_MASK + 1)
+		return HAL_ERROR;
+	handler->model = model;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_AttachRing(Briter_CAN_Handler_t* handler, Briter_Sample_Ring_t* ring){
+	if(handler == NULL)
+		return HAL_ERROR;
+	if(ring != NULL)
+		BRITER_Sample_Ring_Init(ring);
+	handler->ring = ring;
+	return HAL_OK;
+}
+
+uint8_t BRITER_CAN_ReadSample(Briter_CAN_Handler_t* handler, Briter_Sample_t* sample){
+	if(handler->ring == NULL)
+		return 0;
+	return BRITER_Sample_Ring_Pop(handler->ring, sample);
+}
+
+HAL_StatusTypeDef BRITER_CAN_GetLatest(const Briter_CAN_Handler_t* handler, uint32_t* position, uint32_t* age){
+	uint32_t latest = handler->latest;
+	if(latest == BRITER_CAN_LATEST_NONE)
+		return HAL_ERROR;
+	*position = latest & BRITER_CAN_LATEST_POSITION_MASK;
+	*age = (BRITER_Encoder_GetTick() - (latest >> BRITER_CAN_LATEST_POSITION_BITS)) & BRITER_CAN_LATEST_AGE_MASK;
+	return HAL_OK;
+}
+
+#ifdef BRITER_ENCODER_STATS
+void BRITER_CAN_GetStats(const Briter_CAN_Handler_t* handler, Briter_Stats_t* stats){
+	BRITER_Stats_Snapshot(&handler->stats, stats);
+}
+
+void BRITER_CAN_ResetStats(Briter_CAN_Handler_t* handler){
+	BRITER_Stats_Reset(&handler->stats);
+}
+#endif
+
+HAL_StatusTypeDef BRITER_CAN_Register(Briter_CAN_Handler_t* handler){
+	if(handler == NULL || handler->hcan == NULL || handler->address >= BRITER_CAN_MAX_ADDRESS)
+		return HAL_ERROR;
+	CAN_Registry_t* registry = CAN_Registry_Claim(handler->hcan);
+	if(registry == NULL)
+		return HAL_ERROR;
+	if(registry->handler[handler->address] != NULL && registry->handler[handler->address] != handler)
+		return HAL_ERROR;
+	registry->handler[handler->address] = handler;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_Unregister(Briter_CAN_Handler_t* handler){
+	if(handler == NULL || handler->address >= BRITER_CAN_MAX_ADDRESS)
+		return HAL_ERROR;
+	CAN_Registry_t* registry = CAN_Registry_Find(handler->hcan);
+	if(registry == NULL || registry->handler[handler->address] != handler)
+		return HAL_ERROR;
+	registry->handler[handler->address] = NULL;
+	return HAL_OK;
+}
+
+Briter_CAN_Handler_t* BRITER_CAN_Dispatch(CAN_HandleTypeDef* hcan, const CAN_RxHeaderTypeDef* header, uint8_t* pData){
+	if(header->IDE != CAN_ID_STD || header->DLC < 3 || pData[1] >= BRITER_CAN_MAX_ADDRESS)
+		return NULL;
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL)
+		return NULL;
+	Briter_CAN_Handler_t* handler = registry->handler[pData[1]];
+	if(handler == NULL)
+		return NULL;
+	if(pData[2] == BRITER_CAN_GET_VALUE && header->DLC >= 7){
+		handler->rx_time = (uint16_t)header->Timestamp;
+		BRITER_CAN_GetEncoderValue_Callback(handler, pData);
+	}
+	return handler;
+}
+
+HAL_StatusTypeDef BRITER_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, uint32_t fifo, uint32_t first_bank, uint32_t bank_count){
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL)
+		return HAL_ERROR;
+	CAN_FilterTypeDef filter;
+	filter.FilterMode = CAN_FILTERMODE_IDLIST;
+	filter.FilterScale = CAN_FILTERSCALE_16BIT;
+	filter.FilterFIFOAssignment = fifo;
+	filter.FilterActivation = ENABLE;
+	filter.SlaveStartFilterBank = BRITER_CAN_SLAVE_START_FILTER_BANK;
+
+	uint16_t id[4];
+	uint8_t count = 0;
+	filter.FilterBank = first_bank;
+	for(uint32_t address = 0; address < BRITER_CAN_MAX_ADDRESS; address++){
+		if(registry->handler[address] == NULL)
+			continue;
+		id[count++] = (uint16_t)address;
+		if(count < 4)
+			continue;
+		if(filter.FilterBank >= first_bank + bank_count || CAN_Filter_Write(hcan, &filter, id, count) != HAL_OK)
+			return HAL_ERROR;
+		filter.FilterBank++;
+		count = 0;
+	}
+	if(count){
+		if(filter.FilterBank >= first_bank + bank_count || CAN_Filter_Write(hcan, &filter, id, count) != HAL_OK)
+			return HAL_ERROR;
+		filter.FilterBank++;
+	}
+	//Bank left from earlier call with more encoder would still accept old ID
+	filter.FilterActivation = DISABLE;
+	for(; filter.FilterBank < first_bank + bank_count; filter.FilterBank++){
+		if(HAL_CAN_ConfigFilter(hcan, &filter) != HAL_OK)
+			return HAL_ERROR;
+	}
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_TxQueue_Enable(CAN_HandleTypeDef* hcan){
+	CAN_Registry_t* registry = CAN_Registry_Claim(hcan);
+	if(registry == NULL)
+		return HAL_ERROR;
+	if(HAL_CAN_ActivateNotification(hcan, CAN_IT_TX_MAILBOX_EMPTY) != HAL_OK)
+		return HAL_ERROR;
+	registry->queue_enabled = 1;
+	return HAL_OK;
+}
+
+void BRITER_CAN_TxQueue_Callback(CAN_HandleTypeDef* hcan){
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL || !registry->queue_enabled)
+		return;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	CAN_Queue_Drain(registry);
+	__set_PRIMASK(primask);
+}
+
+void BRITER_CAN_TxComplete_Callback(CAN_HandleTypeDef* hcan, uint32_t mailbox){
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL)
+		return;
+	//CAN_TX_MAILBOX0/1/2 is 1/2/4
+	uint8_t index = (uint8_t)(mailbox >> 1);
+	Briter_CAN_Handler_t* owner = registry->tx_owner[index];
+	if(owner != NULL){
+		//Time stay in mailbox until it is loaded again by drain below
+		owner->tx_time = (uint16_t)HAL_CAN_GetTxTimestamp(hcan, mailbox);
+		registry->tx_owner[index] = NULL;
+	}
+	BRITER_CAN_TxQueue_Callback(hcan);
+}
+
+HAL_StatusTypeDef BRITER_CAN_TxQueue_GetStats(CAN_HandleTypeDef* hcan, Briter_CAN_Queue_Stats_t* stats){
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL || !registry->queue_enabled)
+		return HAL_ERROR;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*stats = registry->queue_stats;
+	for(uint8_t i = 0; i < BRITER_CAN_PRIORITY_COUNT; i++)
+		stats->depth[i] = registry->queue[i].count;
+	__set_PRIMASK(primask);
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_TxQueue_ResetStats(CAN_HandleTypeDef* hcan){
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL || !registry->queue_enabled)
+		return HAL_ERROR;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	memset(&registry->queue_stats, 0, sizeof(registry->queue_stats));
+	for(uint8_t i = 0; i < BRITER_CAN_PRIORITY_COUNT; i++)
+		registry->queue_stats.high_water[i] = registry->queue[i].count;
+	__set_PRIMASK(primask);
+	return HAL_OK;
+}
+
+uint32_t BRITER_CAN_BaudrateValue(Briter_CAN_Baudrate_e baudrate){
+	static const uint32_t bps[] = {500000, 1000000, 250000, 125000, 100000};
+	return (baudrate <= BRITER_CAN_BAUDRATE_100K) ? bps[baudrate] : 0;
+}
+
+uint32_t BRITER_CAN_FrameTime_us(uint32_t bps, uint8_t dlc){
+	if(bps == 0)
+		return 0;
+	//Standard data frame is 47 bit + data, stuffing apply from SOF to CRC
+	uint32_t bits = 47 + 8 * dlc;
+	bits += (34 + 8 * dlc - 1) / 4;
+	return (bits * 1000000UL + bps - 1) / bps;
+}
+
 HAL_StatusTypeDef BRITER_CAN_SetBaudrate(Briter_CAN_Handler_t* handler, Briter_CAN_Baudrate_e baudrate){
-	return CAN_Tx(handler, BRITER_CAN_SET_BAUDRATE, 4, baudrate);
+	return CAN_Tx(handler, BRITER_CAN_SET_BAUDRATE, baudrate);
 }
 
 HAL_StatusTypeDef BRITER_CAN_SetAddress(Briter_CAN_Handler_t* handler, uint8_t to_address){
-	return CAN_Tx(handler, BRITER_CAN_SET_ID, 4, to_address);
+	if(to_address >= BRITER_CAN_MAX_ADDRESS)
+		return HAL_ERROR;
+	if(to_address == handler->address)
+		return HAL_OK;
+	//New address must be free, reply would reach another handler
+	CAN_Registry_t* registry = CAN_Registry_Find(handler->hcan);
+	uint8_t registered = (registry != NULL && handler->address < BRITER_CAN_MAX_ADDRESS && registry->handler[handler->address] == handler);
+	if(registered && registry->handler[to_address] != NULL)
+		return HAL_ERROR;
+	HAL_StatusTypeDef status = CAN_Tx(handler, BRITER_CAN_SET_ID, to_address);
+	if(status != HAL_OK)
+		return status;
+	//Handler follow encoder, dispatch and template are keyed by address
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(registered)
+		registry->handler[handler->address] = NULL;
+	handler->address = to_address;
+	CAN_Frame_Construct(handler);
+	if(registered)
+		registry->handler[to_address] = handler;
+	__set_PRIMASK(primask);
+	return HAL_OK;
 }
 
 HAL_StatusTypeDef BRITER_CAN_SetDataMode(Briter_CAN_Handler_t* handler, Briter_CAN_Mode_e mode){
-	return CAN_Tx(handler, BRITER_CAN_SET_MODE, 4, mode);
+	return CAN_Tx(handler, BRITER_CAN_SET_MODE, mode);
 }
 
 HAL_StatusTypeDef BRITER_CAN_SetReturnTime(Briter_CAN_Handler_t* handler, uint16_t time){
-	return CAN_Tx(handler, BRITER_CAN_SET_RETURN_TIME, 4, time);
+	return CAN_Tx(handler, BRITER_CAN_SET_RETURN_TIME, time);
 }
 
 HAL_StatusTypeDef BRITER_CAN_SetZero(Briter_CAN_Handler_t* handler){
-	return CAN_Tx(handler, BRITER_CAN_SET_ZERO, 4, 0);
+	return CAN_Tx(handler, BRITER_CAN_SET_ZERO, 0);
+}
+
+HAL_StatusTypeDef BRITER_CAN_Shadow_Get(const Briter_CAN_Handler_t* handler, Briter_CAN_Command_e cmd, uint16_t* value){
+	if(!BRITER_CAN_SHADOWED(cmd))
+		return HAL_ERROR;
+	return BRITER_Shadow_Get(&handler->shadow, cmd, value);
+}
+
+void BRITER_CAN_Shadow_Invalidate(Briter_CAN_Handler_t* handler){
+	BRITER_Shadow_Invalidate(&handler->shadow);
+}
+
+HAL_StatusTypeDef BRITER_CAN_Shadow_Flush(Briter_CAN_Handler_t* handler){
+	//Encoder answer at new baudrate right after it, so it go last
+	static const Briter_CAN_Command_e order[] = {BRITER_CAN_SET_MODE, BRITER_CAN_SET_RETURN_TIME, BRITER_CAN_SET_BAUDRATE};
+	HAL_StatusTypeDef status = HAL_OK;
+	for(uint8_t i = 0; i < sizeof(order) / sizeof(order[0]); i++){
+		if(!(handler->shadow.dirty & (1U << order[i])))
+			continue;
+		if(CAN_Tx(handler, order[i], handler->shadow.value[order[i]]) != HAL_OK)
+			status = HAL_ERROR;
+	}
+	return status;
 }
 
 /**
- * @brief  Send encoder message via CAN bus.
+ * @brief  Find dispatch registry of CAN peripheral.
+ * @param  hcan can handler, NULL to find a free registry
+ * @retval pointer to registry, NULL if not found
+ */
+static CAN_Registry_t* CAN_Registry_Find(const CAN_HandleTypeDef* hcan){
+	for(uint8_t i = 0; i < BRITER_CAN_MAX_BUS; i++){
+		if(can_registry[i].hcan == hcan)
+			return &can_registry[i];
+	}
+	return NULL;
+}
+
+/**
+ * @brief  Find dispatch registry of CAN peripheral, take a free one if none.
+ * @param  hcan can handler
+ * @retval pointer to registry, NULL if every registry is taken
+ */
+static CAN_Registry_t* CAN_Registry_Claim(CAN_HandleTypeDef* hcan){
+	CAN_Registry_t* registry = CAN_Registry_Find(hcan);
+	if(registry == NULL){
+		registry = CAN_Registry_Find(NULL);
+		if(registry == NULL)
+			return NULL;
+		registry->hcan = hcan;
+	}
+	return registry;
+}
+
+/**
+ * @brief  Send frame now, or queue it when hcan has queue and no free mailbox.
  * @param  handler pointer encoder handler
- * @param  cmd action to be taken by encoder
- * @param  data_length size of data to be sent
- * @param  selection depends on the action user want to take
- * @retval none
+ * @param  data frame data, copied before return
+ * @param  dlc data length
+ * @retval HAL status, HAL_ERROR if no mailbox and queue is full or not enabled
  */
-static HAL_StatusTypeDef CAN_Tx(Briter_CAN_Handler_t* handler,Briter_CAN_Command_e cmd, uint8_t data_length, uint16_t selection){
-	assert_param(data_length <= 8);
-	CAN_TxHeaderTypeDef canTxHeader;
+static HAL_StatusTypeDef CAN_Submit(Briter_CAN_Handler_t* handler, const uint8_t* data, uint8_t dlc){
+	CAN_Registry_t* registry = CAN_Registry_Find(handler->hcan);
+	if(registry == NULL || !registry->queue_enabled)
+		return CAN_Mailbox_Add(handler, data, dlc);
+
+	uint8_t read = (data[2] == BRITER_CAN_GET_VALUE);
+	Briter_CAN_Priority_e priority = read ? BRITER_CAN_PRIORITY_READ : BRITER_CAN_PRIORITY_CONFIG;
+	CAN_Tx_Queue_t* queue = &registry->queue[priority];
+	HAL_StatusTypeDef status = HAL_OK;
+	//Mailbox complete interrupt drain the same queue
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(queue->count < BRITER_CAN_TX_QUEUE_SIZE){
+		//Setting is wanted but not on encoder until it reach a mailbox
+		CAN_Shadow_Record(handler, data, dlc, HAL_BUSY);
+		CAN_Tx_Entry_t* entry = &queue->entry[(queue->head + queue->count) % BRITER_CAN_TX_QUEUE_SIZE];
+		entry->handler = handler;
+		entry->dlc = dlc;
+		memcpy(entry->data, data, dlc);
+		queue->count++;
+		//Frame sent straight away leave the queue below and is not counted
+		CAN_Queue_Drain(registry);
+		if(queue->count){
+			registry->queue_stats.queued[priority]++;
+			if(queue->count > registry->queue_stats.high_water[priority])
+				registry->queue_stats.high_water[priority] = queue->count;
+		}
+	}
+	else{
+		registry->queue_stats.dropped[priority]++;
+		CAN_Shadow_Record(handler, data, dlc, HAL_ERROR);
+		if(read){
+			BRITER_STATS_START(&handler->stats, BRITER_Encoder_GetTick());
+			BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_TX_TIMEOUT);
+		}
+		status = HAL_ERROR;
+	}
+	__set_PRIMASK(primask);
+	return status;
+}
+
+/**
+ * @brief  Put frame into free mailbox, read request start stats transaction, setting update shadow.
+ * @param  handler pointer encoder handler
+ * @param  data frame data
+ * @param  dlc data length
+ * @retval HAL status
+ */
+static HAL_StatusTypeDef CAN_Mailbox_Add(Briter_CAN_Handler_t* handler, const uint8_t* data, uint8_t dlc){
 	uint32_t txMailbox;
-	canTxHeader.DLC = data_length;
-	canTxHeader.IDE = CAN_ID_STD;
-	canTxHeader.RTR = CAN_RTR_DATA;
-	canTxHeader.StdId = handler->address;
-	canTxHeader.TransmitGlobalTime = DISABLE;
-	canTxHeader.ExtId = 0;
-
-	uint8_t i = 0;
-	uint8_t* tx_buf = (uint8_t*)malloc(data_length * sizeof(uint8_t));
-	tx_buf[i++] = canTxHeader.DLC;
-	tx_buf[i++] = canTxHeader.StdId;
-	tx_buf[i++] = (uint8_t)cmd;
-	if(data_length == 4){
-		tx_buf[i++] = (uint8_t)selection;
+	uint8_t read = (data[2] == BRITER_CAN_GET_VALUE);
+	//Own copy of header, queue drain from interrupt while task build another
+	CAN_TxHeaderTypeDef header = handler->tx_header;
+	header.DLC = dlc;
+	//Queued frame keep address it was built for, handler may follow a new one since
+	header.StdId = data[1];
+	if(read)
+		BRITER_STATS_START(&handler->stats, BRITER_Encoder_GetTick());
+	//Owner must be known before mailbox complete interrupt
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	HAL_StatusTypeDef status = HAL_CAN_AddTxMessage(handler->hcan, &header, data, &txMailbox);
+	if(status == HAL_OK){
+		CAN_Registry_t* registry = CAN_Registry_Find(handler->hcan);
+		if(registry != NULL)
+			registry->tx_owner[txMailbox >> 1] = read ? handler : NULL;
+	}
+	__set_PRIMASK(primask);
+	if(status != HAL_OK && read)
+		BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_TX_TIMEOUT);
+	CAN_Shadow_Record(handler, data, dlc, status);
+	return status;
+}
+
+/**
+ * @brief  Fill free mailbox from queue, read priority first.
+ * @param  registry registry with queue enabled
+ * @retval none
+ * @note   Call with interrupt disabled
+ */
+static void CAN_Queue_Drain(CAN_Registry_t* registry){
+	for(uint8_t i = 0; i < BRITER_CAN_PRIORITY_COUNT; i++){
+		CAN_Tx_Queue_t* queue = &registry->queue[i];
+		while(queue->count && HAL_CAN_GetTxMailboxesFreeLevel(registry->hcan) > 0){
+			CAN_Tx_Entry_t* entry = &queue->entry[queue->head];
+			queue->head = (queue->head + 1) % BRITER_CAN_TX_QUEUE_SIZE;
+			queue->count--;
+			//Free level was checked, failure here is bus off or sleep, frame is lost
+			//Setting left dirty by mailbox add, caller was told it is queued
+			if(CAN_Mailbox_Add(entry->handler, entry->data, entry->dlc) != HAL_OK)
+				registry->queue_stats.dropped[i]++;
+		}
+		if(queue->count)
+			return;
 	}
-	else if(data_length == 5){
-		tx_buf[i++] = (uint8_t)((selection >> 0) & 0xFF);
-		tx_buf[i++] = (uint8_t)((selection >> 8) & 0xFF);
+}
+
+/**
+ * @brief  Record setting frame in shadow of handler.
+ * @param  handler pointer encoder handler
+ * @param  data frame data
+ * @param  dlc data length
+ * @param  status HAL_OK if frame went into mailbox, key turn dirty otherwise
+ * @retval none
+ */
+static void CAN_Shadow_Record(Briter_CAN_Handler_t* handler, const uint8_t* data, uint8_t dlc, HAL_StatusTypeDef status){
+	if(!BRITER_CAN_SHADOWED(data[2]))
+		return;
+	uint16_t value = data[3];
+	if(dlc == 5)
+		value |= (uint16_t)(data[4] << 8);
+	BRITER_Shadow_Update(&handler->shadow, data[2], value, status);
+}
+
+/**
+ * @brief  Write up to 4 standard ID into filter bank in 16 bit list mode.
+ * @param  hcan can handler
+ * @param  filter filter configuration with bank already selected
+ * @param  id standard ID list
+ * @param  count number of ID in list, 1 to 4
+ * @retval HAL status
+ */
+static HAL_StatusTypeDef CAN_Filter_Write(CAN_HandleTypeDef* hcan, CAN_FilterTypeDef* filter, uint16_t* id, uint8_t count){
+	//Unused entry repeat last ID
+	for(uint8_t i = count; i < 4; i++)
+		id[i] = id[count - 1];
+	//StdId sit in bit 15:5 of 16 bit filter
+	filter->FilterIdHigh = (uint32_t)id[0] << 5;
+	filter->FilterIdLow = (uint32_t)id[1] << 5;
+	filter->FilterMaskIdHigh = (uint32_t)id[2] << 5;
+	filter->FilterMaskIdLow = (uint32_t)id[3] << 5;
+	return HAL_CAN_ConfigFilter(hcan, filter);
+}
+
+/**
+ * @brief  Build transmit header and frame template of every command.
+ * @param  handler pointer encoder handler
+ * @retval none
+ */
+static void CAN_Frame_Construct(Briter_CAN_Handler_t* handler){
+	handler->tx_header.IDE = CAN_ID_STD;
+	handler->tx_header.RTR = CAN_RTR_DATA;
+	handler->tx_header.StdId = handler->address;
+	handler->tx_header.TransmitGlobalTime = DISABLE;
+	handler->tx_header.ExtId = 0;
+	handler->tx_header.DLC = can_cmd_length[BRITER_CAN_GET_VALUE - 1];
+
+	for(uint8_t i = 0; i < BRITER_CAN_CMD_COUNT; i++){
+		uint8_t* tx_buf = handler->tx_frame[i];
+		memset(tx_buf, 0, BRITER_CAN_FRAME_SIZE);
+		tx_buf[0] = can_cmd_length[i];
+		tx_buf[1] = handler->address;
+		tx_buf[2] = (uint8_t)(i + 1);
 	}
-	HAL_StatusTypeDef status = HAL_CAN_AddTxMessage(handler->hcan, &canTxHeader, tx_buf, &txMailbox);
-	free(tx_buf);
+}
+
+/**
+ * @brief  Send encoder message via CAN bus.
+ * @param  handler pointer encoder handler
+ * @param  cmd action to be taken by encoder
+ * @param  selection depends on the action user want to take
+ * @retval HAL status
+ */
+static HAL_StatusTypeDef CAN_Tx(Briter_CAN_Handler_t* handler,Briter_CAN_Command_e cmd, uint16_t selection){
+	assert_param(cmd >= BRITER_CAN_GET_VALUE && cmd <= BRITER_CAN_CMD_COUNT);
+	//Encoder already hold setting, keep bus free
+	if(BRITER_CAN_SHADOWED(cmd) && BRITER_Shadow_Match(&handler->shadow, cmd, selection))
+		return HAL_OK;
+	//Patch selection into copy of template, task and interrupt may send at once
+	BRITER_PROFILE_BEGIN();
+	uint8_t tx_buf[BRITER_CAN_FRAME_SIZE];
+	memcpy(tx_buf, handler->tx_frame[cmd - 1], BRITER_CAN_FRAME_SIZE);
+	tx_buf[3] = (uint8_t)((selection >> 0) & 0xFF);
+	if(tx_buf[0] == 5)
+		tx_buf[4] = (uint8_t)((selection >> 8) & 0xFF);
+	//Shadow follow frame into mailbox, queued setting stay dirty until then
+	HAL_StatusTypeDef status = CAN_Submit(handler, tx_buf, tx_buf[0]);
+	BRITER_PROFILE_END(BRITER_PROFILE_CAN_TX);
 	return status;
 }
@@ -13,24 +13,65 @@
  *-# Create handler to hold Briter_CAN_Handler_t and initialize using BRITER_CAN_Init()
  *-# Make sure baudrate and address is correct
  * 	 - Default encoder address is 1 and baudrate is 9500kbps if no configure
+ *	 - Transmit header and frame of every command are built once in BRITER_CAN_Init(),
+ *	   no heap is used so request can also be sent from interrupt
  *-# For reading encoder value,
  *	 - Encoder value is depends on the hardware itself
  *	 - Call BRITER_CAN_ReadValue()
  *	 - In HAL_CAN_RxFifo0MsgPendingCallback()
  *	 	- Call HAL_CAN_GetRxMessage()
  *	 	- If HAL_OK, call BRITER_CAN_GetEncoderValue_Callback() to read the encoder position
+ *-# For many encoders on one CAN bus,
+ *	 - Call BRITER_CAN_Register() for every handler after BRITER_CAN_Init()
+ *	 - Call BRITER_CAN_ConfigFilter() so only registered encoder raise interrupt
+ *	 - In HAL_CAN_RxFifo0MsgPendingCallback()
+ *	 	- Call HAL_CAN_GetRxMessage()
+ *	 	- If HAL_OK, call BRITER_CAN_Dispatch(), frame is routed to its handler
+ *	 	  by address lookup and position is decoded
+ *-# For polling many encoders back-to-back,
+*	 - Call BRITER_CAN_TxQueue_Enable() once per hcan, frame that find no free
+*	   mailbox wait in software queue instead of failing
+*	 - In HAL_CAN_TxMailbox0/1/2AbortCallback(), call BRITER_CAN_TxQueue_Callback()
+*	 - In HAL_CAN_TxMailbox0/1/2CompleteCallback(), call BRITER_CAN_TxQueue_Callback()
+*	   or BRITER_CAN_TxComplete_Callback() when request timestamp is needed
+*	 - Read request always go before queued setting
+*	 - Size BRITER_CAN_TX_QUEUE_SIZE with high water from BRITER_CAN_TxQueue_GetStats()
+*-# For position of several axes sampled at the same instant, refer to
+*	 briter_encoder_can_group.h
+*-# For reading sample in task,
+ *	 - Every decoded position is timestamped with BRITER_Encoder_GetTick()
+ *	 - BRITER_CAN_GetLatest() give latest position and its age with one load
+ *	 - For history, give a ring with BRITER_CAN_AttachRing() and drain it with
+ *	   BRITER_CAN_ReadSample(), interrupt write and task read without lock
+ *	 - briter_encoder.h give the same interface over RS485 and CAN
+ *-# Baudrate, mode and return time last sent are kept in handler shadow,
+*	 - Sending the value encoder already hold is skipped, frame accepted by
+*	   mailbox count as held since encoder do not answer setting, frame in
+*	   software queue stay dirty until it reach a mailbox
+*	 - Call BRITER_CAN_Shadow_Invalidate() if encoder may have power-cycled,
+*	   BRITER_CAN_Shadow_Flush() then send again only what was set before,
+*	   refer to briter_encoder_shadow.h
+*-# Define BRITER_ENCODER_STATS to count failure class and latency of every read,
+ *	 - No free mailbox or full queue count as TX timeout, read request sent before previous one
+ *	   was answered count as RX timeout, CRC is checked and retried by CAN hardware
+ *	 - Read them with BRITER_CAN_GetStats(), refer to briter_encoder_stats.h
  *
  */
 
 #ifndef BRITER_ENCODER_CAN_H_
 #define BRITER_ENCODER_CAN_H_
 
-#include "stm32f4xx_hal.h"
+#include "briter_encoder_port.h"
+#include "briter_encoder_sample.h"
+#include "briter_encoder_stats.h"
+#include "briter_encoder_shadow.h"
+#include "briter_encoder_model.h"
 
 /** Used to indicate error when incorrect reception occur*/
 #define BRITER_CAN_ERROR	0xFFFFFFFF
 
 /** @name Encoder Characteristic
+ * Default model, other variant use BRITER_CAN_SetModel()
  */
 /**@{*/
 #define BRITER_CAN_PPR			4096		//Pulse per revolution
@@ -38,12 +79,65 @@
 #define BRITER_CAN_MAX_VALUE	(BRITER_CAN_PPR * BRITER_CAN_NO_OF_TURN)
 /**@}*/
 
+/** @name Dispatch Registry
+ */
+/**@{*/
+#ifndef BRITER_CAN_MAX_BUS
+#define BRITER_CAN_MAX_BUS		2			//Number of CAN peripheral with registered encoder
+#endif
+#ifndef BRITER_CAN_MAX_ADDRESS
+#define BRITER_CAN_MAX_ADDRESS	128			//Address range of lookup table
+#endif
+#define BRITER_CAN_SLAVE_START_FILTER_BANK	14	//First filter bank of CAN2
+/**@}*/
+
+/** @name Transmit Queue
+ */
+/**@{*/
+#ifndef BRITER_CAN_TX_QUEUE_SIZE
+#define BRITER_CAN_TX_QUEUE_SIZE	8			//Frame per priority per CAN peripheral
+#endif
+/**@}*/
+
+/** @name Latest Sample Packing
+ */
+/**@{*/
+#define BRITER_CAN_LATEST_POSITION_BITS	17			//Hold BRITER_CAN_MAX_VALUE
+#define BRITER_CAN_LATEST_POSITION_MASK	((1UL << BRITER_CAN_LATEST_POSITION_BITS) - 1)
+#define BRITER_CAN_LATEST_AGE_MASK		(0xFFFFFFFFUL >> BRITER_CAN_LATEST_POSITION_BITS)	//Age wrap after this tick
+#define BRITER_CAN_LATEST_NONE			0xFFFFFFFF	//No sample received yet
+/**@}*/
+
+/** @name Frame Template
+ */
+/**@{*/
+#define BRITER_CAN_CMD_COUNT	6			//Number of command in Briter_CAN_Command_e
+#define BRITER_CAN_FRAME_SIZE	8			//Maximum CAN data length
+/**@}*/
+
+struct Briter_CAN_Group_s;
+
 /** Briter CAN handler*/
 typedef struct
 {
   CAN_HandleTypeDef*    hcan;
   uint8_t address;
   uint32_t position;			/*!<Preprocessed encoder position, (24turn * 4096ppr)*/
+  CAN_TxHeaderTypeDef tx_header;	/*!<Transmit header, built once in BRITER_CAN_Init()*/
+  uint8_t tx_frame[BRITER_CAN_CMD_COUNT][BRITER_CAN_FRAME_SIZE];	/*!<Frame template per command, read only after BRITER_CAN_Init()*/
+  volatile uint32_t latest;		/*!<Timestamp in upper bit, position in lower BRITER_CAN_LATEST_POSITION_BITS*/
+  uint32_t timestamp;			/*!<BRITER_Encoder_GetTick() when position was received*/
+  uint32_t sequence;			/*!<Number of position decoded*/
+  Briter_Sample_Ring_t* ring;	/*!<Optional sample history, NULL if not used*/
+  Briter_Shadow_t shadow;		/*!<Setting last sent, index by command*/
+  uint16_t tx_time;				/*!<CAN timer at last read request, need TTCM and BRITER_CAN_TxComplete_Callback()*/
+  uint16_t rx_time;				/*!<CAN timer at last response, need TTCM and BRITER_CAN_Dispatch()*/
+  struct Briter_CAN_Group_s* group;	/*!<Sample group of encoder, NULL if none*/
+  uint8_t group_index;			/*!<Position in group*/
+  const Briter_Model_t* model;	/*!<Encoder variant, decode response*/
+#ifdef BRITER_ENCODER_STATS
+  Briter_Stats_t stats;			/*!<Read transaction statistic*/
+#endif
  }Briter_CAN_Handler_t;
 
 /** Briter CAN Command Selection */
@@ -56,6 +150,25 @@ typedef enum {
     BRITER_CAN_SET_ZERO,
 } Briter_CAN_Command_e;
 
+/** Command kept in handler shadow, handler keep old ID after BRITER_CAN_SET_ID so it is not kept*/
+#define BRITER_CAN_SHADOW_MASK	((1U << BRITER_CAN_SET_BAUDRATE) | (1U << BRITER_CAN_SET_MODE) | (1U << BRITER_CAN_SET_RETURN_TIME))
+#define BRITER_CAN_SHADOWED(cmd)	((BRITER_CAN_SHADOW_MASK >> (cmd)) & 1U)
+
+/** Transmit queue priority, read request is latency critical */
+typedef enum {
+    BRITER_CAN_PRIORITY_READ = 0x00,
+    BRITER_CAN_PRIORITY_CONFIG,
+    BRITER_CAN_PRIORITY_COUNT,
+} Briter_CAN_Priority_e;
+
+/** Transmit queue occupancy of one CAN peripheral, index by ::Briter_CAN_Priority_e */
+typedef struct {
+	uint8_t depth[BRITER_CAN_PRIORITY_COUNT];		/*!<Frame waiting now*/
+	uint8_t high_water[BRITER_CAN_PRIORITY_COUNT];	/*!<Most frame waiting since reset*/
+	uint32_t queued[BRITER_CAN_PRIORITY_COUNT];		/*!<Frame that found no free mailbox*/
+	uint32_t dropped[BRITER_CAN_PRIORITY_COUNT];	/*!<Frame rejected as queue was full*/
+} Briter_CAN_Queue_Stats_t;
+
 /** Briter CAN Baudrate Selection */
 typedef enum {
     BRITER_CAN_BAUDRATE_500K = 0x00,
@@ -68,8 +181,8 @@ typedef enum {
 
 /** Briter CAN Mode Selection */
 typedef enum {
-    RS485_ENC_MODE_QUERY = 0x00,
-    RS485_ENC_MODE_BACKHAUL,
+    BRITER_CAN_MODE_QUERY = 0x00,
+    BRITER_CAN_MODE_BACKHAUL,
 } Briter_CAN_Mode_e;
 
 /**
@@ -89,20 +202,158 @@ HAL_StatusTypeDef BRITER_CAN_Init(Briter_CAN_Handler_t* handler,uint8_t address,
 HAL_StatusTypeDef BRITER_CAN_ReadValue(Briter_CAN_Handler_t* handler);
 
 /**
-* @brief  Read encoder value.
+* @brief  Decode encoder value from received frame.
 * @param  handler: encoder handler to give address and store encoder return value
-* @param pData pointer to receive data buffer
+* @param  pData pointer to receive data buffer
+* @retval encoder position, BRITER_CAN_ERROR if frame is not value of this encoder
+* @note   Use HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
+*/
+uint32_t BRITER_CAN_GetEncoderValue_Callback(Briter_CAN_Handler_t* handler, uint8_t *pData);
+
+/**
+* @brief  Give handler a ring to keep every decoded sample.
+* @param  handler: encoder handler
+* @param  ring: sample ring, NULL to detach
 * @retval HAL status
+* @note   Ring is emptied, one producer (reception interrupt) and one consumer
+*/
+HAL_StatusTypeDef BRITER_CAN_AttachRing(Briter_CAN_Handler_t* handler, Briter_Sample_Ring_t* ring);
+
+/**
+* @brief  Take oldest sample from handler ring.
+* @param  handler: encoder handler with ring attached
+* @param  sample: oldest sample
+* @retval 1 if sample is taken, 0 if none
+*/
+uint8_t BRITER_CAN_ReadSample(Briter_CAN_Handler_t* handler, Briter_Sample_t* sample);
+
+/**
+* @brief  Get latest position and its age.
+* @param  handler: encoder handler
+* @param  position: latest position
+* @param  age: tick since position was received, modulo BRITER_CAN_LATEST_AGE_MASK + 1
+* @retval HAL status, HAL_ERROR if no position received yet
+* @note   Position and timestamp are read with one load, always consistent
+*/
+HAL_StatusTypeDef BRITER_CAN_GetLatest(const Briter_CAN_Handler_t* handler, uint32_t* position, uint32_t* age);
+
+#ifdef BRITER_ENCODER_STATS
+/**
+* @brief  Copy read transaction statistic of handler.
+* @param  handler: encoder handler
+* @param  stats: pointer to copy
+* @retval none
 */
-uint32_t BRITER_CAN_ReadValue_Callback(Briter_CAN_Handler_t* handler, uint8_t *pData);
+void BRITER_CAN_GetStats(const Briter_CAN_Handler_t* handler, Briter_Stats_t* stats);
 
 /**
-* @brief  BRITER_CAN_Callback.
+* @brief  Clear read transaction statistic of handler.
 * @param  handler: encoder handler
+* @retval none
+*/
+void BRITER_CAN_ResetStats(Briter_CAN_Handler_t* handler);
+#endif
+
+/**
+* @brief  Get bit rate of baudrate selection.
+* @param  baudrate: refer to ::Briter_CAN_Baudrate_e
+* @retval bit per second, 0 if unknown
+*/
+uint32_t BRITER_CAN_BaudrateValue(Briter_CAN_Baudrate_e baudrate);
+
+/**
+* @brief  Worst case time taken by standard data frame on the bus.
+* @param  bps: bit per second
+* @param  dlc: data length, 0 to 8
+* @retval time in us, rounded up
+*/
+uint32_t BRITER_CAN_FrameTime_us(uint32_t bps, uint8_t dlc);
+
+/**
+* @brief  Register handler for BRITER_CAN_Dispatch() on its hcan.
+* @param  handler: initialized encoder handler
+* @retval HAL status, HAL_ERROR if address is out of range or already taken
+*/
+HAL_StatusTypeDef BRITER_CAN_Register(Briter_CAN_Handler_t* handler);
+
+/**
+* @brief  Remove handler from dispatch registry.
+* @param  handler: registered encoder handler
 * @retval HAL status
-* @note   Use HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan)
 */
-HAL_StatusTypeDef BRITER_CAN_Callback(Briter_CAN_Handler_t* handler, uint8_t *pData);
+HAL_StatusTypeDef BRITER_CAN_Unregister(Briter_CAN_Handler_t* handler);
+
+/**
+* @brief  Route received frame to registered handler and decode it.
+* @param  hcan: can handler the frame was received on
+* @param  header: receive header from HAL_CAN_GetRxMessage()
+* @param  pData: receive data from HAL_CAN_GetRxMessage()
+* @retval handler the frame belongs to, NULL if not from registered encoder
+* @note   Constant time, use inside HAL_CAN_RxFifoXMsgPendingCallback()
+*/
+Briter_CAN_Handler_t* BRITER_CAN_Dispatch(CAN_HandleTypeDef* hcan, const CAN_RxHeaderTypeDef* header, uint8_t* pData);
+
+/**
+* @brief  Queue frame in software when every mailbox of hcan is busy.
+* @param  hcan: can handler
+* @retval HAL status, HAL_ERROR if no free registry
+* @note   Enable transmit mailbox empty interrupt, route mailbox complete and
+* 	abort callback to BRITER_CAN_TxQueue_Callback() before calling
+*/
+HAL_StatusTypeDef BRITER_CAN_TxQueue_Enable(CAN_HandleTypeDef* hcan);
+
+/**
+* @brief  Move queued frame into free mailbox, read request first.
+* @param  hcan: can handler
+* @retval none
+* @note   Use inside HAL_CAN_TxMailboxXCompleteCallback() and HAL_CAN_TxMailboxXAbortCallback()
+*/
+void BRITER_CAN_TxQueue_Callback(CAN_HandleTypeDef* hcan);
+
+/**
+* @brief  Keep timestamp of read request that left mailbox, then drain queue.
+* @param  hcan: can handler
+* @param  mailbox: CAN_TX_MAILBOX0, CAN_TX_MAILBOX1 or CAN_TX_MAILBOX2
+* @retval none
+* @note   Use inside HAL_CAN_TxMailboxXCompleteCallback() instead of
+* 	BRITER_CAN_TxQueue_Callback()
+*/
+void BRITER_CAN_TxComplete_Callback(CAN_HandleTypeDef* hcan, uint32_t mailbox);
+
+/**
+* @brief  Copy transmit queue occupancy.
+* @param  hcan: can handler
+* @param  stats: output occupancy
+* @retval HAL status, HAL_ERROR if queue is not enabled on hcan
+*/
+HAL_StatusTypeDef BRITER_CAN_TxQueue_GetStats(CAN_HandleTypeDef* hcan, Briter_CAN_Queue_Stats_t* stats);
+
+/**
+* @brief  Clear counter, high water restart from current depth.
+* @param  hcan: can handler
+* @retval HAL status, HAL_ERROR if queue is not enabled on hcan
+*/
+HAL_StatusTypeDef BRITER_CAN_TxQueue_ResetStats(CAN_HandleTypeDef* hcan);
+
+/**
+* @brief  Set encoder variant, BRITER_MODEL(CAN_4096X24) after BRITER_CAN_Init().
+* @param  handler: encoder handler
+* @param  model: model descriptor, refer to briter_encoder_model.h
+* @retval HAL status, HAL_ERROR if value range do not fit BRITER_CAN_LATEST_POSITION_BITS
+*/
+HAL_StatusTypeDef BRITER_CAN_SetModel(Briter_CAN_Handler_t* handler, const Briter_Model_t* model);
+
+/**
+* @brief  Set hardware filter to accept only registered encoder ID.
+* @param  hcan: can handler
+* @param  fifo: CAN_FILTER_FIFO0 or CAN_FILTER_FIFO1
+* @param  first_bank: first filter bank to use
+* @param  bank_count: number of filter bank available from first_bank
+* @retval HAL status, HAL_ERROR if registered encoder do not fit in bank_count
+* @note   Each bank hold 4 ID in 16 bit list mode, call again after register,
+* 	bank not needed up to first_bank + bank_count is deactivated
+*/
+HAL_StatusTypeDef BRITER_CAN_ConfigFilter(CAN_HandleTypeDef* hcan, uint32_t fifo, uint32_t first_bank, uint32_t bank_count);
 
 /**
 * @brief Set encoder baudrate.
@@ -113,10 +364,14 @@ HAL_StatusTypeDef BRITER_CAN_Callback(Briter_CAN_Handler_t* handler, uint8_t *pD
 HAL_StatusTypeDef BRITER_CAN_SetBaudrate(Briter_CAN_Handler_t* handler, Briter_CAN_Baudrate_e baudrate);
 
 /**
-* @brief Change encoder address.
+* @brief Change encoder address, handler follow new address on success.
 * @param  handler: encoder handler
 * @param  to_address: the address you want to change to
-* @retval HAL status
+* @retval HAL status, HAL_ERROR if address is out of range or taken by another
+*         registered handler
+* @note   Registered handler is moved to new address, call BRITER_CAN_ConfigFilter()
+*         again so reply from new address pass the filter. Reply to read still
+*         in flight on old address is lost
 */
 HAL_StatusTypeDef BRITER_CAN_SetAddress(Briter_CAN_Handler_t* handler, uint8_t to_address);
 
@@ -146,23 +401,34 @@ HAL_StatusTypeDef BRITER_CAN_SetZero(Briter_CAN_Handler_t* handler);
 */
 HAL_StatusTypeDef BRITER_CAN_SetReturnTime(Briter_CAN_Handler_t* handler, uint16_t time);
 
-//Paste this under Rx interrupt function to sort incoming messages 
+/**
+* @brief  Get setting encoder is known to hold.
+* @param  handler: encoder handler
+* @param  cmd: setting command, refer to BRITER_CAN_SHADOW_MASK
+* @param  value: output value
+* @retval HAL_OK if known, HAL_ERROR if never sent or invalidated
+*/
+HAL_StatusTypeDef BRITER_CAN_Shadow_Get(const Briter_CAN_Handler_t* handler, Briter_CAN_Command_e cmd, uint16_t* value);
+
+/**
+* @brief  Forget known setting, e.g. after encoder power-cycle.
+* @param  handler: encoder handler
+* @retval none
+*/
+void BRITER_CAN_Shadow_Invalidate(Briter_CAN_Handler_t* handler);
+
+/**
+* @brief  Send every dirty setting again, baudrate last.
+* @param  handler: encoder handler
+* @retval HAL status, setting not sent stay dirty
+* @note   One mailbox per setting, call again if HAL_ERROR for no free mailbox
+*/
+HAL_StatusTypeDef BRITER_CAN_Shadow_Flush(Briter_CAN_Handler_t* handler);
+
+//Paste this under Rx interrupt function to sort incoming messages
 /*
-HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO1, &RxHeader, incoming); // change FIFO accordingly
-switch(incoming[1]){
-	case 0x04:
-		ENCODER_Sort_Incoming(incoming, &hEncoderLeftPull);
-		break;
-	case 0x02:
-		ENCODER_Sort_Incoming(incoming, &hEncoderLeftTurn);
-		break;
-	case 0x03:
-		ENCODER_Sort_Incoming(incoming, &hEncoderRightPull);
-		break;
-	case 0x01:
-		ENCODER_Sort_Incoming(incoming, &hEncoderRightTurn);
-		break;
-}
+if(HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &RxHeader, incoming) == HAL_OK) // change FIFO accordingly
+	BRITER_CAN_Dispatch(hcan, &RxHeader, incoming);
 */
 
 #endif
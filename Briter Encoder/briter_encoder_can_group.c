@@ -0,0 +1,119 @@
+/** @file   briter_encoder_can_group.c
+ *  @brief  Source file of time aligned sampling of Briter CAN encoders.
+ *  @author Ang Chin Xian
+ */
+
+#include <briter_encoder_can_group.h>
+#include <briter_encoder_time.h>
+#include <string.h>
+
+HAL_StatusTypeDef BRITER_CAN_Group_Init(Briter_CAN_Group_t* group, Briter_CAN_Group_Callback callback, void* context){
+	if(group == NULL)
+		return HAL_ERROR;
+	memset(group, 0, sizeof(Briter_CAN_Group_t));
+	group->callback = callback;
+	group->context = context;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_Group_Add(Briter_CAN_Group_t* group, Briter_CAN_Handler_t* handler){
+	if(handler == NULL || handler->group != NULL || group->count >= BRITER_CAN_GROUP_MAX)
+		return HAL_ERROR;
+	if(group->count && group->member[0]->hcan != handler->hcan)
+		return HAL_ERROR;
+	handler->group = group;
+	handler->group_index = group->count;
+	group->member[group->count++] = handler;
+	return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_Group_Trigger(Briter_CAN_Group_t* group){
+	HAL_StatusTypeDef status = HAL_OK;
+	//No interrupt between request so they leave back-to-back
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	if(group->pending)
+		group->incomplete++;
+	group->building.tick = BRITER_Encoder_GetTick();
+	group->pending = (group->count == 32) ? 0xFFFFFFFF : ((1UL << group->count) - 1);
+	for(uint8_t i = 0; i < group->count; i++){
+		if(BRITER_CAN_ReadValue(group->member[i]) != HAL_OK){
+			//Snapshot can not complete without this member
+			group->pending = 0;
+			status = HAL_ERROR;
+			break;
+		}
+	}
+	__set_PRIMASK(primask);
+	return status;
+}
+
+void BRITER_CAN_Group_Receive(Briter_CAN_Handler_t* handler){
+	Briter_CAN_Group_t* group = handler->group;
+	uint32_t bit = 1UL << handler->group_index;
+	//Response of read not sent by trigger
+	if(!(group->pending & bit))
+		return;
+	uint8_t i = handler->group_index;
+	group->building.position[i] = handler->position;
+	group->building.tx_time[i] = handler->tx_time;
+	group->building.rx_time[i] = handler->rx_time;
+	group->pending &= ~bit;
+	if(group->pending)
+		return;
+
+	//Offset from first member, CAN timer wrap so take signed difference
+	int16_t earliest = 0;
+	int16_t latest = 0;
+	for(i = 1; i < group->count; i++){
+		int16_t offset = (int16_t)(group->building.tx_time[i] - group->building.tx_time[0]);
+		if(offset < earliest)
+			earliest = offset;
+		if(offset > latest)
+			latest = offset;
+	}
+	group->building.skew = (uint16_t)(latest - earliest);
+	if(group->building.skew > group->skew_max)
+		group->skew_max = group->building.skew;
+	group->building.sequence = group->latest.sequence + 1;
+	group->previous = group->latest;
+	group->latest = group->building;
+	if(group->callback != NULL)
+		group->callback(group->context, &group->latest);
+}
+
+HAL_StatusTypeDef BRITER_CAN_Group_GetSnapshot(const Briter_CAN_Group_t* group, Briter_CAN_Group_Snapshot_t* snapshot){
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	*snapshot = group->latest;
+	__set_PRIMASK(primask);
+	return (snapshot->sequence == 0) ? HAL_ERROR : HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_CAN_Group_Interpolate(const Briter_CAN_Group_t* group, uint16_t time, uint32_t* position){
+	Briter_CAN_Group_Snapshot_t previous;
+	Briter_CAN_Group_Snapshot_t latest;
+	uint32_t primask = __get_PRIMASK();
+	__disable_irq();
+	previous = group->previous;
+	latest = group->latest;
+	__set_PRIMASK(primask);
+	if(previous.sequence == 0)
+		return HAL_ERROR;
+
+	for(uint8_t i = 0; i < group->count; i++){
+		const Briter_Model_t* model = group->member[i]->model;
+		//Shortest way around multi turn range
+		int32_t travel = BRITER_Model_Delta(model, latest.position[i], previous.position[i]);
+		int32_t span = (uint16_t)(latest.tx_time[i] - previous.tx_time[i]);
+		int32_t offset = (int16_t)(time - latest.tx_time[i]);
+		int32_t value = (int32_t)latest.position[i];
+		if(span != 0)
+			value += (int32_t)(((int64_t)travel * offset) / span);
+		value %= (int32_t)model->modulus;
+		if(value < 0)
+			value += model->modulus;
+		position[i] = (uint32_t)value;
+	}
+	return HAL_OK;
+}
@@ -0,0 +1,121 @@
+/**
+ ******************************************************************************
+ * @file    briter_encoder_can_group.h
+ * @author  Ang Chin Xian
+ * @brief   Time aligned sampling of several Briter CAN encoders.
+ *
+ *## How to use this driver
+ *-# Enable time triggered communication mode (TTCM) in CAN init, mailbox and
+ *   FIFO then hold 16 bit CAN timer at start of frame, one count per bit time
+ *-# Initialize and register every encoder with BRITER_CAN_Init() and
+ *   BRITER_CAN_Register(), all on the same hcan, received frame must go
+ *   through BRITER_CAN_Dispatch() so receive timestamp is kept
+ *-# In HAL_CAN_TxMailboxXCompleteCallback(), call
+ *   BRITER_CAN_TxComplete_Callback() with CAN_TX_MAILBOXX so request timestamp
+ *   is kept, it also drain transmit queue if enabled
+ *-# Initialize group with BRITER_CAN_Group_Init() and add encoder with
+ *   BRITER_CAN_Group_Add(), an encoder belong to one group at most
+ *-# Call BRITER_CAN_Group_Trigger() once per control period
+ *	 - Every read request is loaded back-to-back with interrupt disabled,
+ *	   three fit in mailbox, enable transmit queue for bigger group so the
+ *	   rest follow from mailbox complete interrupt without software gap
+ *	 - When every member has answered, callback get the snapshot from interrupt
+ *-# Encoder sample position when request reach it, so skew between axes is
+ *   spread of request timestamp, kept in snapshot and worst in group
+ *-# BRITER_CAN_Group_Interpolate() give every axis at one common CAN time from
+ *   last two snapshot, assuming constant speed in between
+ *
+ */
+
+#ifndef BRITER_ENCODER_CAN_GROUP_H_
+#define BRITER_ENCODER_CAN_GROUP_H_
+
+#include "briter_encoder_can.h"
+
+/** @name Group Size
+ */
+/**@{*/
+#ifndef BRITER_CAN_GROUP_MAX
+#define BRITER_CAN_GROUP_MAX	8			//Maximum encoder per group
+#endif
+/**@}*/
+
+/** Position of every member sampled by one trigger, index by order of BRITER_CAN_Group_Add() */
+typedef struct {
+	uint32_t position[BRITER_CAN_GROUP_MAX];
+	uint16_t tx_time[BRITER_CAN_GROUP_MAX];	/*!<CAN timer at request start of frame*/
+	uint16_t rx_time[BRITER_CAN_GROUP_MAX];	/*!<CAN timer at response start of frame*/
+	uint16_t skew;							/*!<Latest minus earliest tx_time, bit time*/
+	uint32_t tick;							/*!<BRITER_Encoder_GetTick() at trigger*/
+	uint32_t sequence;						/*!<Number of complete snapshot*/
+} Briter_CAN_Group_Snapshot_t;
+
+/** Called from interrupt when every member has answered */
+typedef void (*Briter_CAN_Group_Callback)(void* context, const Briter_CAN_Group_Snapshot_t* snapshot);
+
+/** Briter CAN sample group */
+typedef struct Briter_CAN_Group_s
+{
+  Briter_CAN_Handler_t* member[BRITER_CAN_GROUP_MAX];
+  uint8_t count;
+  volatile uint32_t pending;			/*!<Bit n set, member n not answered yet*/
+  Briter_CAN_Group_Snapshot_t building;	/*!<Filled by response of current trigger*/
+  Briter_CAN_Group_Snapshot_t latest;	/*!<Last complete snapshot*/
+  Briter_CAN_Group_Snapshot_t previous;	/*!<Complete snapshot before latest*/
+  Briter_CAN_Group_Callback callback;
+  void* context;
+  uint16_t skew_max;					/*!<Worst skew seen, bit time*/
+  uint32_t incomplete;					/*!<Trigger not answered by every member before next one*/
+ }Briter_CAN_Group_t;
+
+/**
+* @brief  Initialize empty group.
+* @param  group: sample group
+* @param  callback: called when snapshot complete, can be NULL
+* @param  context: passed to callback
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_CAN_Group_Init(Briter_CAN_Group_t* group, Briter_CAN_Group_Callback callback, void* context);
+
+/**
+* @brief  Add encoder to group.
+* @param  group: sample group
+* @param  handler: registered encoder handler, same hcan as other member
+* @retval HAL status, HAL_ERROR if group is full, hcan differ or handler already in a group
+*/
+HAL_StatusTypeDef BRITER_CAN_Group_Add(Briter_CAN_Group_t* group, Briter_CAN_Handler_t* handler);
+
+/**
+* @brief  Send read request of every member back-to-back.
+* @param  group: sample group
+* @retval HAL status, HAL_ERROR if a request could not be sent or queued
+*/
+HAL_StatusTypeDef BRITER_CAN_Group_Trigger(Briter_CAN_Group_t* group);
+
+/**
+* @brief  Take response of member, complete snapshot when last member answer.
+* @param  handler: encoder handler with position and rx_time just updated
+* @retval none
+* @note   Called by BRITER_CAN_GetEncoderValue_Callback(), no need to call it
+*/
+void BRITER_CAN_Group_Receive(Briter_CAN_Handler_t* handler);
+
+/**
+* @brief  Copy last complete snapshot.
+* @param  group: sample group
+* @param  snapshot: output snapshot
+* @retval HAL status, HAL_ERROR if no snapshot completed yet
+*/
+HAL_StatusTypeDef BRITER_CAN_Group_GetSnapshot(const Briter_CAN_Group_t* group, Briter_CAN_Group_Snapshot_t* snapshot);
+
+/**
+* @brief  Estimate every member position at one CAN time.
+* @param  group: sample group with at least two complete snapshot
+* @param  time: CAN timer value to align to, usually latest tx_time of member 0
+* @param  position: output position, BRITER_CAN_GROUP_MAX entry
+* @retval HAL status, HAL_ERROR if less than two snapshot
+* @note   Two snapshot must be less than one CAN timer wrap (65536 bit time) apart
+*/
+HAL_StatusTypeDef BRITER_CAN_Group_Interpolate(const Briter_CAN_Group_t* group, uint16_t time, uint32_t* position);
+
+#endif
@@ -0,0 +1,75 @@
+/**
+ * @file   briter_encoder_convert.c
+ * @brief  Source file of Briter encoder fixed point unit conversion.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_convert.h"
+#include "briter_encoder_profile.h"
+
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+/**
+ * @brief  Most significant word multiply with rounding, SMMULR.
+ * @param  a first operand
+ * @param  b second operand
+ * @retval (a * b + 0x80000000) >> 32
+ */
+static inline int32_t Convert_SMMULR(int32_t a, int32_t b) {
+    int32_t result;
+    __asm ("smmulr %0, %1, %2" : "=r" (result) : "r" (a), "r" (b));
+    return result;
+}
+#endif
+
+HAL_StatusTypeDef BRITER_Convert_Init(Briter_Convert_t *conv, const Briter_Model_t *model, uint64_t unit_per_rev) {
+    if (!conv || !model || model->ppr == 0 || model->turns == 0 || unit_per_rev == 0)
+	return HAL_ERROR;
+    //Largest output must stay in int32
+    if ((unit_per_rev >> (BRITER_CONVERT_UNIT_Q - BRITER_CONVERT_Q)) > INT32_MAX / model->turns)
+	return HAL_ERROR;
+    //Count per output unit, fraction of unit dropped at the end
+    uint64_t divisor = (uint64_t) model->ppr << (BRITER_CONVERT_UNIT_Q - BRITER_CONVERT_Q);
+    //Take most scale bit that fit 32 bit, it set the accuracy
+    uint8_t shift = 0;
+    while (shift < 62 && !(unit_per_rev >> (62 - shift)) && ((unit_per_rev << (shift + 1)) + divisor / 2) / divisor <= UINT32_MAX)
+	shift++;
+    conv->scale = (uint32_t) (((unit_per_rev << shift) + divisor / 2) / divisor);
+    conv->shift = shift;
+    conv->round = shift ? ((int64_t) 1 << (shift - 1)) : 0;
+    //DSP path take high word of (count << k) * (scale >> 1), k = 33 - shift,
+    //shifted count must stay positive in int32
+    conv->msw_scale = (int32_t) (conv->scale >> 1);
+    conv->msw_shift = BRITER_CONVERT_MSW_NONE;
+    if (shift >= 2 && shift <= 33 && ((uint64_t) (model->modulus - 1) << (33 - shift)) <= INT32_MAX)
+	conv->msw_shift = (uint8_t) (33 - shift);
+    return HAL_OK;
+}
+
+void BRITER_Convert_Array(const Briter_Convert_t *conv, const uint32_t *restrict count, int32_t *restrict out, uint32_t n) {
+    BRITER_PROFILE_BEGIN();
+#if defined(__ARM_FEATURE_DSP) && (__ARM_FEATURE_DSP == 1)
+    if (conv->msw_shift != BRITER_CONVERT_MSW_NONE) {
+	const int32_t msw_scale = conv->msw_scale;
+	const uint8_t msw_shift = conv->msw_shift;
+	for (uint32_t i = 0; i < n; i++)
+	    out[i] = Convert_SMMULR((int32_t) (count[i] << msw_shift), msw_scale);
+	BRITER_PROFILE_END(BRITER_PROFILE_CONVERT);
+	return;
+    }
+#endif
+    //Keep in register, loop body is multiply-accumulate and shift only
+    //Count is never negative, unsigned 32x32 to 64 multiply vectorize on host
+    const uint64_t scale = conv->scale;
+    const uint64_t round = (uint64_t) conv->round;
+    const uint8_t shift = conv->shift;
+    for (uint32_t i = 0; i < n; i++)
+	out[i] = (int32_t) (((uint64_t) count[i] * scale + round) >> shift);
+    BRITER_PROFILE_END(BRITER_PROFILE_CONVERT);
+}
+
+void BRITER_Convert_Gather(const Briter_Convert_t *const *conv, const uint32_t *restrict count, int32_t *restrict out, uint32_t n) {
+    BRITER_PROFILE_BEGIN();
+    for (uint32_t i = 0; i < n; i++)
+	out[i] = BRITER_Convert(conv[i], (int32_t) count[i]);
+    BRITER_PROFILE_END(BRITER_PROFILE_CONVERT);
+}
@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_convert.h
+  * @author  Ang Chin Xian
+  * @brief   Fixed point conversion of Briter encoder count to angle or length.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Keep one Briter_Convert_t per model and unit, build it once with
+      BRITER_Convert_Init() from model descriptor and unit per revolution
+      - BRITER_CONVERT_RADIAN, BRITER_CONVERT_DEGREE, or lead of screw in
+	BRITER_CONVERT_UNIT_Q fixed point for length, unit carry more fraction
+	than output so its rounding do not add up over many turn
+  2. Output is signed BRITER_CONVERT_Q fixed point, e.g. 65536 = 1 rad
+      - Reciprocal of ppr is folded into scale once, conversion is one 32x32
+	multiply-accumulate and one shift, no division and no float
+      - Error is within 1 LSB of output over full multi turn range
+  3. BRITER_Convert() for one count, also take signed motion from
+      BRITER_Model_Delta()
+  4. Batch conversion in one pass
+      - BRITER_Convert_Array(), many sample of one encoder or of encoders
+	sharing model, loop has no branch and auto vectorize on host
+      - BRITER_Convert_Gather(), one converter per sample, e.g. snapshot of
+	encoders with different model
+      - On Cortex-M4/M7 with DSP extension (__ARM_FEATURE_DSP),
+	BRITER_Convert_Array() use SMMULR, one cycle most significant word
+	multiply with rounding, when count range fit, still within 1 LSB
+  5. With BRITER_PROFILE, batch conversion record its cycle under
+      BRITER_PROFILE_CONVERT, refer to briter_encoder_profile.h
+*/
+#ifndef BRITER_ENCODER_CONVERT_H_
+#define BRITER_ENCODER_CONVERT_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+#include "briter_encoder_model.h"
+
+/** @defgroup BRITER_ENCODER_CONVERT_Exported_Constants
+ * @{
+ */
+#define BRITER_CONVERT_Q		16	/*!< Fraction bit of output*/
+#define BRITER_CONVERT_UNIT_Q		32	/*!< Fraction bit of unit per revolution*/
+#define BRITER_CONVERT_RADIAN		26986075409ULL	/*!< 2 pi in BRITER_CONVERT_UNIT_Q*/
+#define BRITER_CONVERT_DEGREE		(360ULL << BRITER_CONVERT_UNIT_Q)
+#define BRITER_CONVERT_MSW_NONE		0xFF	/*!< Range do not fit DSP path*/
+/**
+ * @}
+ */
+
+/** Precomputed scale, output = (count * scale + round) >> shift*/
+typedef struct {
+    uint32_t scale; /*!< Output per count, normalized to top bit set*/
+    uint8_t shift;
+    int64_t round; /*!< Half output LSB before shift*/
+    int32_t msw_scale; /*!< Scale of DSP path, top bit dropped for signed multiply*/
+    uint8_t msw_shift; /*!< Count left shift of DSP path, BRITER_CONVERT_MSW_NONE if unused*/
+} Briter_Convert_t;
+
+/**
+* @brief  Convert one count.
+* @param  conv: converter from BRITER_Convert_Init()
+* @param  count: position or signed motion in count
+* @retval value in BRITER_CONVERT_Q fixed point
+*/
+static inline int32_t BRITER_Convert(const Briter_Convert_t *conv, int32_t count) {
+    return (int32_t) (((int64_t) count * conv->scale + conv->round) >> conv->shift);
+}
+
+/** @defgroup Briter_Convert_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Fold unit and ppr of model into scale.
+* @param  conv: converter
+* @param  model: model descriptor
+* @param  unit_per_rev: output unit per revolution in BRITER_CONVERT_UNIT_Q fixed point
+* @retval HAL status, HAL_ERROR if full range do not fit 32 bit output
+*/
+HAL_StatusTypeDef BRITER_Convert_Init(Briter_Convert_t *conv, const Briter_Model_t *model, uint64_t unit_per_rev);
+
+/**
+* @brief  Convert many count with one converter.
+* @param  conv: converter
+* @param  count: input count, n entry, below modulus of model
+* @param  out: output, n entry, must not overlap count
+* @param  n: number of sample
+* @retval none
+*/
+void BRITER_Convert_Array(const Briter_Convert_t *conv, const uint32_t *restrict count, int32_t *restrict out, uint32_t n);
+
+/**
+* @brief  Convert many count, each with its own converter.
+* @param  conv: converter of each sample, n entry
+* @param  count: input count, n entry, below modulus of model
+* @param  out: output, n entry, must not overlap count
+* @param  n: number of sample
+* @retval none
+*/
+void BRITER_Convert_Gather(const Briter_Convert_t *const *conv, const uint32_t *restrict count, int32_t *restrict out, uint32_t n);
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_CONVERT_H_ */
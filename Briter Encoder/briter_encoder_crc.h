@@ -0,0 +1,79 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_crc.h
+  * @author  Ang Chin Xian
+  * @brief   CRC-16/Modbus engine used by the Briter RS485 driver.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. BRITER_CRC16_Calculate() returns the CRC of a whole buffer, low byte is
+      sent first on the wire
+  2. BRITER_CRC16_Update() / BRITER_CRC16_UpdateByte() continue a running CRC,
+      start from BRITER_CRC16_INIT
+  3. Running the CRC over a complete frame including its CRC bytes gives 0
+      when the frame is valid
+  4. Table size is selected at compile time with BRITER_CRC16_SLICE
+      - 1 : byte-wise lookup, 512 byte table
+      - 2 : slice-by-2, 1 KB table
+      - 4 : slice-by-4, 2 KB table
+*/
+#ifndef BRITER_ENCODER_CRC_H_
+#define BRITER_ENCODER_CRC_H_
+
+#include <stdint.h>
+
+/** @defgroup BRITER_ENCODER_CRC_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_CRC16_SLICE
+#define BRITER_CRC16_SLICE	1	/*!< Number of lookup tables, 1, 2 or 4*/
+#endif
+
+#if (BRITER_CRC16_SLICE != 1) && (BRITER_CRC16_SLICE != 2) && (BRITER_CRC16_SLICE != 4)
+#error "BRITER_CRC16_SLICE must be 1, 2 or 4"
+#endif
+
+#define BRITER_CRC16_INIT	0xFFFF	/*!< Initial value of CRC-16/Modbus*/
+/**
+ * @}
+ */
+
+/** Lookup tables, [0] is the byte-wise table*/
+extern const uint16_t Briter_CRC16_Table[BRITER_CRC16_SLICE][256];
+
+/** @defgroup Briter_CRC_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Update running CRC with a single byte.
+* @param  crc: running CRC value
+* @param  byte: next byte
+* @retval updated CRC value
+*/
+static inline uint16_t BRITER_CRC16_UpdateByte(uint16_t crc, uint8_t byte) {
+    return (uint16_t) ((crc >> 8) ^ Briter_CRC16_Table[0][(uint8_t) (crc ^ byte)]);
+}
+
+/**
+* @brief  Update running CRC with a buffer.
+* @param  crc: running CRC value
+* @param  pbuf: pointer to buffer
+* @param  num: number of byte in buffer
+* @retval updated CRC value
+*/
+uint16_t BRITER_CRC16_Update(uint16_t crc, const uint8_t *pbuf, uint16_t num);
+
+/**
+* @brief  Calculate CRC of buffer.
+* @param  pbuf: pointer to buffer
+* @param  num: number of byte in buffer
+* @retval CRC value
+*/
+uint16_t BRITER_CRC16_Calculate(const uint8_t *pbuf, uint16_t num);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_CRC_H_ */
@@ -0,0 +1,167 @@
+/**
+ * @file   briter_encoder_estimator.c
+ * @brief  Source file of alpha-beta-gamma encoder estimator.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_estimator.h"
+
+/** Shortest sample interval used, in Q16 period, keep reciprocal within 2^20*/
+#define ESTIMATOR_MIN_DT	(1 << 12)
+/** Rate correction bound, any larger value saturate int32 after scaling by reciprocal of longest gap*/
+#define ESTIMATOR_MAX_TERM	((int64_t) 1 << 42)
+
+/** @defgroup briter_encoder_estimator Private Functions
+ * @{
+ */
+static int32_t Estimator_Saturate(int64_t value);
+static int64_t Estimator_Clamp(int64_t value);
+static int64_t Estimator_Gain(int64_t residual, int32_t gain);
+static void Estimator_Seed(Briter_Estimator_t *estimator, uint32_t position, uint32_t timestamp);
+/**
+ * @}
+ */
+
+HAL_StatusTypeDef BRITER_Estimator_Init(Briter_Estimator_t *estimator, uint32_t modulus, uint32_t period, int32_t alpha, int32_t beta, int32_t gamma) {
+    if (!estimator || period == 0 || period > BRITER_ESTIMATOR_MAX_PERIOD || alpha <= 0 || alpha > 0x10000 || beta < 0 || gamma < 0)
+	return HAL_ERROR;
+    //Full 32 bit position wraps at 2^32 count
+    estimator->modulus = modulus ? (int64_t) modulus << 16 : (int64_t) 1 << 48;
+    estimator->period = period;
+    estimator->alpha = alpha;
+    estimator->beta = beta;
+    estimator->gamma = gamma;
+    BRITER_Estimator_Reset(estimator);
+    return HAL_OK;
+}
+
+void BRITER_Estimator_Reset(Briter_Estimator_t *estimator) {
+    estimator->position = 0;
+    estimator->velocity = 0;
+    estimator->acceleration = 0;
+    estimator->last_timestamp = 0;
+    estimator->initialized = 0;
+}
+
+void BRITER_Estimator_Update(Briter_Estimator_t *estimator, uint32_t position, uint32_t timestamp) {
+    uint32_t wrap = (uint32_t) (estimator->modulus >> 16);
+    //Out of range sample would put residual beyond half modulus
+    if (wrap && position >= wrap)
+	position %= wrap;
+    uint32_t dt = timestamp - estimator->last_timestamp;
+    if (!estimator->initialized || dt > BRITER_ESTIMATOR_MAX_GAP * estimator->period) {
+	Estimator_Seed(estimator, position, timestamp);
+	return;
+    }
+    if (dt == 0)
+	return;
+    estimator->last_timestamp = timestamp;
+
+    //Interval in Q16 period and its reciprocal, only 32 bit division
+    uint32_t dtn = ((dt / estimator->period) << 16) + ((dt % estimator->period) << 16) / estimator->period;
+    if (dtn < ESTIMATOR_MIN_DT)
+	dtn = ESTIMATOR_MIN_DT;
+    int64_t inv = (int64_t) (0xFFFFFFFFUL / dtn);
+
+    //Predict
+    int64_t a_dt = ((int64_t) estimator->acceleration * dtn) >> 16;
+    int64_t step = (((int64_t) estimator->velocity * dtn) >> 16) + ((a_dt * dtn) >> 17);
+    int64_t v_predict = estimator->velocity + a_dt;
+
+    //Residual taken the short way around the wrap, motion beyond half modulus is not observable
+    int64_t half = estimator->modulus >> 1;
+    if (step >= half)
+	step = half - 1;
+    if (step < -half)
+	step = -half;
+    int64_t predict = estimator->position + step;
+    if (predict >= estimator->modulus)
+	predict -= estimator->modulus;
+    if (predict < 0)
+	predict += estimator->modulus;
+    int64_t residual = ((int64_t) position << 16) - predict;
+    if (residual >= half)
+	residual -= estimator->modulus;
+    if (residual < -half)
+	residual += estimator->modulus;
+
+    //Correct, residual reach 2^47 with full 32 bit position, gain apply before the reciprocal
+    int64_t corrected = predict + Estimator_Gain(residual, estimator->alpha);
+    if (corrected >= estimator->modulus)
+	corrected -= estimator->modulus;
+    if (corrected < 0)
+	corrected += estimator->modulus;
+    estimator->position = corrected;
+    int64_t dv = Estimator_Clamp(Estimator_Gain(residual, estimator->beta));
+    int64_t da = Estimator_Clamp(Estimator_Gain(residual, estimator->gamma) * 2);
+    estimator->velocity = Estimator_Saturate(v_predict + ((dv * inv) >> 16));
+    estimator->acceleration = Estimator_Saturate(estimator->acceleration + ((Estimator_Clamp((da * inv) >> 16) * inv) >> 16));
+}
+
+uint32_t BRITER_Estimator_GetPosition(const Briter_Estimator_t *estimator) {
+    int64_t position = (estimator->position + 0x8000) >> 16;
+    //Rounding may reach modulus
+    if (position >= (estimator->modulus >> 16))
+	position -= estimator->modulus >> 16;
+    return (uint32_t) position;
+}
+
+int32_t BRITER_Estimator_GetVelocity(const Briter_Estimator_t *estimator) {
+    return estimator->velocity;
+}
+
+int32_t BRITER_Estimator_GetAcceleration(const Briter_Estimator_t *estimator) {
+    return estimator->acceleration;
+}
+
+/**
+ * @brief  Restart filter at measured position with zero velocity.
+ * @param  estimator pointer to estimator handler
+ * @param  position raw encoder position
+ * @param  timestamp tick when position was received
+ * @retval none
+ */
+static void Estimator_Seed(Briter_Estimator_t *estimator, uint32_t position, uint32_t timestamp) {
+    estimator->position = (int64_t) position << 16;
+    estimator->velocity = 0;
+    estimator->acceleration = 0;
+    estimator->last_timestamp = timestamp;
+    estimator->initialized = 1;
+}
+
+/**
+ * @brief  Clamp value to int32 range.
+ * @param  value value to clamp
+ * @retval clamped value
+ */
+static int32_t Estimator_Saturate(int64_t value) {
+    if (value > INT32_MAX)
+	return INT32_MAX;
+    if (value < INT32_MIN)
+	return INT32_MIN;
+    return (int32_t) value;
+}
+
+/**
+ * @brief  Bound rate correction so scaling by reciprocal stay in int64.
+ * @param  value correction
+ * @retval value within ESTIMATOR_MAX_TERM
+ */
+static int64_t Estimator_Clamp(int64_t value) {
+    if (value > ESTIMATOR_MAX_TERM)
+	return ESTIMATOR_MAX_TERM;
+    if (value < -ESTIMATOR_MAX_TERM)
+	return -ESTIMATOR_MAX_TERM;
+    return value;
+}
+
+/**
+ * @brief  Multiply residual by Q16 gain without 64 bit overflow.
+ * @param  residual Q16 count, within +-2^47
+ * @param  gain Q16 gain
+ * @retval (residual * gain) >> 16
+ */
+static int64_t Estimator_Gain(int64_t residual, int32_t gain) {
+    //Split residual so no partial product exceed 2^62
+    return (residual >> 16) * gain + (((residual & 0xFFFF) * gain) >> 16);
+}
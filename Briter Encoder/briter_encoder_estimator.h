@@ -0,0 +1,118 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_estimator.h
+  * @author  Ang Chin Xian
+  * @brief   Fixed-point velocity and acceleration estimator for Briter
+  *          encoder position, usable with both RS485 and CAN driver.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Initialize with BRITER_Estimator_Init()
+      - modulus : value where position wrap, model->modulus of handler
+	or 0 when position use full 32 bit
+      - period  : nominal tick between two sample, velocity and acceleration
+	are expressed per period so they keep good resolution in Q16, at most
+	BRITER_ESTIMATOR_MAX_PERIOD so interval fit 32 bit Q16 math
+      - gain    : alpha, beta, gamma in Q16, BRITER_ESTIMATOR_*_DEFAULT if unsure,
+	alpha at most 1.0
+  2. Call BRITER_Estimator_Update() with every timestamped sample, e.g. from
+      Briter_Sample_t, it can run inside receive interrupt
+  3. Read result
+      - BRITER_Estimator_GetPosition()     : filtered position, count
+      - BRITER_Estimator_GetVelocity()     : Q16 count per period
+      - BRITER_Estimator_GetAcceleration() : Q16 count per period^2
+  4. Filter is an alpha-beta-gamma tracking loop in integer only, no float
+      and no 64 bit division, cost is constant per sample
+  5. Position change between two sample must stay below half of modulus,
+      sample older than BRITER_ESTIMATOR_MAX_GAP period restart the filter
+*/
+#ifndef BRITER_ENCODER_ESTIMATOR_H_
+#define BRITER_ENCODER_ESTIMATOR_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+
+/** @defgroup BRITER_ENCODER_ESTIMATOR_Exported_Constants
+ * @{
+ */
+#define BRITER_ESTIMATOR_ALPHA_DEFAULT	26214	/*!< 0.4 in Q16*/
+#define BRITER_ESTIMATOR_BETA_DEFAULT	6554	/*!< 0.1 in Q16*/
+#define BRITER_ESTIMATOR_GAMMA_DEFAULT	328	/*!< 0.005 in Q16*/
+#define BRITER_ESTIMATOR_MAX_GAP	16	/*!< Period without sample before filter restart*/
+#define BRITER_ESTIMATOR_MAX_PERIOD	0xFFFF	/*!< Longest period accepted by BRITER_Estimator_Init()*/
+/**
+ * @}
+ */
+
+/** Estimator handler*/
+typedef struct {
+    int64_t modulus; /*!< Position wrap in Q16 count*/
+    uint32_t period; /*!< Nominal tick between sample*/
+    int32_t alpha; /*!< Position gain, Q16*/
+    int32_t beta; /*!< Velocity gain, Q16*/
+    int32_t gamma; /*!< Acceleration gain, Q16*/
+    int64_t position; /*!< Q16 count, inside [0, modulus)*/
+    int32_t velocity; /*!< Q16 count per period*/
+    int32_t acceleration; /*!< Q16 count per period^2*/
+    uint32_t last_timestamp;
+    uint8_t initialized;
+} Briter_Estimator_t;
+
+/** @defgroup Briter_Estimator_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize estimator.
+* @param  estimator: estimator handler
+* @param  modulus: position wrap value, 0 for full 32 bit
+* @param  period: nominal tick between sample, 1 to BRITER_ESTIMATOR_MAX_PERIOD
+* @param  alpha: position gain in Q16, up to 0x10000
+* @param  beta: velocity gain in Q16
+* @param  gamma: acceleration gain in Q16
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Estimator_Init(Briter_Estimator_t *estimator, uint32_t modulus, uint32_t period, int32_t alpha, int32_t beta, int32_t gamma);
+
+/**
+* @brief  Forget state, next sample restart the filter.
+* @param  estimator: estimator handler
+* @retval none
+*/
+void BRITER_Estimator_Reset(Briter_Estimator_t *estimator);
+
+/**
+* @brief  Update estimate with new sample.
+* @param  estimator: estimator handler
+* @param  position: raw encoder position
+* @param  timestamp: tick when position was received
+* @retval none
+*/
+void BRITER_Estimator_Update(Briter_Estimator_t *estimator, uint32_t position, uint32_t timestamp);
+
+/**
+* @brief  Get filtered position.
+* @param  estimator: estimator handler
+* @retval position in count
+*/
+uint32_t BRITER_Estimator_GetPosition(const Briter_Estimator_t *estimator);
+
+/**
+* @brief  Get velocity.
+* @param  estimator: estimator handler
+* @retval Q16 count per period
+*/
+int32_t BRITER_Estimator_GetVelocity(const Briter_Estimator_t *estimator);
+
+/**
+* @brief  Get acceleration.
+* @param  estimator: estimator handler
+* @retval Q16 count per period^2
+*/
+int32_t BRITER_Estimator_GetAcceleration(const Briter_Estimator_t *estimator);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_ESTIMATOR_H_ */
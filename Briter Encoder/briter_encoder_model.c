@@ -0,0 +1,17 @@
+/**
+ * @file   briter_encoder_model.c
+ * @brief  Descriptor table of Briter encoder model.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_model.h"
+
+#define BRITER_MODEL_BIG_ENDIAN_FLAG	1
+#define BRITER_MODEL_LITTLE_ENDIAN_FLAG	0
+
+const Briter_Model_t briter_model[BRITER_MODEL_COUNT] = {
+#define BRITER_MODEL_DESCRIPTOR(name, ppr, turns, order, offset) \
+    { (ppr), (turns), (ppr) * (turns), BRITER_MODEL_##order##_FLAG, (offset), BRITER_Model_##name##_Decode },
+    BRITER_MODEL_LIST(BRITER_MODEL_DESCRIPTOR)
+#undef BRITER_MODEL_DESCRIPTOR
+};
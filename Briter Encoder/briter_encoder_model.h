@@ -0,0 +1,131 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_model.h
+  * @author  Ang Chin Xian
+  * @brief   Model descriptor of Briter encoder variant, resolution, turn and
+  *          value layout in response frame.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Every model is one line of BRITER_MODEL_LIST(), X(name, ppr, turns,
+      order, offset)
+      - order : BIG_ENDIAN or LITTLE_ENDIAN value in frame
+      - offset : first value byte in read response frame
+  2. Other variant is added without touching this file, define in compiler
+      option or briter_encoder_port.h before include
+	#define BRITER_MODEL_USER_LIST(X) X(RS485_1024X16, 1024, 16, BIG_ENDIAN, 3)
+  3. For each model, inline BRITER_Model_<name>_Decode(), _Turn(),
+      _SingleTurn() and _Delta() are generated with every constant folded,
+      use them where the model is known at compile time
+  4. BRITER_MODEL(name) give descriptor, its decode pointer is the generated
+      decoder so handler of different model in one image decode without
+      branch on byte order
+  5. RS485 and CAN handler default to BRITER_MODEL(RS485_4096X24) and
+      BRITER_MODEL(CAN_4096X24), change with BRITER_RS485_SetModel() or
+      BRITER_CAN_SetModel() after init
+*/
+#ifndef BRITER_ENCODER_MODEL_H_
+#define BRITER_ENCODER_MODEL_H_
+
+#include <stdint.h>
+
+/** @defgroup BRITER_ENCODER_MODEL_Exported_Constants
+ * @{
+ */
+/** Value byte order, p point to first value byte*/
+#define BRITER_MODEL_BIG_ENDIAN(p)	((uint32_t) (p)[0] << (3 * 8) | (uint32_t) (p)[1] << (2 * 8) | (uint32_t) (p)[2] << (1 * 8) | (uint32_t) (p)[3] << (0 * 8))
+#define BRITER_MODEL_LITTLE_ENDIAN(p)	((uint32_t) (p)[0] << (0 * 8) | (uint32_t) (p)[1] << (1 * 8) | (uint32_t) (p)[2] << (2 * 8) | (uint32_t) (p)[3] << (3 * 8))
+
+/** Built-in model, X(name, ppr, turns, order, offset)*/
+#define BRITER_MODEL_BUILTIN_LIST(X) \
+    X(RS485_4096X24, 4096, 24, BIG_ENDIAN, 3) \
+    X(CAN_4096X24, 4096, 24, LITTLE_ENDIAN, 3)
+
+#ifndef BRITER_MODEL_USER_LIST
+#define BRITER_MODEL_USER_LIST(X)
+#endif
+
+#define BRITER_MODEL_LIST(X)	BRITER_MODEL_BUILTIN_LIST(X) BRITER_MODEL_USER_LIST(X)
+/**
+ * @}
+ */
+
+/** Model index, BRITER_MODEL_<name>*/
+typedef enum {
+#define BRITER_MODEL_ENUM(name, ppr, turns, order, offset)	BRITER_MODEL_##name,
+    BRITER_MODEL_LIST(BRITER_MODEL_ENUM)
+#undef BRITER_MODEL_ENUM
+    BRITER_MODEL_COUNT,
+} Briter_Model_e;
+
+/** Model descriptor*/
+typedef struct {
+    uint32_t ppr; /*!< Count per revolution*/
+    uint32_t turns; /*!< Multi turn range*/
+    uint32_t modulus; /*!< Value wrap, ppr * turns*/
+    uint8_t big_endian; /*!< Value byte order in frame*/
+    uint8_t offset; /*!< First value byte in read response frame*/
+    uint32_t (*decode)(const uint8_t *frame); /*!< Generated decoder of model*/
+} Briter_Model_t;
+
+/** Per model decoder and scaling, every constant is folded*/
+#define BRITER_MODEL_FUNCTIONS(name, ppr, turns, order, offset) \
+static inline uint32_t BRITER_Model_##name##_Decode(const uint8_t *frame) { \
+    return BRITER_MODEL_##order(frame + (offset)); \
+} \
+static inline uint32_t BRITER_Model_##name##_Turn(uint32_t value) { \
+    return value / (ppr); \
+} \
+static inline uint32_t BRITER_Model_##name##_SingleTurn(uint32_t value) { \
+    return value % (ppr); \
+} \
+static inline int32_t BRITER_Model_##name##_Delta(uint32_t to, uint32_t from) { \
+    int32_t delta = (int32_t) (to - from); \
+    if (delta > (int32_t) ((ppr) * (turns) / 2)) \
+	delta -= (int32_t) ((ppr) * (turns)); \
+    else if (delta < -(int32_t) ((ppr) * (turns) / 2)) \
+	delta += (int32_t) ((ppr) * (turns)); \
+    return delta; \
+}
+BRITER_MODEL_LIST(BRITER_MODEL_FUNCTIONS)
+
+/** Descriptor of every model, index by ::Briter_Model_e*/
+extern const Briter_Model_t briter_model[BRITER_MODEL_COUNT];
+
+#define BRITER_MODEL(name)	(&briter_model[BRITER_MODEL_##name])
+
+/** @defgroup Briter_Model_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Decode value of read response through descriptor.
+* @param  model: model descriptor
+* @param  frame: read response frame
+* @retval encoder value
+*/
+static inline uint32_t BRITER_Model_Decode(const Briter_Model_t *model, const uint8_t *frame) {
+    return model->decode(frame);
+}
+
+/**
+* @brief  Shortest signed motion between two value of model.
+* @param  model: model descriptor
+* @param  to: later value
+* @param  from: earlier value
+* @retval motion in count, within half modulus
+*/
+static inline int32_t BRITER_Model_Delta(const Briter_Model_t *model, uint32_t to, uint32_t from) {
+    int32_t half = (int32_t) (model->modulus / 2);
+    int32_t delta = (int32_t) (to - from);
+    if (delta > half)
+	delta -= (int32_t) model->modulus;
+    else if (delta < -half)
+	delta += (int32_t) model->modulus;
+    return delta;
+}
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_MODEL_H_ */
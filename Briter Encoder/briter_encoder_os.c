@@ -0,0 +1,22 @@
+/**
+ * @file   briter_encoder_os.c
+ * @brief  Default bare metal operating system shim of Briter encoder drivers.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_os.h"
+#include "briter_encoder_port.h"
+#include <stddef.h>
+
+__weak void* BRITER_OS_Self(void) {
+    return NULL;
+}
+
+__weak void BRITER_OS_Notify(void *waiter) {
+    (void) waiter;
+}
+
+__weak uint8_t BRITER_OS_Wait(uint32_t timeout) {
+    (void) timeout;
+    return 0;
+}
@@ -0,0 +1,49 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_os.h
+  * @author  Ang Chin Xian
+  * @brief   Operating system shim used by asynchronous Briter encoder API.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Bare metal, nothing to do. Default weak function never block, waiting
+      function poll completion flag instead
+  2. RTOS, define the three function in application (weak symbol), e.g.
+      FreeRTOS task notification
+      - BRITER_OS_Self()   return xTaskGetCurrentTaskHandle()
+      - BRITER_OS_Notify() vTaskNotifyGiveFromISR(waiter, &woken) then
+			   portYIELD_FROM_ISR(woken)
+      - BRITER_OS_Wait()   return ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(timeout)) != 0
+  3. Notify is called from UART interrupt, it must be ISR safe
+  4. A test build can put a stub scheduler behind the same three function
+*/
+#ifndef BRITER_ENCODER_OS_H_
+#define BRITER_ENCODER_OS_H_
+
+#include <stdint.h>
+
+/**
+* @brief  Get waiter to notify on completion, called in task starting operation.
+* @retval task handle, NULL if no RTOS
+* @note   Weak, default return NULL
+*/
+void* BRITER_OS_Self(void);
+
+/**
+* @brief  Wake waiter, called from interrupt on completion.
+* @param  waiter: value from BRITER_OS_Self()
+* @retval none
+* @note   Weak, default does nothing
+*/
+void BRITER_OS_Notify(void *waiter);
+
+/**
+* @brief  Block calling task until notified or timeout.
+* @param  timeout: maximum wait in ms
+* @retval 1 if notified, 0 otherwise
+* @note   Weak, default return 0 at once so caller poll
+*/
+uint8_t BRITER_OS_Wait(uint32_t timeout);
+
+#endif /* BRITER_ENCODER_OS_H_ */
@@ -0,0 +1,31 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_port.h
+  * @author  Ang Chin Xian
+  * @brief   Single place where Briter encoder drivers pull in the HAL.
+  *
+  ==============================================================================
+                        ##### How to use this file #####
+  ==============================================================================
+  1. Default is STM32F4 HAL, nothing to do
+  2. For other STM32 family, define BRITER_HAL_HEADER in compiler option,
+      e.g. -DBRITER_HAL_HEADER=\"stm32f7xx_hal.h\"
+  3. For off-target build, point BRITER_HAL_HEADER to a header that provides
+      the HAL type and function used by the drivers
+      - HAL_StatusTypeDef, UART_HandleTypeDef, CAN_HandleTypeDef and CAN
+	header/filter type
+      - HAL_UART_*, HAL_UARTEx_ReceiveToIdle_DMA, HAL_CAN_*, HAL_GetTick
+      - CMSIS __DMB, __get_PRIMASK/__set_PRIMASK, __disable_irq, __weak
+  4. host/briter_host_hal.h is such a header with simulated UART and CAN,
+      CMakeLists.txt build drivers and test/ with it on Linux
+*/
+#ifndef BRITER_ENCODER_PORT_H_
+#define BRITER_ENCODER_PORT_H_
+
+#ifndef BRITER_HAL_HEADER
+#define BRITER_HAL_HEADER	"stm32f4xx_hal.h"
+#endif
+
+#include BRITER_HAL_HEADER
+
+#endif /* BRITER_ENCODER_PORT_H_ */
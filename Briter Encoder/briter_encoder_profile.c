@@ -0,0 +1,84 @@
+/**
+ * @file   briter_encoder_profile.c
+ * @brief  Source file of Briter encoder driver profiling.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_profile.h"
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_can.h"
+#include <stdio.h>
+#include <string.h>
+
+/** Size of RS485 read value request and response*/
+#define PROFILE_RS485_READ_TX	8
+#define PROFILE_RS485_READ_RX	9
+
+static Briter_Profile_Entry_t profile_entry[BRITER_PROFILE_COUNT];
+
+static const char *const profile_name[BRITER_PROFILE_COUNT] = {
+    "crc16",
+    "rs485_build",
+    "rs485_check",
+    "can_tx",
+    "convert",
+};
+
+void BRITER_Profile_Init(void) {
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CYCCNT = 0;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    BRITER_Profile_Reset();
+}
+
+void BRITER_Profile_Reset(void) {
+    memset(profile_entry, 0, sizeof(profile_entry));
+    for (uint8_t i = 0; i < BRITER_PROFILE_COUNT; i++)
+	profile_entry[i].min = 0xFFFFFFFF;
+}
+
+void BRITER_Profile_Record(Briter_Profile_Id_e id, uint32_t cycles) {
+    Briter_Profile_Entry_t *entry = &profile_entry[id];
+    entry->count++;
+    entry->total += cycles;
+    if (cycles < entry->min)
+	entry->min = cycles;
+    if (cycles > entry->max)
+	entry->max = cycles;
+}
+
+void BRITER_Profile_Get(Briter_Profile_Id_e id, Briter_Profile_Entry_t *entry) {
+    *entry = profile_entry[id];
+}
+
+uint32_t BRITER_Profile_Format(char *buf, uint32_t size) {
+    uint32_t len = 0;
+    int n;
+    if (size == 0)
+	return 0;
+    uint32_t mhz = SystemCoreClock / 1000000;
+    for (uint8_t i = 0; i < BRITER_PROFILE_COUNT && len < size; i++) {
+	const Briter_Profile_Entry_t *entry = &profile_entry[i];
+	uint32_t mean = entry->count ? (uint32_t) (entry->total / entry->count) : 0;
+	n = snprintf(&buf[len], size - len, "op,%s,%lu,%lu,%lu,%lu,%lu\n", profile_name[i], (unsigned long) entry->count,
+		(unsigned long) (entry->count ? entry->min : 0), (unsigned long) entry->max, (unsigned long) mean,
+		(unsigned long) (mhz ? mean * 1000 / mhz : 0));
+	len += (n > 0) ? (uint32_t) n : 0;
+    }
+    //Request, t3.5 gap, response and t3.5 gap before next request
+    for (uint8_t i = RS485_ENC_BAUDRATE_9600; i <= RS485_ENC_BAUDRATE_115200 && len < size; i++) {
+	uint32_t bps = BRITER_RS485_BaudrateValue((RS485_Enc_Baudrate_e) i);
+	uint32_t us = BRITER_RS485_FrameTime_us(bps, PROFILE_RS485_READ_TX) + BRITER_RS485_FrameTime_us(bps, PROFILE_RS485_READ_RX)
+		+ 2 * BRITER_RS485_T35_us(bps);
+	n = snprintf(&buf[len], size - len, "bus,rs485_read,%lu,%lu\n", (unsigned long) bps, (unsigned long) us);
+	len += (n > 0) ? (uint32_t) n : 0;
+    }
+    //Request and response, worst case bit stuffing
+    for (uint8_t i = BRITER_CAN_BAUDRATE_500K; i <= BRITER_CAN_BAUDRATE_100K && len < size; i++) {
+	uint32_t bps = BRITER_CAN_BaudrateValue((Briter_CAN_Baudrate_e) i);
+	uint32_t us = BRITER_CAN_FrameTime_us(bps, 4) + BRITER_CAN_FrameTime_us(bps, 7);
+	n = snprintf(&buf[len], size - len, "bus,can_read,%lu,%lu\n", (unsigned long) bps, (unsigned long) us);
+	len += (n > 0) ? (uint32_t) n : 0;
+    }
+    return (len < size) ? len : size - 1;
+}
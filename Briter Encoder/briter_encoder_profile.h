@@ -0,0 +1,96 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_profile.h
+  * @author  Ang Chin Xian
+  * @brief   Cycle count profiling of Briter encoder driver hot path.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Define BRITER_PROFILE in compiler option, without it every profiling
+      macro compile to nothing
+  2. Call BRITER_Profile_Init() once, it start DWT cycle counter
+  3. Run the driver as usual, each profiled operation record its cycle
+  4. BRITER_Profile_Format() write CSV, one line per operation and one line
+      per modeled bus transaction, send it over any port and diff it between
+      release
+      - op,<name>,<count>,<min>,<max>,<mean cycle>,<mean ns>
+      - bus,<transaction>,<bit per second>,<us>
+  5. Record is not protected, profile from one context at a time
+*/
+#ifndef BRITER_ENCODER_PROFILE_H_
+#define BRITER_ENCODER_PROFILE_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+
+/** Profiled operation*/
+typedef enum {
+    BRITER_PROFILE_CRC = 0x00, /*!< BRITER_CRC16_Calculate()*/
+    BRITER_PROFILE_RS485_BUILD, /*!< Encoder_Send_Construct()*/
+    BRITER_PROFILE_RS485_CHECK, /*!< Encoder_CheckRX()*/
+    BRITER_PROFILE_CAN_TX, /*!< CAN request to mailbox*/
+    BRITER_PROFILE_CONVERT, /*!< Batch unit conversion*/
+    BRITER_PROFILE_COUNT,
+} Briter_Profile_Id_e;
+
+/** Cycle statistic of one operation*/
+typedef struct {
+    uint32_t count;
+    uint32_t min;
+    uint32_t max;
+    uint64_t total;
+} Briter_Profile_Entry_t;
+
+#ifdef BRITER_PROFILE
+#define BRITER_PROFILE_BEGIN()		uint32_t briter_profile_start = DWT->CYCCNT
+#define BRITER_PROFILE_END(id)		BRITER_Profile_Record((id), DWT->CYCCNT - briter_profile_start)
+#else
+#define BRITER_PROFILE_BEGIN()
+#define BRITER_PROFILE_END(id)
+#endif
+
+/** @defgroup Briter_Profile_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Start DWT cycle counter and clear record.
+* @retval none
+*/
+void BRITER_Profile_Init(void);
+
+/**
+* @brief  Clear record.
+* @retval none
+*/
+void BRITER_Profile_Reset(void);
+
+/**
+* @brief  Add one measurement.
+* @param  id: profiled operation
+* @param  cycles: cycle taken
+* @retval none
+*/
+void BRITER_Profile_Record(Briter_Profile_Id_e id, uint32_t cycles);
+
+/**
+* @brief  Get statistic of operation.
+* @param  id: profiled operation
+* @param  entry: copy of statistic
+* @retval none
+*/
+void BRITER_Profile_Get(Briter_Profile_Id_e id, Briter_Profile_Entry_t *entry);
+
+/**
+* @brief  Write record and modeled bus time as CSV.
+* @param  buf: output buffer
+* @param  size: size of output buffer
+* @retval number of character written, without null terminator
+*/
+uint32_t BRITER_Profile_Format(char *buf, uint32_t size);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_PROFILE_H_ */
@@ -0,0 +1,300 @@
+/**
+ * @file   briter_encoder_record.c
+ * @brief  Source file of Briter encoder sample recording and replay.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_record.h"
+#include "briter_encoder_crc.h"
+#include <string.h>
+
+#define RECORD_MAGIC_0	'B'
+#define RECORD_MAGIC_1	'R'
+
+/** @defgroup briter_encoder_record Private Functions
+ * @{
+ */
+static uint8_t Record_Put_Varint(uint8_t *p, uint32_t value);
+static uint8_t Record_Get_Varint(const uint8_t *p, uint32_t end, uint32_t *pos, uint32_t *value);
+static int8_t Record_Channel_Find(const Briter_Record_Channel_t *channel, uint8_t address);
+static void Record_Open(Briter_Recorder_t *rec);
+static void Record_Close(Briter_Recorder_t *rec);
+static uint8_t Replay_Open(Briter_Replay_t *rep);
+static uint8_t Replay_Record(Briter_Replay_t *rep, Briter_Record_Sample_t *sample);
+/**
+ * @}
+ */
+
+HAL_StatusTypeDef BRITER_Record_Init(Briter_Recorder_t *rec, uint8_t *buf, uint32_t size, Briter_Record_Sink sink, void *context,
+	uint16_t keyframe_interval) {
+    if (!rec || !buf || size < BRITER_RECORD_HEADER_SIZE + BRITER_RECORD_SAMPLE_MAX + BRITER_RECORD_CRC_SIZE)
+	return HAL_ERROR;
+    memset(rec, 0, sizeof(Briter_Recorder_t));
+    rec->buf = buf;
+    rec->size = size;
+    rec->sink = sink;
+    rec->context = context;
+    rec->keyframe_interval = keyframe_interval;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Record_Add(Briter_Recorder_t *rec, const Briter_Record_Sample_t *sample) {
+    //Block full or keyframe due, next record start a new block
+    if (rec->block_len
+	    && (rec->block_len + BRITER_RECORD_SAMPLE_MAX + BRITER_RECORD_CRC_SIZE > BRITER_RECORD_BLOCK_MAX
+		    || rec->block + rec->block_len + BRITER_RECORD_SAMPLE_MAX + BRITER_RECORD_CRC_SIZE > rec->size
+		    || (rec->keyframe_interval && rec->block_record >= rec->keyframe_interval)))
+	Record_Close(rec);
+    if (!rec->block_len) {
+	if (rec->len + BRITER_RECORD_HEADER_SIZE + BRITER_RECORD_SAMPLE_MAX + BRITER_RECORD_CRC_SIZE > rec->size) {
+	    if (!rec->sink) {
+		rec->dropped_count++;
+		return HAL_ERROR;
+	    }
+	    rec->sink(rec->context, rec->buf, rec->len);
+	    rec->len = 0;
+	}
+	Record_Open(rec);
+    }
+
+    uint8_t *p = &rec->buf[rec->block + rec->block_len];
+    uint8_t n = 0;
+    uint8_t flags = (uint8_t) (sample->result & BRITER_RECORD_RESULT_MASK);
+    int8_t slot = Record_Channel_Find(&rec->channel, sample->address);
+    if (sample->result == BRITER_STATS_OK && slot < 0)
+	flags |= BRITER_RECORD_KEYFRAME;
+    p[n++] = sample->address;
+    p[n++] = flags;
+    //Tick is unsigned, wrap of tick counter give small delta too
+    n += Record_Put_Varint(&p[n], rec->block_record ? sample->timestamp - rec->last_timestamp : sample->timestamp);
+    rec->last_timestamp = sample->timestamp;
+    if (sample->result == BRITER_STATS_OK) {
+	if (flags & BRITER_RECORD_KEYFRAME) {
+	    n += Record_Put_Varint(&p[n], sample->position);
+	    //Address beyond table stay keyframe for whole block
+	    if (rec->channel.count < BRITER_RECORD_MAX_CHANNEL) {
+		slot = (int8_t) rec->channel.count++;
+		rec->channel.address[slot] = sample->address;
+	    }
+	}
+	else {
+	    //Zigzag keep small motion small in both direction
+	    int32_t delta = (int32_t) (sample->position - rec->channel.position[slot]);
+	    n += Record_Put_Varint(&p[n], ((uint32_t) delta << 1) ^ (uint32_t) (delta >> 31));
+	}
+	if (slot >= 0)
+	    rec->channel.position[slot] = sample->position;
+    }
+    rec->block_len += n;
+    rec->block_record++;
+    rec->record_count++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Record_AddSample(Briter_Recorder_t *rec, uint8_t address, const Briter_Sample_t *sample) {
+    Briter_Record_Sample_t record;
+    record.address = address;
+    record.result = BRITER_STATS_OK;
+    record.position = sample->position;
+    record.timestamp = sample->timestamp;
+    return BRITER_Record_Add(rec, &record);
+}
+
+void BRITER_Record_Flush(Briter_Recorder_t *rec) {
+    if (rec->block_len)
+	Record_Close(rec);
+    if (rec->sink && rec->len) {
+	rec->sink(rec->context, rec->buf, rec->len);
+	rec->len = 0;
+    }
+}
+
+const uint8_t* BRITER_Record_GetData(const Briter_Recorder_t *rec, uint32_t *size) {
+    *size = rec->len;
+    return rec->buf;
+}
+
+HAL_StatusTypeDef BRITER_Replay_Init(Briter_Replay_t *rep, const uint8_t *data, uint32_t size) {
+    if (!rep || !data)
+	return HAL_ERROR;
+    memset(rep, 0, sizeof(Briter_Replay_t));
+    rep->data = data;
+    rep->size = size;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Replay_Next(Briter_Replay_t *rep, Briter_Record_Sample_t *sample) {
+    while (1) {
+	if (!rep->block_end || rep->pos >= rep->block_end) {
+	    if (rep->block_end)
+		rep->pos = rep->block_end + BRITER_RECORD_CRC_SIZE;
+	    rep->block_end = 0;
+	    if (!Replay_Open(rep))
+		return HAL_ERROR;
+	}
+	if (Replay_Record(rep, sample))
+	    return HAL_OK;
+	//Record do not decode though CRC passed, drop rest of block
+	rep->bad_block_count++;
+	rep->pos = rep->block_end;
+    }
+}
+
+/**
+ * @brief  Write LEB128 varint.
+ * @param  p output, up to 5 byte
+ * @param  value value to write
+ * @retval number of byte written
+ */
+static uint8_t Record_Put_Varint(uint8_t *p, uint32_t value) {
+    uint8_t n = 0;
+    while (value >= 0x80) {
+	p[n++] = (uint8_t) (value | 0x80);
+	value >>= 7;
+    }
+    p[n++] = (uint8_t) value;
+    return n;
+}
+
+/**
+ * @brief  Read LEB128 varint.
+ * @param  p capture
+ * @param  end end of readable byte
+ * @param  pos read position, advanced past varint
+ * @param  value output value
+ * @retval 1 if read, 0 if truncated or longer than 5 byte
+ */
+static uint8_t Record_Get_Varint(const uint8_t *p, uint32_t end, uint32_t *pos, uint32_t *value) {
+    uint32_t result = 0;
+    for (uint8_t shift = 0; shift < 35 && *pos < end; shift += 7) {
+	uint8_t byte = p[(*pos)++];
+	result |= (uint32_t) (byte & 0x7F) << shift;
+	if (!(byte & 0x80)) {
+	    *value = result;
+	    return 1;
+	}
+    }
+    return 0;
+}
+
+/**
+ * @brief  Find address in channel table.
+ * @param  channel channel table
+ * @param  address handler address
+ * @retval slot, -1 if not found
+ */
+static int8_t Record_Channel_Find(const Briter_Record_Channel_t *channel, uint8_t address) {
+    for (uint8_t i = 0; i < channel->count; i++) {
+	if (channel->address[i] == address)
+	    return (int8_t) i;
+    }
+    return -1;
+}
+
+/**
+ * @brief  Start block after closed block, every address start with keyframe.
+ * @param  rec pointer to recorder
+ * @retval none
+ */
+static void Record_Open(Briter_Recorder_t *rec) {
+    rec->block = rec->len;
+    rec->block_len = BRITER_RECORD_HEADER_SIZE;
+    rec->block_record = 0;
+    rec->channel.count = 0;
+}
+
+/**
+ * @brief  Write header and CRC of open block.
+ * @param  rec pointer to recorder
+ * @retval none
+ */
+static void Record_Close(Briter_Recorder_t *rec) {
+    uint8_t *p = &rec->buf[rec->block];
+    uint16_t length = rec->block_len - BRITER_RECORD_HEADER_SIZE;
+    p[0] = RECORD_MAGIC_0;
+    p[1] = RECORD_MAGIC_1;
+    p[2] = (uint8_t) ((length >> 0) & 0xFF);
+    p[3] = (uint8_t) ((length >> 8) & 0xFF);
+    uint16_t crc = BRITER_CRC16_Calculate(p, rec->block_len);
+    p[rec->block_len] = (uint8_t) ((crc >> 0) & 0xFF);
+    p[rec->block_len + 1] = (uint8_t) ((crc >> 8) & 0xFF);
+    rec->len = rec->block + rec->block_len + BRITER_RECORD_CRC_SIZE;
+    rec->block = rec->len;
+    rec->block_len = 0;
+}
+
+/**
+ * @brief  Find next block with valid header and CRC.
+ * @param  rep pointer to decoder
+ * @retval 1 if block opened, 0 at end of capture
+ */
+static uint8_t Replay_Open(Briter_Replay_t *rep) {
+    const uint8_t *p = rep->data;
+    while (rep->pos + BRITER_RECORD_HEADER_SIZE + BRITER_RECORD_CRC_SIZE <= rep->size) {
+	uint32_t pos = rep->pos;
+	if (p[pos] != RECORD_MAGIC_0 || p[pos + 1] != RECORD_MAGIC_1) {
+	    //Lost sync, search byte by byte
+	    rep->pos++;
+	    continue;
+	}
+	uint32_t length = (uint32_t) p[pos + 2] | (uint32_t) p[pos + 3] << 8;
+	uint32_t end = pos + BRITER_RECORD_HEADER_SIZE + length;
+	if (length <= BRITER_RECORD_BLOCK_MAX && end + BRITER_RECORD_CRC_SIZE <= rep->size
+		&& BRITER_CRC16_Calculate(&p[pos], (uint16_t) (end + BRITER_RECORD_CRC_SIZE - pos)) == 0) {
+	    rep->pos = pos + BRITER_RECORD_HEADER_SIZE;
+	    rep->block_end = end;
+	    rep->first = 1;
+	    rep->channel.count = 0;
+	    return 1;
+	}
+	rep->bad_block_count++;
+	rep->pos++;
+    }
+    return 0;
+}
+
+/**
+ * @brief  Decode next record of open block.
+ * @param  rep pointer to decoder
+ * @param  sample output sample
+ * @retval 1 if decoded, 0 if record is malformed
+ */
+static uint8_t Replay_Record(Briter_Replay_t *rep, Briter_Record_Sample_t *sample) {
+    const uint8_t *p = rep->data;
+    uint32_t pos = rep->pos;
+    uint32_t value;
+    if (pos + 2 > rep->block_end)
+	return 0;
+    sample->address = p[pos++];
+    uint8_t flags = p[pos++];
+    sample->result = (Briter_Stats_Class_e) (flags & BRITER_RECORD_RESULT_MASK);
+    if (sample->result >= BRITER_STATS_CLASS_COUNT || !Record_Get_Varint(p, rep->block_end, &pos, &value))
+	return 0;
+    sample->timestamp = rep->first ? value : rep->last_timestamp + value;
+    rep->last_timestamp = sample->timestamp;
+    rep->first = 0;
+    sample->position = 0;
+    if (sample->result == BRITER_STATS_OK) {
+	if (!Record_Get_Varint(p, rep->block_end, &pos, &value))
+	    return 0;
+	int8_t slot = Record_Channel_Find(&rep->channel, sample->address);
+	if (flags & BRITER_RECORD_KEYFRAME) {
+	    sample->position = value;
+	    //Same table rule as recorder
+	    if (slot < 0 && rep->channel.count < BRITER_RECORD_MAX_CHANNEL) {
+		slot = (int8_t) rep->channel.count++;
+		rep->channel.address[slot] = sample->address;
+	    }
+	}
+	else {
+	    if (slot < 0)
+		return 0;
+	    int32_t delta = (int32_t) (value >> 1) ^ -(int32_t) (value & 1);
+	    sample->position = rep->channel.position[slot] + (uint32_t) delta;
+	}
+	if (slot >= 0)
+	    rep->channel.position[slot] = sample->position;
+    }
+    rep->pos = pos;
+    return 1;
+}
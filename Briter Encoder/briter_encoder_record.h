@@ -0,0 +1,178 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_record.h
+  * @author  Ang Chin Xian
+  * @brief   Compact binary recording and replay of Briter encoder sample.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Give BRITER_Record_Init() a buffer and optionally a sink, no heap is used
+      - With sink, full buffer is handed to sink (flash write, UART DMA...)
+	and reused, sink must copy or finish before return
+      - Without sink, recording stop when buffer is full, read it with
+	BRITER_Record_GetData()
+  2. Feed every decoded sample with BRITER_Record_Add(), or
+      BRITER_Record_AddSample() for Briter_Sample_t popped from RS485/CAN ring
+      - Failed read is recorded too, result is kept and position is not
+  3. BRITER_Record_Flush() close current block, call it before power down
+  4. Record is from one context at a time, e.g. task draining sample ring
+  5. Format, all multi byte field little endian
+      - Block : 'B' 'R' length(2) record... crc(2), CRC-16/Modbus of header
+	and record, block close when full, after keyframe_interval record
+	or on flush
+      - Record : address(1) flags(1) [timestamp(varint)] [position(varint)]
+      - flags bit 0-3 ::Briter_Stats_Class_e, bit 7 keyframe
+      - First record of block carry absolute timestamp, other carry tick
+	since previous record
+      - Keyframe carry absolute position, first valid sample of each address
+	in block is keyframe, other carry zigzag delta from previous
+	position of same address
+      - Every block decode alone, corrupted block is skipped
+  6. BRITER_Replay_Init()/BRITER_Replay_Next() decode capture back to sample,
+      on target or host
+  7. tool/briter_replay feed capture file through simulated HAL on Linux,
+      each address read back by the driver at original or accelerated speed
+*/
+#ifndef BRITER_ENCODER_RECORD_H_
+#define BRITER_ENCODER_RECORD_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+#include "briter_encoder_sample.h"
+#include "briter_encoder_stats.h"
+
+/** @defgroup BRITER_ENCODER_RECORD_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_RECORD_MAX_CHANNEL
+#define BRITER_RECORD_MAX_CHANNEL	8	/*!< Address with delta position per block*/
+#endif
+#ifndef BRITER_RECORD_BLOCK_MAX
+#define BRITER_RECORD_BLOCK_MAX		256	/*!< Largest block, header and CRC included*/
+#endif
+#define BRITER_RECORD_HEADER_SIZE	4
+#define BRITER_RECORD_CRC_SIZE		2
+#define BRITER_RECORD_SAMPLE_MAX	12	/*!< Largest record, address, flags and two 5 byte varint*/
+#define BRITER_RECORD_KEYFRAME		0x80	/*!< Flags bit of keyframe record*/
+#define BRITER_RECORD_RESULT_MASK	0x0F
+/**
+ * @}
+ */
+
+/** Sample as recorded*/
+typedef struct {
+    uint8_t address; /*!< Handler address*/
+    Briter_Stats_Class_e result; /*!< BRITER_STATS_OK, or failure class of read*/
+    uint32_t position; /*!< Raw encoder value, only if result is OK*/
+    uint32_t timestamp; /*!< BRITER_Encoder_GetTick()*/
+} Briter_Record_Sample_t;
+
+/** Position of address already sent in block*/
+typedef struct {
+    uint8_t count;
+    uint8_t address[BRITER_RECORD_MAX_CHANNEL];
+    uint32_t position[BRITER_RECORD_MAX_CHANNEL];
+} Briter_Record_Channel_t;
+
+/** Receive finished buffer of block*/
+typedef void (*Briter_Record_Sink)(void *context, const uint8_t *data, uint32_t size);
+
+/** Recorder*/
+typedef struct {
+    uint8_t *buf;
+    uint32_t size;
+    uint32_t len; /*!< Byte of closed block in buf*/
+    uint32_t block; /*!< Start of open block, equal len if none*/
+    uint16_t block_len; /*!< Byte of open block, header included*/
+    uint16_t block_record; /*!< Record in open block*/
+    uint16_t keyframe_interval; /*!< Record per block, 0 for as many as fit*/
+    uint32_t last_timestamp;
+    Briter_Record_Channel_t channel;
+    Briter_Record_Sink sink;
+    void *context;
+    uint32_t record_count; /*!< Sample recorded*/
+    uint32_t dropped_count; /*!< Sample lost as buffer was full without sink*/
+} Briter_Recorder_t;
+
+/** Decoder of capture*/
+typedef struct {
+    const uint8_t *data;
+    uint32_t size;
+    uint32_t pos; /*!< Next record, or next block if none open*/
+    uint32_t block_end; /*!< End of record of open block, 0 if none*/
+    uint32_t last_timestamp;
+    uint8_t first; /*!< Next record is first of block*/
+    Briter_Record_Channel_t channel;
+    uint32_t bad_block_count; /*!< Block skipped for CRC or format error*/
+} Briter_Replay_t;
+
+/** @defgroup Briter_Record_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize recorder.
+* @param  rec: recorder
+* @param  buf: capture buffer, at least BRITER_RECORD_HEADER_SIZE + BRITER_RECORD_SAMPLE_MAX + BRITER_RECORD_CRC_SIZE
+* @param  size: size of buf
+* @param  sink: called with closed block when buf is full or flushed, NULL to keep them in buf
+* @param  context: passed to sink
+* @param  keyframe_interval: record per block, 0 for as many as BRITER_RECORD_BLOCK_MAX fit
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Record_Init(Briter_Recorder_t *rec, uint8_t *buf, uint32_t size, Briter_Record_Sink sink, void *context,
+	uint16_t keyframe_interval);
+
+/**
+* @brief  Encode one sample.
+* @param  rec: recorder
+* @param  sample: sample to record
+* @retval HAL status, HAL_ERROR if buffer is full and there is no sink
+*/
+HAL_StatusTypeDef BRITER_Record_Add(Briter_Recorder_t *rec, const Briter_Record_Sample_t *sample);
+
+/**
+* @brief  Encode valid sample popped from driver ring.
+* @param  rec: recorder
+* @param  address: handler address
+* @param  sample: sample from BRITER_Sample_Ring_Pop()
+* @retval HAL status, HAL_ERROR if buffer is full and there is no sink
+*/
+HAL_StatusTypeDef BRITER_Record_AddSample(Briter_Recorder_t *rec, uint8_t address, const Briter_Sample_t *sample);
+
+/**
+* @brief  Close open block, hand buffer to sink if any.
+* @param  rec: recorder
+* @retval none
+*/
+void BRITER_Record_Flush(Briter_Recorder_t *rec);
+
+/**
+* @brief  Get closed block kept in buffer, for recorder without sink.
+* @param  rec: recorder
+* @param  size: output byte of closed block
+* @retval pointer to first block
+*/
+const uint8_t* BRITER_Record_GetData(const Briter_Recorder_t *rec, uint32_t *size);
+
+/**
+* @brief  Initialize decoder on capture.
+* @param  rep: decoder
+* @param  data: capture, one or more block
+* @param  size: size of capture
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Replay_Init(Briter_Replay_t *rep, const uint8_t *data, uint32_t size);
+
+/**
+* @brief  Decode next sample.
+* @param  rep: decoder
+* @param  sample: output sample
+* @retval HAL_OK with sample, HAL_ERROR at end of capture
+*/
+HAL_StatusTypeDef BRITER_Replay_Next(Briter_Replay_t *rep, Briter_Record_Sample_t *sample);
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_RECORD_H_ */
@@ -6,6 +6,10 @@
  */
 
 #include "briter_encoder_rs485.h"
+#include "briter_encoder_crc.h"
+#include "briter_encoder_profile.h"
+#include "briter_encoder_time.h"
+#include "briter_encoder_os.h"
 #include <string.h>
 
 /** @defgroup briter_encoder_rs485 function type
@@ -42,11 +46,18 @@ typedef union {
  * @{
  */
 static void Encoder_Send_Construct(Encoder_TX_t *txbuf, RS485_Enc_Func_e func, uint16_t own_addr, uint16_t send_addr, uint16_t read_byte);
+static void Encoder_Query_Construct(Briter_Encoder_t *handler);
+static HAL_StatusTypeDef Encoder_Write_Single(Briter_Encoder_t *handler, uint16_t reg, uint16_t value);
+static HAL_StatusTypeDef Encoder_Write_Multi(Briter_Encoder_t *handler, uint16_t reg, const uint16_t *value, uint8_t count);
+static void Encoder_Store(Briter_Encoder_t *handler, uint32_t value, uint32_t timestamp);
 static HAL_StatusTypeDef Encoder_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
-static HAL_StatusTypeDef Encoder_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
-static HAL_StatusTypeDef Encoder_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
-static HAL_StatusTypeDef Encoder_CheckRX(uint8_t *pData, uint8_t address, RS485_Enc_Func_e func);
-static uint16_t Calculate_CRC(uint8_t pbuf[], uint16_t num);
+static HAL_StatusTypeDef Encoder_Transmit(Briter_Encoder_t *handler, uint8_t *pData, uint16_t Size);
+static HAL_StatusTypeDef Encoder_Receive(Briter_Encoder_t *handler, uint8_t *pData, uint16_t Size);
+static uint32_t Encoder_Timeout(uint32_t us);
+static HAL_StatusTypeDef Encoder_Async_Start(Briter_Encoder_t *handler, RS485_Enc_Func_e func, uint16_t reg, uint16_t value, Briter_RS485_Async_Callback callback, void *context);
+static void Encoder_Async_Done(Briter_Encoder_t *handler, HAL_StatusTypeDef status, uint32_t value);
+static Briter_Stats_Class_e Encoder_CheckRX(uint8_t *pData, uint16_t size, uint8_t address, RS485_Enc_Func_e func);
+static Briter_Stats_Class_e Encoder_Read(Briter_Encoder_t *handler, const uint8_t *request, uint8_t count, uint8_t *pData);
 /**
  * @}
  */
@@ -58,181 +69,216 @@ HAL_StatusTypeDef BRITER_RS485_Init(Briter_Encoder_t *handler, uint8_t address,
     memset(handler, 0, sizeof(Briter_Encoder_t));
     handler->addr = address;
     handler->huart = huart;
+    Encoder_Query_Construct(handler);
+    handler->model = BRITER_MODEL(RS485_4096X24);
+    //Encoder answer at address, so it is known
+    BRITER_Shadow_Init(&handler->shadow);
+    BRITER_Shadow_Update(&handler->shadow, BRITER_RS485_ADDRESS_ADDR, address, HAL_OK);
+    return BRITER_RS485_SetTiming(handler, BRITER_RS485_TURNAROUND_US);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetTiming(Briter_Encoder_t *handler, uint32_t turnaround_us) {
+    uint32_t bps = handler->huart->Init.BaudRate;
+    //UART not configured yet, assume encoder default
+    if (bps == 0)
+	bps = BRITER_RS485_BaudrateValue(RS485_ENC_BAUDRATE_9600);
+    handler->bps = bps;
+    handler->byte_us = BRITER_RS485_FrameTime_us(bps, 1);
+    //Slave keep line silent for t3.5 and its own processing time before answer
+    handler->rx_gap_us = BRITER_RS485_T35_us(bps) + turnaround_us;
+    handler->tx_timeout = Encoder_Timeout(BRITER_RS485_QUERY_FRAME_SIZE * handler->byte_us);
+    handler->rx_timeout = Encoder_Timeout(handler->rx_gap_us + BRITER_RS485_READ_FRAME_SIZE(2) * handler->byte_us);
     return HAL_OK;
 }
 
-uint32_t BRITER_RS485_GetEncoderValue(Briter_Encoder_t *handler) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    //2 as user want to read 2 different register to obtain encoder value
-    Encoder_Send_Construct(&send_t, ENC_READ, handler->addr, BRITER_RS485_VALUE_ADDR, 2);
-    if (Encoder_Transmit(handler->huart, send_t.buf, sizeof(send_t.buf)) != HAL_OK)
-	return BRITER_RS485_ERROR;
+HAL_StatusTypeDef BRITER_RS485_SetModel(Briter_Encoder_t *handler, const Briter_Model_t *model) {
+    if (!model)
+	return HAL_ERROR;
+    handler->model = model;
+    return HAL_OK;
+}
 
-    //Receive return from slave
-    uint8_t receive_buf[9];
-    if (Encoder_Receive(handler->huart, receive_buf, sizeof(receive_buf)) != HAL_OK)
+uint32_t BRITER_RS485_GetEncoderValue(Briter_Encoder_t *handler) {
+    //Send prebuilt request
+    uint8_t receive_buf[BRITER_RS485_READ_FRAME_SIZE(2)];
+    if (Encoder_Read(handler, handler->query_frame, 2, receive_buf) != BRITER_STATS_OK)
 	return BRITER_RS485_ERROR;
+    return handler->encoder_value;
+}
 
-    //Check receive buffer
-    if (Encoder_CheckRX(receive_buf, (uint8_t) (handler->addr), ENC_READ) != HAL_OK)
-	return BRITER_RS485_ERROR;
+HAL_StatusTypeDef BRITER_RS485_ReadBlock(Briter_Encoder_t *handler, uint16_t reg, uint8_t count, uint16_t *value) {
+    if (count == 0 || count > BRITER_RS485_READ_MAX)
+	return HAL_ERROR;
+    Encoder_TX_t send_t;
+    Encoder_Send_Construct(&send_t, ENC_READ, handler->addr, reg, count);
+    uint8_t receive_buf[BRITER_RS485_READ_FRAME_SIZE(BRITER_RS485_READ_MAX)];
+    if (Encoder_Read(handler, send_t.buf, count, receive_buf) != BRITER_STATS_OK)
+	return HAL_ERROR;
+    for (uint8_t i = 0; i < count; i++)
+	value[i] = (uint16_t) (receive_buf[3 + 2 * i] << 8 | receive_buf[4 + 2 * i]);
+    return HAL_OK;
+}
 
-    uint32_t encoder_value = receive_buf[3] << (3 * 8) | receive_buf[4] << (2 * 8) | receive_buf[5] << (1 * 8)
-	    | receive_buf[6] << (0 * 8);
-    return encoder_value;
+HAL_StatusTypeDef BRITER_RS485_GetState(Briter_Encoder_t *handler, Briter_RS485_State_t *state) {
+    //Value, number of turn and single turn are next to each other
+    uint16_t value[4];
+    if (BRITER_RS485_ReadBlock(handler, BRITER_RS485_VALUE_ADDR, 4, value) != HAL_OK)
+	return HAL_ERROR;
+    state->value = (uint32_t) value[0] << 16 | value[1];
+    state->turn = value[2];
+    state->single_turn = value[3];
+    return HAL_OK;
 }
 
 HAL_StatusTypeDef BRITER_RS485_GetEncoderValue_DMA(Briter_Encoder_t *handler) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    //2 as user want to read 2 different register to obtain encoder value
-    Encoder_Send_Construct(&send_t, ENC_READ, handler->addr, BRITER_RS485_VALUE_ADDR, 2);
-    return Encoder_Transmit_DMA(handler->huart, send_t.buf, sizeof(send_t.buf));
+    //Request frame lives in handler so it stays valid until DMA is done
+    BRITER_STATS_START(&handler->stats, BRITER_Encoder_GetTick());
+    HAL_StatusTypeDef status = Encoder_Transmit_DMA(handler->huart, handler->query_frame, sizeof(handler->query_frame));
+    if (status != HAL_OK)
+	BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_TX_TIMEOUT);
+    return status;
 }
 
 uint32_t BRITER_RS485_GetEncoderValue_DMA_Callback(Briter_Encoder_t *handler, uint8_t *pData) {
     //Check receive buffer
-    if (Encoder_CheckRX(pData, (uint8_t) (handler->addr), ENC_READ) != HAL_OK)
+    Briter_Stats_Class_e result = Encoder_CheckRX(pData, BRITER_RS485_READ_FRAME_SIZE(2), (uint8_t) (handler->addr), ENC_READ);
+    if (result == BRITER_STATS_OK && pData[2] != 4)
+	result = BRITER_STATS_MISMATCH;
+    if (result != BRITER_STATS_OK) {
+	BRITER_STATS_FAIL(&handler->stats, result);
 	return BRITER_RS485_ERROR;
-    uint32_t encoder_value = pData[3] << (3 * 8) | pData[4] << (2 * 8) | pData[5] << (1 * 8)
-	    | pData[6] << (0 * 8);
+    }
+    uint32_t now = BRITER_Encoder_GetTick();
+    BRITER_STATS_DONE(&handler->stats, now);
+    uint32_t encoder_value = handler->model->decode(pData);
+    Encoder_Store(handler, encoder_value, now);
     return encoder_value;
 }
 
 HAL_StatusTypeDef BRITER_RS485_SetBaudrate(Briter_Encoder_t *handler, RS485_Enc_Baudrate_e baudrate) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    Encoder_Send_Construct(&send_t, ENC_WRITE_SINGLE, handler->addr, BRITER_RS485_BAUDRATE_ADDR, baudrate);
-    if (Encoder_Transmit(handler->huart, send_t.buf, sizeof(send_t.buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Receive return from slave
-    uint8_t receive_buf[8];
-    if (Encoder_Receive(handler->huart, receive_buf, sizeof(receive_buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Check receive buffer
-    if (Encoder_CheckRX(receive_buf, (uint8_t) (handler->addr), ENC_WRITE_SINGLE) != HAL_OK)
-	return HAL_ERROR;
-    //Check remaining byte other than CRC, addr, and func
-    if (receive_buf[2] == send_t.buf[2] && receive_buf[3] == send_t.buf[3] && receive_buf[4] == send_t.buf[4]
-	    && receive_buf[5] == send_t.buf[5])
-	return HAL_OK;
-    else
-	return HAL_ERROR;
+    return Encoder_Write_Single(handler, BRITER_RS485_BAUDRATE_ADDR, baudrate);
 }
 
 HAL_StatusTypeDef BRITER_RS485_SetDataMode(Briter_Encoder_t *handler, RS485_Enc_Mode_e mode) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    Encoder_Send_Construct(&send_t, ENC_WRITE_SINGLE, handler->addr, BRITER_RS485_MODE_ADDR, mode);
-    if (Encoder_Transmit(handler->huart, send_t.buf, sizeof(send_t.buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Receive return from slave
-    uint8_t receive_buf[8];
-    if (Encoder_Receive(handler->huart, receive_buf, sizeof(receive_buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Check receive buffer
-    if (Encoder_CheckRX(receive_buf, (uint8_t) (handler->addr), ENC_WRITE_SINGLE) != HAL_OK)
-	return HAL_ERROR;
-    //Check remaining byte other than CRC, addr, and func
-    if (receive_buf[2] == send_t.buf[2] && receive_buf[3] == send_t.buf[3] && receive_buf[4] == send_t.buf[4]
-	    && receive_buf[5] == send_t.buf[5])
-	return HAL_OK;
-    else
-	return HAL_ERROR;
+    return Encoder_Write_Single(handler, BRITER_RS485_MODE_ADDR, mode);
 }
 
 HAL_StatusTypeDef BRITER_RS485_SetAddress(Briter_Encoder_t *handler, uint8_t to_address) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    Encoder_Send_Construct(&send_t, ENC_WRITE_SINGLE, handler->addr, BRITER_RS485_ADDRESS_ADDR, to_address);
-    if (Encoder_Transmit(handler->huart, send_t.buf, sizeof(send_t.buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Receive return from slave
-    uint8_t receive_buf[8];
-    if (Encoder_Receive(handler->huart, receive_buf, sizeof(receive_buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Check receive buffer
-    if (Encoder_CheckRX(receive_buf, (uint8_t) (handler->addr), ENC_WRITE_SINGLE) != HAL_OK)
-	return HAL_ERROR;
-    //Check remaining byte other than CRC, addr, and func
-    if (receive_buf[2] == send_t.buf[2] && receive_buf[3] == send_t.buf[3] && receive_buf[4] == send_t.buf[4]
-	    && receive_buf[5] == send_t.buf[5])
-	return HAL_OK;
-    else
+    if (Encoder_Write_Single(handler, BRITER_RS485_ADDRESS_ADDR, to_address) != HAL_OK)
 	return HAL_ERROR;
+    //Encoder now answer to new address
+    handler->addr = to_address;
+    Encoder_Query_Construct(handler);
+    return HAL_OK;
 }
 
 HAL_StatusTypeDef BRITER_RS485_SetReturnTime(Briter_Encoder_t *handler, uint16_t time) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    Encoder_Send_Construct(&send_t, ENC_WRITE_SINGLE, handler->addr, BRITER_RS485_RETURN_TIME_ADDR, time);
-    if (Encoder_Transmit(handler->huart, send_t.buf, sizeof(send_t.buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Receive return from slave
-    uint8_t receive_buf[8];
-    if (Encoder_Receive(handler->huart, receive_buf, sizeof(receive_buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Check receive buffer
-    if (Encoder_CheckRX(receive_buf, (uint8_t) (handler->addr), ENC_WRITE_SINGLE) != HAL_OK)
-	return HAL_ERROR;
-    //Check remaining byte other than CRC, addr, and func
-    if (receive_buf[2] == send_t.buf[2] && receive_buf[3] == send_t.buf[3] && receive_buf[4] == send_t.buf[4]
-	    && receive_buf[5] == send_t.buf[5])
-	return HAL_OK;
-    else
-	return HAL_ERROR;
+    return Encoder_Write_Single(handler, BRITER_RS485_RETURN_TIME_ADDR, time);
 }
 
 HAL_StatusTypeDef BRITER_RS485_SetDirection(Briter_Encoder_t *handler, RS485_Enc_Direction_e direction) {
-    //Send encoder data
-    Encoder_TX_t send_t;
-    memset(&send_t, 0, sizeof(send_t));
-    Encoder_Send_Construct(&send_t, ENC_WRITE_SINGLE, handler->addr, BRITER_RS485_INCREASING_DIRECTION_ADDR, direction);
-    if (Encoder_Transmit(handler->huart, send_t.buf, sizeof(send_t.buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Receive return from slave
-    uint8_t receive_buf[8];
-    if (Encoder_Receive(handler->huart, receive_buf, sizeof(receive_buf)) != HAL_OK)
-	return HAL_ERROR;
-    //Check receive buffer
-    if (Encoder_CheckRX(receive_buf, (uint8_t) (handler->addr), ENC_WRITE_SINGLE) != HAL_OK)
-	return HAL_ERROR;
-    //Check remaining byte other than CRC, addr, and func
-    if (receive_buf[2] == send_t.buf[2] && receive_buf[3] == send_t.buf[3] && receive_buf[4] == send_t.buf[4]
-	    && receive_buf[5] == send_t.buf[5])
+    return Encoder_Write_Single(handler, BRITER_RS485_INCREASING_DIRECTION_ADDR, direction);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetZero(Briter_Encoder_t *handler) {
+    //Writing 1 mark current position as zero
+    return Encoder_Write_Single(handler, BRITER_RS485_RESET_ZERO_ADDR, 1);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetPosition(Briter_Encoder_t *handler, uint32_t position) {
+    //High word first, same order as read value
+    uint16_t value[2] = { (uint16_t) (position >> 16), (uint16_t) (position & 0xFFFF) };
+    return Encoder_Write_Multi(handler, BRITER_RS485_SET_POSITION_ADDR, value, 2);
+}
+
+void BRITER_RS485_Config_Begin(Briter_RS485_Config_t *config) {
+    config->count = 0;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Config_Add(Briter_RS485_Config_t *config, uint16_t reg, uint16_t value) {
+    //Keep list sorted by register so contiguous run can be found in commit
+    uint8_t i = config->count;
+    while (i > 0 && config->reg[i - 1] > reg)
+	i--;
+    if (i > 0 && config->reg[i - 1] == reg) {
+	config->value[i - 1] = value;
 	return HAL_OK;
-    else
+    }
+    if (config->count >= BRITER_RS485_CONFIG_MAX)
 	return HAL_ERROR;
+    memmove(&config->reg[i + 1], &config->reg[i], (config->count - i) * sizeof(config->reg[0]));
+    memmove(&config->value[i + 1], &config->value[i], (config->count - i) * sizeof(config->value[0]));
+    config->reg[i] = reg;
+    config->value[i] = value;
+    config->count++;
+    return HAL_OK;
 }
 
-/**
- * @brief  Calculate_CRC.
- * @param  pbuf pointer to buffer
- * @param  pbuf size of buffer that you wish to included in CRC calculation
- * @retval CRC value
- */
-static uint16_t Calculate_CRC(uint8_t pbuf[], uint16_t num) {
-    uint8_t i, j;
-    uint16_t wcrc = 0xffff;
-    for (i = 0; i < num; i++) {
-	wcrc ^= (uint16_t) (pbuf[i]);
-	for (j = 0; j < 8; j++) {
-	    if (wcrc & 0x0001) {
-		wcrc >>= 1;
-		wcrc ^= 0xa001;
-	    }
+HAL_StatusTypeDef BRITER_RS485_Config_Commit(Briter_Encoder_t *handler, const Briter_RS485_Config_t *config) {
+    int32_t address = -1;
+    int32_t baudrate = -1;
+    uint8_t i = 0;
+    //Send only register encoder do not hold yet, order is kept
+    Briter_RS485_Config_t delta;
+    delta.count = 0;
+    for (uint8_t j = 0; j < config->count; j++) {
+	if (BRITER_RS485_SHADOWED(config->reg[j]) && BRITER_Shadow_Match(&handler->shadow, (uint8_t) config->reg[j], config->value[j]))
+	    continue;
+	delta.reg[delta.count] = config->reg[j];
+	delta.value[delta.count] = config->value[j];
+	delta.count++;
+    }
+    config = &delta;
+    while (i < config->count) {
+	uint16_t reg = config->reg[i];
+	//Encoder answer at old setting, so address and baudrate go last
+	if (reg == BRITER_RS485_ADDRESS_ADDR || reg == BRITER_RS485_BAUDRATE_ADDR) {
+	    if (reg == BRITER_RS485_ADDRESS_ADDR)
+		address = config->value[i];
 	    else
-		wcrc >>= 1;
+		baudrate = config->value[i];
+	    i++;
+	    continue;
 	}
+	uint8_t run = 1;
+	while (i + run < config->count && config->reg[i + run] == reg + run && config->reg[i + run] != BRITER_RS485_ADDRESS_ADDR
+		&& config->reg[i + run] != BRITER_RS485_BAUDRATE_ADDR)
+	    run++;
+	HAL_StatusTypeDef status;
+	if (run == 1 && reg != BRITER_RS485_SET_POSITION_ADDR && reg != BRITER_RS485_SET_POSITION_ADDR + 1)
+	    status = Encoder_Write_Single(handler, reg, config->value[i]);
+	else
+	    status = Encoder_Write_Multi(handler, reg, &config->value[i], run);
+	if (status != HAL_OK)
+	    return status;
+	i += run;
     }
-    return wcrc;
+    if (address >= 0 && BRITER_RS485_SetAddress(handler, (uint8_t) address) != HAL_OK)
+	return HAL_ERROR;
+    if (baudrate >= 0 && Encoder_Write_Single(handler, BRITER_RS485_BAUDRATE_ADDR, (uint16_t) baudrate) != HAL_OK)
+	return HAL_ERROR;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Shadow_Get(const Briter_Encoder_t *handler, uint16_t reg, uint16_t *value) {
+    if (!BRITER_RS485_SHADOWED(reg))
+	return HAL_ERROR;
+    return BRITER_Shadow_Get(&handler->shadow, (uint8_t) reg, value);
+}
+
+void BRITER_RS485_Shadow_Invalidate(Briter_Encoder_t *handler) {
+    BRITER_Shadow_Invalidate(&handler->shadow);
+    BRITER_Shadow_Update(&handler->shadow, BRITER_RS485_ADDRESS_ADDR, handler->addr, HAL_OK);
+}
+
+HAL_StatusTypeDef BRITER_RS485_Shadow_Flush(Briter_Encoder_t *handler) {
+    Briter_RS485_Config_t config;
+    BRITER_RS485_Config_Begin(&config);
+    for (uint8_t reg = 0; reg < BRITER_SHADOW_KEY_COUNT; reg++) {
+	if (BRITER_RS485_SHADOWED(reg) && (handler->shadow.dirty & (1U << reg)))
+	    BRITER_RS485_Config_Add(&config, reg, handler->shadow.value[reg]);
+    }
+    return BRITER_RS485_Config_Commit(handler, &config);
 }
 
 /**
@@ -244,6 +290,7 @@ static uint16_t Calculate_CRC(uint8_t pbuf[], uint16_t num) {
  * @retval none
  */
 static void Encoder_Send_Construct(Encoder_TX_t *txbuf, RS485_Enc_Func_e func, uint16_t own_addr, uint16_t send_addr, uint16_t send_value) {
+    BRITER_PROFILE_BEGIN();
     txbuf->send_info.address = (uint8_t) own_addr;
     txbuf->send_info.function = func;
     txbuf->send_info.start_register[0] = (uint8_t) ((send_addr >> 8) & 0xFF);
@@ -251,49 +298,438 @@ static void Encoder_Send_Construct(Encoder_TX_t *txbuf, RS485_Enc_Func_e func, u
     uint16_t register_number = send_value;
     txbuf->send_info.register_number[0] = (uint8_t) ((register_number >> 8) & 0xFF);
     txbuf->send_info.register_number[1] = (uint8_t) ((register_number >> 0) & 0xFF);
-    uint16_t crc = Calculate_CRC(txbuf->buf, sizeof(txbuf->buf) - 2);
+    uint16_t crc = BRITER_CRC16_Calculate(txbuf->buf, sizeof(txbuf->buf) - 2);
     txbuf->send_info.crc[0] = (uint8_t) ((crc >> 0) & 0xFF);
     txbuf->send_info.crc[1] = (uint8_t) ((crc >> 8) & 0xFF);
+    BRITER_PROFILE_END(BRITER_PROFILE_RS485_BUILD);
+}
+
+HAL_StatusTypeDef BRITER_RS485_GetEncoderValue_Async(Briter_Encoder_t *handler, Briter_RS485_Async_Callback callback, void *context) {
+    //2 as user want to read 2 different register to obtain encoder value
+    return Encoder_Async_Start(handler, ENC_READ, BRITER_RS485_VALUE_ADDR, 2, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetBaudrate_Async(Briter_Encoder_t *handler, RS485_Enc_Baudrate_e baudrate, Briter_RS485_Async_Callback callback, void *context) {
+    return Encoder_Async_Start(handler, ENC_WRITE_SINGLE, BRITER_RS485_BAUDRATE_ADDR, baudrate, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetAddress_Async(Briter_Encoder_t *handler, uint8_t to_address, Briter_RS485_Async_Callback callback, void *context) {
+    return Encoder_Async_Start(handler, ENC_WRITE_SINGLE, BRITER_RS485_ADDRESS_ADDR, to_address, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetDataMode_Async(Briter_Encoder_t *handler, RS485_Enc_Mode_e mode, Briter_RS485_Async_Callback callback, void *context) {
+    return Encoder_Async_Start(handler, ENC_WRITE_SINGLE, BRITER_RS485_MODE_ADDR, mode, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetReturnTime_Async(Briter_Encoder_t *handler, uint16_t time, Briter_RS485_Async_Callback callback, void *context) {
+    return Encoder_Async_Start(handler, ENC_WRITE_SINGLE, BRITER_RS485_RETURN_TIME_ADDR, time, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetDirection_Async(Briter_Encoder_t *handler, RS485_Enc_Direction_e direction, Briter_RS485_Async_Callback callback, void *context) {
+    return Encoder_Async_Start(handler, ENC_WRITE_SINGLE, BRITER_RS485_INCREASING_DIRECTION_ADDR, direction, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_SetZero_Async(Briter_Encoder_t *handler, Briter_RS485_Async_Callback callback, void *context) {
+    return Encoder_Async_Start(handler, ENC_WRITE_SINGLE, BRITER_RS485_RESET_ZERO_ADDR, 1, callback, context);
+}
+
+HAL_StatusTypeDef BRITER_RS485_Async_Wait(Briter_Encoder_t *handler, uint32_t timeout) {
+    Briter_RS485_Async_t *async = &handler->async;
+    uint32_t start = BRITER_Encoder_GetTick();
+    uint32_t limit = BRITER_TICK_FROM_MS(timeout);
+    while (async->state != BRITER_RS485_ASYNC_IDLE) {
+	uint32_t now = BRITER_Encoder_GetTick();
+	uint32_t elapsed = BRITER_TICK_ELAPSED(now, start);
+	if (elapsed >= limit)
+	    return HAL_TIMEOUT;
+	uint32_t wait = limit - elapsed;
+	//Wake on operation deadline too, nothing else would time it out
+	uint32_t run = BRITER_TICK_ELAPSED(now, async->start);
+	uint32_t left = (run < async->timeout) ? async->timeout - run : 0;
+	if (left < wait)
+	    wait = left;
+	//Sleep in RTOS, return at once in bare metal
+	if (wait)
+	    BRITER_OS_Wait(BRITER_TICK_TO_MS(wait));
+	BRITER_RS485_Async_Process(handler);
+    }
+    return async->status;
+}
+
+void BRITER_RS485_Async_Process(Briter_Encoder_t *handler) {
+    Briter_RS485_Async_t *async = &handler->async;
+    //Completion may come from interrupt, keep check and abort atomic
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (async->state != BRITER_RS485_ASYNC_IDLE && BRITER_TICK_ELAPSED(BRITER_Encoder_GetTick(), async->start) >= async->timeout) {
+	HAL_UART_Abort(handler->huart);
+	if (async->tx_frame[1] == ENC_READ)
+	    BRITER_STATS_FAIL(&handler->stats, async->state == BRITER_RS485_ASYNC_TX ? BRITER_STATS_TX_TIMEOUT : BRITER_STATS_RX_TIMEOUT);
+	Encoder_Async_Done(handler, HAL_TIMEOUT, 0);
+    }
+    __set_PRIMASK(primask);
+}
+
+void BRITER_RS485_Async_TxCpltCallback(Briter_Encoder_t *handler, UART_HandleTypeDef *huart) {
+    if (huart != handler->huart || handler->async.state != BRITER_RS485_ASYNC_TX)
+	return;
+    //Reception is already armed
+    handler->async.state = BRITER_RS485_ASYNC_RX;
+}
+
+void BRITER_RS485_Async_RxEventCallback(Briter_Encoder_t *handler, UART_HandleTypeDef *huart, uint16_t Size) {
+    Briter_RS485_Async_t *async = &handler->async;
+    if (huart != handler->huart || async->state == BRITER_RS485_ASYNC_IDLE)
+	return;
+    uint8_t *pData = async->rx_buf;
+    RS485_Enc_Func_e func = (RS485_Enc_Func_e) async->tx_frame[1];
+    Briter_Stats_Class_e result = Encoder_CheckRX(pData, Size, (uint8_t) (handler->addr), func);
+    if (func == ENC_READ) {
+	if (result == BRITER_STATS_OK && pData[2] != 4)
+	    result = BRITER_STATS_MISMATCH;
+	if (result != BRITER_STATS_OK) {
+	    BRITER_STATS_FAIL(&handler->stats, result);
+	    Encoder_Async_Done(handler, HAL_ERROR, 0);
+	    return;
+	}
+	uint32_t now = BRITER_Encoder_GetTick();
+	BRITER_STATS_DONE(&handler->stats, now);
+	uint32_t encoder_value = handler->model->decode(pData);
+	Encoder_Store(handler, encoder_value, now);
+	Encoder_Async_Done(handler, HAL_OK, encoder_value);
+	return;
+    }
+    //Check remaining byte other than CRC, addr, and func
+    if (result != BRITER_STATS_OK || memcmp(&pData[2], &async->tx_frame[2], 4) != 0) {
+	Encoder_Async_Done(handler, HAL_ERROR, 0);
+	return;
+    }
+    if (async->tx_frame[3] == BRITER_RS485_ADDRESS_ADDR) {
+	//Encoder now answer to new address
+	handler->addr = async->tx_frame[5];
+	Encoder_Query_Construct(handler);
+    }
+    Encoder_Async_Done(handler, HAL_OK, 0);
+}
+
+void BRITER_RS485_Async_ErrorCallback(Briter_Encoder_t *handler, UART_HandleTypeDef *huart) {
+    if (huart != handler->huart || handler->async.state == BRITER_RS485_ASYNC_IDLE)
+	return;
+    HAL_UART_Abort(huart);
+    if (handler->async.tx_frame[1] == ENC_READ)
+	BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_BUS_ERROR);
+    Encoder_Async_Done(handler, HAL_ERROR, 0);
+}
+
+#ifdef BRITER_ENCODER_STATS
+void BRITER_RS485_GetStats(const Briter_Encoder_t *handler, Briter_Stats_t *stats) {
+    BRITER_Stats_Snapshot(&handler->stats, stats);
+}
+
+void BRITER_RS485_ResetStats(Briter_Encoder_t *handler) {
+    BRITER_Stats_Reset(&handler->stats);
+}
+#endif
+
+uint32_t BRITER_RS485_BaudrateValue(RS485_Enc_Baudrate_e baudrate) {
+    static const uint32_t bps[] = { 9600, 19200, 38400, 57600, 115200 };
+    return (baudrate <= RS485_ENC_BAUDRATE_115200) ? bps[baudrate] : 0;
+}
+
+uint32_t BRITER_RS485_FrameTime_us(uint32_t bps, uint16_t size) {
+    //8N1, 10 bit per byte
+    if (bps == 0)
+	return 0;
+    return (size * 10UL * 1000000UL + bps - 1) / bps;
+}
+
+uint32_t BRITER_RS485_T35_us(uint32_t bps) {
+    //Modbus fix t3.5 to 1.75 ms above 19200 bps
+    if (bps == 0 || bps > 19200)
+	return 1750;
+    return (35UL * 1000000UL + bps - 1) / bps;
+}
+
+/**
+ * @brief  Build read value request of handler into its query frame.
+ * @param  handler pointer to encoder handler
+ * @retval none
+ */
+static void Encoder_Query_Construct(Briter_Encoder_t *handler) {
+    Encoder_TX_t send_t;
+    //2 as user want to read 2 different register to obtain encoder value
+    Encoder_Send_Construct(&send_t, ENC_READ, handler->addr, BRITER_RS485_VALUE_ADDR, 2);
+    memcpy(handler->query_frame, send_t.buf, sizeof(handler->query_frame));
+}
+
+/**
+ * @brief  Keep valid value as latest sample of handler.
+ * @param  handler pointer to encoder handler
+ * @param  value encoder value
+ * @param  timestamp tick when value was received
+ * @retval none
+ */
+static void Encoder_Store(Briter_Encoder_t *handler, uint32_t value, uint32_t timestamp) {
+    handler->encoder_value = value;
+    handler->timestamp = timestamp;
+    handler->sequence++;
+}
+
+/**
+ * @brief  Write single register through polling mode and check encoder echo.
+ * @param  handler pointer to encoder handler
+ * @param  reg register address
+ * @param  value register value
+ * @retval HAL status
+ */
+static HAL_StatusTypeDef Encoder_Write_Single(Briter_Encoder_t *handler, uint16_t reg, uint16_t value) {
+    uint8_t shadowed = BRITER_RS485_SHADOWED(reg);
+    //Encoder already hold value, keep bus free
+    if (shadowed && BRITER_Shadow_Match(&handler->shadow, (uint8_t) reg, value))
+	return HAL_OK;
+    //Send encoder data
+    Encoder_TX_t send_t;
+    Encoder_Send_Construct(&send_t, ENC_WRITE_SINGLE, handler->addr, reg, value);
+    HAL_StatusTypeDef status = HAL_ERROR;
+    uint8_t receive_buf[8];
+    //Receive return from slave, check remaining byte other than CRC, addr, and func
+    if (Encoder_Transmit(handler, send_t.buf, sizeof(send_t.buf)) == HAL_OK && Encoder_Receive(handler, receive_buf, sizeof(receive_buf)) == HAL_OK
+	    && Encoder_CheckRX(receive_buf, sizeof(receive_buf), (uint8_t) (handler->addr), ENC_WRITE_SINGLE) == BRITER_STATS_OK
+	    && memcmp(&receive_buf[2], &send_t.buf[2], 4) == 0)
+	status = HAL_OK;
+    if (shadowed)
+	BRITER_Shadow_Update(&handler->shadow, (uint8_t) reg, value, status);
+    return status;
+}
+
+/**
+ * @brief  Write contiguous registers through polling mode and check encoder echo.
+ * @param  handler pointer to encoder handler
+ * @param  reg first register address
+ * @param  value register value
+ * @param  count number of register, up to BRITER_RS485_CONFIG_MAX
+ * @retval HAL status
+ */
+static HAL_StatusTypeDef Encoder_Write_Multi(Briter_Encoder_t *handler, uint16_t reg, const uint16_t *value, uint8_t count) {
+    //Addr+func+start(2)+quantity(2)+byte count+[value]+crc(2)
+    uint8_t send_buf[9 + 2 * BRITER_RS485_CONFIG_MAX];
+    if (count == 0 || count > BRITER_RS485_CONFIG_MAX)
+	return HAL_ERROR;
+    send_buf[0] = handler->addr;
+    send_buf[1] = ENC_WRITE_MULTI;
+    send_buf[2] = (uint8_t) ((reg >> 8) & 0xFF);
+    send_buf[3] = (uint8_t) ((reg >> 0) & 0xFF);
+    send_buf[4] = 0;
+    send_buf[5] = count;
+    send_buf[6] = (uint8_t) (2 * count);
+    for (uint8_t i = 0; i < count; i++) {
+	send_buf[7 + 2 * i] = (uint8_t) ((value[i] >> 8) & 0xFF);
+	send_buf[8 + 2 * i] = (uint8_t) ((value[i] >> 0) & 0xFF);
+    }
+    uint16_t size = 7 + 2 * count;
+    uint16_t crc = BRITER_CRC16_Calculate(send_buf, size);
+    send_buf[size++] = (uint8_t) ((crc >> 0) & 0xFF);
+    send_buf[size++] = (uint8_t) ((crc >> 8) & 0xFF);
+    HAL_StatusTypeDef status = HAL_ERROR;
+    uint8_t receive_buf[8];
+    //Receive return from slave, echo start and quantity
+    if (Encoder_Transmit(handler, send_buf, size) == HAL_OK && Encoder_Receive(handler, receive_buf, sizeof(receive_buf)) == HAL_OK
+	    && Encoder_CheckRX(receive_buf, sizeof(receive_buf), (uint8_t) (handler->addr), ENC_WRITE_MULTI) == BRITER_STATS_OK
+	    && memcmp(&receive_buf[2], &send_buf[2], 4) == 0)
+	status = HAL_OK;
+    for (uint8_t i = 0; i < count; i++) {
+	if (BRITER_RS485_SHADOWED(reg + i))
+	    BRITER_Shadow_Update(&handler->shadow, (uint8_t) (reg + i), value[i], status);
+    }
+    return status;
+}
+
+/**
+ * @brief  Send read request and check response through polling mode.
+ * @param  handler pointer to encoder handler
+ * @param  request read request frame, BRITER_RS485_QUERY_FRAME_SIZE byte
+ * @param  count number of register requested
+ * @param  pData receive buffer, BRITER_RS485_READ_FRAME_SIZE(count) byte
+ * @retval transaction result, also recorded in handler stats
+ * @note   Response of BRITER_RS485_VALUE_ADDR is kept as latest value
+ */
+static Briter_Stats_Class_e Encoder_Read(Briter_Encoder_t *handler, const uint8_t *request, uint8_t count, uint8_t *pData) {
+    BRITER_STATS_START(&handler->stats, BRITER_Encoder_GetTick());
+    if (Encoder_Transmit(handler, (uint8_t*) request, BRITER_RS485_QUERY_FRAME_SIZE) != HAL_OK) {
+	BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_TX_TIMEOUT);
+	return BRITER_STATS_TX_TIMEOUT;
+    }
+
+    //Receive return from slave, size known from register count
+    uint16_t size = BRITER_RS485_READ_FRAME_SIZE(count);
+    HAL_StatusTypeDef status = Encoder_Receive(handler, pData, size);
+    if (status != HAL_OK) {
+	Briter_Stats_Class_e result = (status == HAL_TIMEOUT) ? BRITER_STATS_RX_TIMEOUT : BRITER_STATS_BUS_ERROR;
+	BRITER_STATS_FAIL(&handler->stats, result);
+	return result;
+    }
+
+    //Check receive buffer, byte count must match request
+    Briter_Stats_Class_e result = Encoder_CheckRX(pData, size, (uint8_t) (handler->addr), ENC_READ);
+    if (result == BRITER_STATS_OK && pData[2] != 2 * count)
+	result = BRITER_STATS_MISMATCH;
+    if (result != BRITER_STATS_OK) {
+	BRITER_STATS_FAIL(&handler->stats, result);
+	return result;
+    }
+    uint32_t now = BRITER_Encoder_GetTick();
+    BRITER_STATS_DONE(&handler->stats, now);
+
+    //Value register come first in block, keep it as latest sample
+    if (request[2] == 0 && request[3] == BRITER_RS485_VALUE_ADDR && count >= 2) {
+	uint32_t encoder_value = handler->model->decode(pData);
+	Encoder_Store(handler, encoder_value, now);
+    }
+    return BRITER_STATS_OK;
 }
 
 /**
  * @brief  Check return buffer address, data func and crc by encoder.
  * @param  pData pointer to buffer
+ * @param  size number of byte available in buffer
  * @param  address address of slave
  * @param  func encoder function code
- * @retval HAL status
+ * @retval BRITER_STATS_OK, BRITER_STATS_MISMATCH or BRITER_STATS_CRC
  */
-static HAL_StatusTypeDef Encoder_CheckRX(uint8_t *pData, uint8_t address, RS485_Enc_Func_e func) {
+static Briter_Stats_Class_e Encoder_CheckRX(uint8_t *pData, uint16_t size, uint8_t address, RS485_Enc_Func_e func) {
+    BRITER_PROFILE_BEGIN();
+    Briter_Stats_Class_e status = BRITER_STATS_OK;
     //Check return array contain right address and function code
-    if (pData[0] != address || pData[1] != func)
-	return HAL_ERROR;
-
-    //Check CRC
-    uint8_t total_byte;
-    if (pData[1] == ENC_READ) {
-	//3 byte of READ return is size of byte follow
-	//after total byte indicator and before CRC byte
-	total_byte = pData[2] + 3; //Addr+func+total_byte+[total_byte]
+    if (pData[0] != address || pData[1] != func) {
+	status = BRITER_STATS_MISMATCH;
     }
     else {
-	total_byte = 8 - 2; //8 is total number of byte, 2 is byte for CRC
+	//Check CRC
+	uint16_t total_byte;
+	if (pData[1] == ENC_READ) {
+	    //3 byte of READ return is size of byte follow
+	    //after total byte indicator and before CRC byte
+	    total_byte = pData[2] + 3; //Addr+func+total_byte+[total_byte]
+	}
+	else {
+	    total_byte = 8 - 2; //8 is total number of byte, 2 is byte for CRC
+	}
+	//Byte count come from slave, never read past buffer
+	if (total_byte + 2 > size) {
+	    status = BRITER_STATS_MISMATCH;
+	}
+	else {
+	    uint16_t crc = BRITER_CRC16_Calculate(pData, total_byte);
+	    if (pData[total_byte] != (uint8_t) ((crc >> 0) & 0xFF) || pData[total_byte + 1] != (uint8_t) ((crc >> 8) & 0xFF))
+		status = BRITER_STATS_CRC;
+	}
     }
-    uint16_t crc = Calculate_CRC(pData, total_byte);
-    if (pData[total_byte] != (uint8_t) ((crc >> 0) & 0xFF) || pData[total_byte + 1] != (uint8_t) ((crc >> 8) & 0xFF))
-	return HAL_ERROR;
+    BRITER_PROFILE_END(BRITER_PROFILE_RS485_CHECK);
+    return status;
+}
+
+/**
+ * @brief  Start non-blocking single request, reception is armed before request.
+ * @param  handler pointer to encoder handler
+ * @param  func ENC_READ or ENC_WRITE_SINGLE
+ * @param  reg register address
+ * @param  value number of register to read, or value to write
+ * @param  callback called on completion, can be NULL
+ * @param  context passed to callback
+ * @retval HAL status, HAL_BUSY if handler has operation in progress
+ */
+static HAL_StatusTypeDef Encoder_Async_Start(Briter_Encoder_t *handler, RS485_Enc_Func_e func, uint16_t reg, uint16_t value, Briter_RS485_Async_Callback callback, void *context) {
+    Briter_RS485_Async_t *async = &handler->async;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (async->state != BRITER_RS485_ASYNC_IDLE) {
+	__set_PRIMASK(primask);
+	return HAL_BUSY;
+    }
+    //Encoder already hold value, complete at once without bus
+    if (func == ENC_WRITE_SINGLE && BRITER_RS485_SHADOWED(reg) && BRITER_Shadow_Match(&handler->shadow, (uint8_t) reg, value)) {
+	//Same completion as bus operation, waiter must not see result of older one
+	async->status = HAL_OK;
+	__set_PRIMASK(primask);
+	if (callback)
+	    callback(context, HAL_OK, 0);
+	return HAL_OK;
+    }
+    async->state = BRITER_RS485_ASYNC_TX;
+    __set_PRIMASK(primask);
+
+    Encoder_TX_t send_t;
+    Encoder_Send_Construct(&send_t, func, handler->addr, reg, value);
+    memcpy(async->tx_frame, send_t.buf, sizeof(async->tx_frame));
+    async->callback = callback;
+    async->context = context;
+    async->waiter = BRITER_OS_Self();
+    async->status = HAL_BUSY;
+    async->start = BRITER_Encoder_GetTick();
+    async->timeout = BRITER_TICK_FROM_MS(handler->tx_timeout + handler->rx_timeout);
+    if (func == ENC_READ)
+	BRITER_STATS_START(&handler->stats, async->start);
 
+    if (HAL_UARTEx_ReceiveToIdle_DMA(handler->huart, async->rx_buf, sizeof(async->rx_buf)) != HAL_OK) {
+	async->state = BRITER_RS485_ASYNC_IDLE;
+	if (func == ENC_READ)
+	    BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_BUS_ERROR);
+	return HAL_ERROR;
+    }
+    __HAL_DMA_DISABLE_IT(handler->huart->hdmarx, DMA_IT_HT);
+    if (HAL_UART_Transmit_DMA(handler->huart, async->tx_frame, sizeof(async->tx_frame)) != HAL_OK) {
+	HAL_UART_AbortReceive(handler->huart);
+	async->state = BRITER_RS485_ASYNC_IDLE;
+	if (func == ENC_READ)
+	    BRITER_STATS_FAIL(&handler->stats, BRITER_STATS_TX_TIMEOUT);
+	return HAL_ERROR;
+    }
     return HAL_OK;
 }
 
+/**
+ * @brief  Finish non-blocking operation, call callback and wake waiter.
+ * @param  handler pointer to encoder handler
+ * @param  status result of operation
+ * @param  value encoder value of read, 0 otherwise
+ * @retval none
+ */
+static void Encoder_Async_Done(Briter_Encoder_t *handler, HAL_StatusTypeDef status, uint32_t value) {
+    Briter_RS485_Async_t *async = &handler->async;
+    if (async->tx_frame[1] == ENC_WRITE_SINGLE) {
+	uint16_t reg = (uint16_t) (async->tx_frame[2] << 8 | async->tx_frame[3]);
+	if (BRITER_RS485_SHADOWED(reg))
+	    BRITER_Shadow_Update(&handler->shadow, (uint8_t) reg, (uint16_t) (async->tx_frame[4] << 8 | async->tx_frame[5]), status);
+    }
+    async->status = status;
+    async->state = BRITER_RS485_ASYNC_IDLE;
+    if (async->callback)
+	async->callback(async->context, status, value);
+    if (async->waiter)
+	BRITER_OS_Notify(async->waiter);
+}
+
+/**
+ * @brief  Convert wire time to HAL timeout.
+ * @param  us time in us
+ * @retval timeout in HAL tick (ms)
+ * @note   One extra tick as the first tick may end right after start
+ */
+static uint32_t Encoder_Timeout(uint32_t us) {
+    return (us + 999) / 1000 + 1;
+}
+
 /**
  * @brief  Transmit encoder data via UART through polling mode.
- * @param  huart pointer to uart handler
+ * @param  handler pointer to encoder handler
  * @param  pData pointer to send buffer
  * @param  Size size of buffer
  * @retval HAL status
  */
-static HAL_StatusTypeDef Encoder_Transmit(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
-    return HAL_UART_Transmit(huart, pData, Size, 10);
+static HAL_StatusTypeDef Encoder_Transmit(Briter_Encoder_t *handler, uint8_t *pData, uint16_t Size) {
+    //Request frame timeout is precomputed, only longer write frame work it out
+    uint32_t timeout = (Size <= BRITER_RS485_QUERY_FRAME_SIZE) ? handler->tx_timeout : Encoder_Timeout(Size * handler->byte_us);
+    return HAL_UART_Transmit(handler->huart, pData, Size, timeout);
 }
 
 /**
@@ -309,12 +745,14 @@ static HAL_StatusTypeDef Encoder_Transmit_DMA(UART_HandleTypeDef *huart, uint8_t
 
 /**
  * @brief  Receive encoder data via UART through polling mode.
- * @param  huart pointer to uart handler
+ * @param  handler pointer to encoder handler
  * @param  pData pointer to send buffer
  * @param  Size size of buffer
  * @retval HAL status
  */
-static HAL_StatusTypeDef Encoder_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
-    return HAL_UART_Receive(huart, pData, Size, 10);
+static HAL_StatusTypeDef Encoder_Receive(Briter_Encoder_t *handler, uint8_t *pData, uint16_t Size) {
+    //Value and write echo timeout is precomputed, only block read work it out
+    uint32_t timeout = (Size <= BRITER_RS485_READ_FRAME_SIZE(2)) ? handler->rx_timeout : Encoder_Timeout(handler->rx_gap_us + Size * handler->byte_us);
+    return HAL_UART_Receive(handler->huart, pData, Size, timeout);
 }
 
@@ -15,13 +15,34 @@
   1. Create handler to hold Briter_Encoder_t and input the correct address and
       UART handler for the specific driver
   2. Make sure baudrate is match,  data length 8 bit, 0 parity, 1 stop bit
+      - Polling timeout is worked out from huart->Init.BaudRate, frame length,
+	Modbus t3.5 and BRITER_RS485_TURNAROUND_US in BRITER_RS485_Init()
+      - Call BRITER_RS485_SetTiming() again after UART baudrate is changed
   3. Default encoder address is 1 and baudrate is 9600bps if no configure
-  4. All configuration function is performed through polling mode
+  4. All configuration function is performed through polling mode, except setter with _Async suffix (see 6.)
+      - Several setting can be written in one go, registers next to each
+	other are sent in one WRITE_MULTI frame
+	  BRITER_RS485_Config_Begin(&config);
+	  BRITER_RS485_Config_Add(&config, BRITER_RS485_MODE_ADDR, RS485_ENC_MODE_QUERY);
+	  BRITER_RS485_Config_Add(&config, BRITER_RS485_RETURN_TIME_ADDR, 50);
+	  BRITER_RS485_Config_Commit(&handler, &config);
+      - Address and baudrate in a transaction are written last, one frame each
+      - Address, baudrate, mode, return time and direction last written are
+	kept in handler shadow, writing the value encoder already hold is
+	skipped and commit send only the changed register
+      - Call BRITER_RS485_Shadow_Invalidate() if encoder may have power-cycled,
+	BRITER_RS485_Shadow_Flush() then write back what was set before,
+	refer to briter_encoder_shadow.h
   5. For reading encoder value,
       - In this driver, user is not interested in getting single turn encoder value
       - Encoder value is depends on the hardware itself
       - Polling Mode
 	  BRITER_RS485_GetEncoderValue()
+	  BRITER_RS485_GetState() for value, turn and single turn in one request
+	  BRITER_RS485_ReadBlock() for any contiguous register range
+      - Request frame is built once in BRITER_RS485_Init()/BRITER_RS485_SetAddress()
+	and stored in the handler, handler must stay alive and be placed in
+	DMA accessible memory (not CCM RAM) when DMA mode is used
       - DMA Mode
 	  a. Call BRITER_RS485_GetEncoderValue_DMA() in main
 	  b. Add HAL_UART_DMA_TxCplt_Callback() to code
@@ -29,20 +50,124 @@
 		HAL_UARTEx_ReceiveToIdle_DMA(&huart2, (uint8_t *) RxBuf, RxBuf_SIZE);
 		__HAL_DMA_DISABLE_IT(&hdma_usart2_rx, DMA_IT_HT);
 	  d. Add HAL_UARTEx_RxEventCallback()
-	      Call BRITER_RS485_GetEncoderValue_RX_Callback()
+	      Call BRITER_RS485_GetEncoderValue_DMA_Callback()
+      - Several encoders on one line
+	  Use briter_encoder_rs485_bus.h scheduler instead of calling read function
+      - Continuous circular DMA reception
+	  Feed received byte to briter_encoder_rs485_parser.h, response does not
+	  need to start at beginning of buffer
+      - Backhaul mode
+	  Encoder push value by itself, use briter_encoder_rs485_backhaul.h to
+	  collect timestamped sample into a ring
+  6. Non-blocking read and setter, driven by UART DMA interrupt
+      - Start with BRITER_RS485_GetEncoderValue_Async() or a setter with
+	_Async suffix, one operation per handler at a time
+      - Route HAL_UART_TxCpltCallback(), HAL_UARTEx_RxEventCallback() and
+	HAL_UART_ErrorCallback() to BRITER_RS485_Async_xxxCallback()
+      - Completion call the callback from interrupt, or block the starting
+	task with BRITER_RS485_Async_Wait(), task is woken through
+	briter_encoder_os.h shim
+      - Bare metal without Wait(), call BRITER_RS485_Async_Process()
+	periodically to time out lost response
+      - Setter value already held in shadow complete at once, callback is
+	called before start function return and BRITER_RS485_Async_Wait()
+	return without sleeping
+      - Do not share UART with bus scheduler or backhaul while in use
+  7. Every valid read update encoder_value, timestamp and sequence of handler,
+      briter_encoder.h give the same interface over RS485 and CAN
+  8. Define BRITER_ENCODER_STATS to count failure class and latency of every
+      read, refer to briter_encoder_stats.h
 */
 #ifndef BRITER_ENCODER_RS485_H_
 #define BRITER_ENCODER_RS485_H_
 
 #include <stdint.h>
-#include <stm32f4xx.h>
+#include "briter_encoder_port.h"
+#include "briter_encoder_stats.h"
+#include "briter_encoder_shadow.h"
+#include "briter_encoder_model.h"
+
+/** Size of the read value request frame*/
+#define BRITER_RS485_QUERY_FRAME_SIZE	8
+
+/** Slave processing time budget between request end and response start*/
+#ifndef BRITER_RS485_TURNAROUND_US
+#define BRITER_RS485_TURNAROUND_US	2000
+#endif
+
+/** Register per read block transaction*/
+#ifndef BRITER_RS485_READ_MAX
+#define BRITER_RS485_READ_MAX		16
+#endif
+
+/** Size of read response of count register, addr+func+byte count+[2*count]+crc*/
+#define BRITER_RS485_READ_FRAME_SIZE(count)	(5 + 2 * (count))
+
+/** Register write per configuration transaction*/
+#ifndef BRITER_RS485_CONFIG_MAX
+#define BRITER_RS485_CONFIG_MAX		16
+#endif
+
+/** Asynchronous receive buffer, larger than read value response and write echo*/
+#define BRITER_RS485_ASYNC_RX_SIZE	16
+
+/** Completion callback of asynchronous operation, value is encoder value of read, 0 otherwise*/
+typedef void (*Briter_RS485_Async_Callback)(void *context, HAL_StatusTypeDef status, uint32_t value);
+
+/** Asynchronous operation state*/
+typedef enum {
+    BRITER_RS485_ASYNC_IDLE = 0x00,
+    BRITER_RS485_ASYNC_TX, /*!< Request being sent by DMA, reception armed*/
+    BRITER_RS485_ASYNC_RX, /*!< Waiting for line idle after response*/
+} Briter_RS485_Async_State_e;
+
+/** Asynchronous operation of one handler*/
+typedef struct {
+    volatile Briter_RS485_Async_State_e state;
+    volatile HAL_StatusTypeDef status; /*!< Result of last operation, HAL_BUSY while in progress*/
+    uint8_t tx_frame[BRITER_RS485_QUERY_FRAME_SIZE]; /*!< Request, DMA source*/
+    uint8_t rx_buf[BRITER_RS485_ASYNC_RX_SIZE]; /*!< DMA receive buffer*/
+    uint32_t start; /*!< BRITER_Encoder_GetTick() when operation started*/
+    uint32_t timeout; /*!< Tick allowed for operation*/
+    Briter_RS485_Async_Callback callback;
+    void *context;
+    void *waiter; /*!< From BRITER_OS_Self(), notified on completion*/
+} Briter_RS485_Async_t;
 
 typedef struct {
     uint8_t addr;
-    uint32_t encoder_value;
+    uint32_t encoder_value; /*!< Last valid value*/
+    uint32_t timestamp; /*!< BRITER_Encoder_GetTick() when encoder_value was received*/
+    uint32_t sequence; /*!< Number of valid value received*/
     UART_HandleTypeDef *huart;
+    uint8_t query_frame[BRITER_RS485_QUERY_FRAME_SIZE]; /*!< Prebuilt read value request, also used as DMA source*/
+    uint32_t bps; /*!< Line rate, from huart->Init.BaudRate*/
+    uint32_t byte_us; /*!< Time of one byte on the line*/
+    uint32_t rx_gap_us; /*!< t3.5 and turnaround before response start*/
+    uint32_t tx_timeout; /*!< Polling timeout of request frame, ms*/
+    uint32_t rx_timeout; /*!< Polling timeout of value response and write echo, ms*/
+    Briter_RS485_Async_t async; /*!< Non-blocking operation in progress*/
+    Briter_Shadow_t shadow; /*!< Configuration register last written, index by register*/
+    const Briter_Model_t *model; /*!< Encoder variant, decode read response*/
+#ifdef BRITER_ENCODER_STATS
+    Briter_Stats_t stats; /*!< Read transaction statistic*/
+#endif
 } Briter_Encoder_t;
 
+/** Encoder state read in one transaction by BRITER_RS485_GetState()*/
+typedef struct {
+    uint32_t value; /*!< Multi turn value, register 0x00-0x01*/
+    uint16_t turn; /*!< Number of turn, register 0x02*/
+    uint16_t single_turn; /*!< Single turn value, register 0x03*/
+} Briter_RS485_State_t;
+
+/** Register write collected by BRITER_RS485_Config_Add(), sorted by register*/
+typedef struct {
+    uint8_t count;
+    uint16_t reg[BRITER_RS485_CONFIG_MAX];
+    uint16_t value[BRITER_RS485_CONFIG_MAX];
+} Briter_RS485_Config_t;
+
 /** @defgroup BRITER_ENCODER_RS485_Exported_Constants
  * @{
  */
@@ -62,6 +187,11 @@ typedef struct {
 #define BRITER_RS485_SET_MIDPOINT_ADDR		0x0E	/*!< Set encoder midpoint*/
 #define BRITER_RS485_SET_MUL_5_ADDR		0x0F	/*!< Set current turn value to 5 turns*/
 
+/** Register kept in handler shadow, action register are always written*/
+#define BRITER_RS485_SHADOW_MASK	((1U << BRITER_RS485_ADDRESS_ADDR) | (1U << BRITER_RS485_BAUDRATE_ADDR) | (1U << BRITER_RS485_MODE_ADDR) \
+	| (1U << BRITER_RS485_RETURN_TIME_ADDR) | (1U << BRITER_RS485_INCREASING_DIRECTION_ADDR))
+#define BRITER_RS485_SHADOWED(reg)	((reg) < BRITER_SHADOW_KEY_COUNT && ((BRITER_RS485_SHADOW_MASK >> (reg)) & 1U))
+
 /******************************************************************************/
 /**************************** END REGISTER MAPPING  ***************************/
 /******************************************************************************/
@@ -124,6 +254,22 @@ typedef enum {
 */
 HAL_StatusTypeDef BRITER_RS485_Init(Briter_Encoder_t* handler,uint8_t address, UART_HandleTypeDef* huart);
 
+/**
+* @brief  Work out polling timeout from UART baudrate.
+* @param  handler: encoder handler
+* @param  turnaround_us: slave processing time budget before response
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_SetTiming(Briter_Encoder_t* handler, uint32_t turnaround_us);
+
+/**
+* @brief  Set encoder variant, BRITER_MODEL(RS485_4096X24) after BRITER_RS485_Init().
+* @param  handler: encoder handler
+* @param  model: model descriptor, refer to briter_encoder_model.h
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_SetModel(Briter_Encoder_t* handler, const Briter_Model_t* model);
+
 /**
 * @brief  Get encoder value though POLLING MODE.
 * @param  handler: encoder handler to give address and store encoder return value
@@ -131,6 +277,24 @@ HAL_StatusTypeDef BRITER_RS485_Init(Briter_Encoder_t* handler,uint8_t address, U
 */
 uint32_t BRITER_RS485_GetEncoderValue(Briter_Encoder_t* handler);
 
+/**
+* @brief  Read contiguous registers though POLLING MODE.
+* @param  handler: encoder handler
+* @param  reg: first register address
+* @param  count: number of register, up to BRITER_RS485_READ_MAX
+* @param  value: register value, count entry
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_ReadBlock(Briter_Encoder_t* handler, uint16_t reg, uint8_t count, uint16_t* value);
+
+/**
+* @brief  Read value, number of turn and single turn though POLLING MODE.
+* @param  handler: encoder handler
+* @param  state: decoded state
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_GetState(Briter_Encoder_t* handler, Briter_RS485_State_t* state);
+
 /**
 * @brief  Send info to encoder to read through DMA.
 * @param  handler: encoder handler
@@ -160,6 +324,7 @@ HAL_StatusTypeDef BRITER_RS485_SetBaudrate(Briter_Encoder_t* handler, RS485_Enc_
 * @param  handler: encoder handler
 * @param  to_address: the address you want to change to
 * @retval HAL status
+* @note   Handler address and request frame are updated when encoder acknowledge
 */
 HAL_StatusTypeDef BRITER_RS485_SetAddress(Briter_Encoder_t* handler, uint8_t to_address);
 
@@ -190,6 +355,192 @@ HAL_StatusTypeDef BRITER_RS485_SetReturnTime(Briter_Encoder_t* handler, uint16_t
 */
 HAL_StatusTypeDef BRITER_RS485_SetDirection(Briter_Encoder_t* handler, RS485_Enc_Direction_e direction);
 
+/**
+* @brief Set current position as encoder zero
+* @param  handler: encoder handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_SetZero(Briter_Encoder_t* handler);
+
+/**
+* @brief Set current value of encoder
+* @param  handler: encoder handler
+* @param  position: new encoder value
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_SetPosition(Briter_Encoder_t* handler, uint32_t position);
+
+/**
+* @brief Start empty configuration transaction
+* @param  config: transaction
+* @retval none
+*/
+void BRITER_RS485_Config_Begin(Briter_RS485_Config_t* config);
+
+/**
+* @brief Add register write to transaction
+* @param  config: transaction
+* @param  reg: register address, refer to Encoder REGISTER MAPPING
+* @param  value: register value, later write to same register replace it
+* @retval HAL status, HAL_ERROR if transaction is full
+*/
+HAL_StatusTypeDef BRITER_RS485_Config_Add(Briter_RS485_Config_t* config, uint16_t reg, uint16_t value);
+
+/**
+* @brief Write transaction with fewest frame through polling mode
+* @param  handler: encoder handler
+* @param  config: transaction
+* @retval HAL status, stop at first frame not echoed correctly
+* @note   Contiguous register go in one WRITE_MULTI frame, lone register use
+* 	single write, register shadow already hold the value is left out
+*/
+HAL_StatusTypeDef BRITER_RS485_Config_Commit(Briter_Encoder_t* handler, const Briter_RS485_Config_t* config);
+
+/**
+* @brief  Get value encoder is known to hold.
+* @param  handler: encoder handler
+* @param  reg: register address, refer to BRITER_RS485_SHADOW_MASK
+* @param  value: output value
+* @retval HAL_OK if known, HAL_ERROR if never written or invalidated
+*/
+HAL_StatusTypeDef BRITER_RS485_Shadow_Get(const Briter_Encoder_t* handler, uint16_t reg, uint16_t* value);
+
+/**
+* @brief  Forget known register value, e.g. after encoder power-cycle.
+* @param  handler: encoder handler
+* @retval none
+* @note   Value turn dirty and is written again by BRITER_RS485_Shadow_Flush(),
+* 	address stay known as handler keep talking to it
+*/
+void BRITER_RS485_Shadow_Invalidate(Briter_Encoder_t* handler);
+
+/**
+* @brief  Write every dirty register in one transaction through polling mode.
+* @param  handler: encoder handler
+* @retval HAL status, register failed stay dirty
+*/
+HAL_StatusTypeDef BRITER_RS485_Shadow_Flush(Briter_Encoder_t* handler);
+
+/**
+* @brief  Start non-blocking read of encoder value.
+* @param  handler: encoder handler
+* @param  callback: called from interrupt on completion, can be NULL
+* @param  context: passed to callback
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_GetEncoderValue_Async(Briter_Encoder_t* handler, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Non-blocking BRITER_RS485_SetBaudrate().
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_SetBaudrate_Async(Briter_Encoder_t* handler, RS485_Enc_Baudrate_e baudrate, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Non-blocking BRITER_RS485_SetAddress(), handler follow new address on success.
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_SetAddress_Async(Briter_Encoder_t* handler, uint8_t to_address, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Non-blocking BRITER_RS485_SetDataMode().
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_SetDataMode_Async(Briter_Encoder_t* handler, RS485_Enc_Mode_e mode, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Non-blocking BRITER_RS485_SetReturnTime().
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_SetReturnTime_Async(Briter_Encoder_t* handler, uint16_t time, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Non-blocking BRITER_RS485_SetDirection().
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_SetDirection_Async(Briter_Encoder_t* handler, RS485_Enc_Direction_e direction, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Non-blocking BRITER_RS485_SetZero().
+* @retval HAL status, HAL_BUSY if handler has operation in progress
+*/
+HAL_StatusTypeDef BRITER_RS485_SetZero_Async(Briter_Encoder_t* handler, Briter_RS485_Async_Callback callback, void* context);
+
+/**
+* @brief  Block until operation in progress finish.
+* @param  handler: encoder handler
+* @param  timeout: maximum wait in ms
+* @retval result of operation, HAL_TIMEOUT if still running after timeout
+* @note   Call from task that started operation, it sleep through BRITER_OS_Wait()
+* 	  and wake on operation timeout at the latest to complete it
+*/
+HAL_StatusTypeDef BRITER_RS485_Async_Wait(Briter_Encoder_t* handler, uint32_t timeout);
+
+/**
+* @brief  Abort operation without response after its timeout.
+* @param  handler: encoder handler
+* @retval none
+* @note   Call periodically when BRITER_RS485_Async_Wait() is not used
+*/
+void BRITER_RS485_Async_Process(Briter_Encoder_t* handler);
+
+/**
+* @brief  Asynchronous transmit complete callback.
+* @note   Use inside HAL_UART_TxCpltCallback()
+*/
+void BRITER_RS485_Async_TxCpltCallback(Briter_Encoder_t* handler, UART_HandleTypeDef* huart);
+
+/**
+* @brief  Asynchronous receive event callback.
+* @note   Use inside HAL_UARTEx_RxEventCallback()
+*/
+void BRITER_RS485_Async_RxEventCallback(Briter_Encoder_t* handler, UART_HandleTypeDef* huart, uint16_t Size);
+
+/**
+* @brief  Asynchronous error callback.
+* @note   Use inside HAL_UART_ErrorCallback()
+*/
+void BRITER_RS485_Async_ErrorCallback(Briter_Encoder_t* handler, UART_HandleTypeDef* huart);
+
+#ifdef BRITER_ENCODER_STATS
+/**
+* @brief  Copy read transaction statistic of handler.
+* @param  handler: encoder handler
+* @param  stats: pointer to copy
+* @retval none
+*/
+void BRITER_RS485_GetStats(const Briter_Encoder_t *handler, Briter_Stats_t *stats);
+
+/**
+* @brief  Clear read transaction statistic of handler.
+* @param  handler: encoder handler
+* @retval none
+*/
+void BRITER_RS485_ResetStats(Briter_Encoder_t *handler);
+#endif
+
+/**
+* @brief Get line rate of baudrate selection.
+* @param  baudrate: refer to @Briter RS485 Baudrate Selection
+* @retval bit per second, 0 if unknown
+*/
+uint32_t BRITER_RS485_BaudrateValue(RS485_Enc_Baudrate_e baudrate);
+
+/**
+* @brief Time taken by frame on the wire, 8N1.
+* @param  bps: bit per second
+* @param  size: number of byte, up to 256
+* @retval time in us, rounded up
+*/
+uint32_t BRITER_RS485_FrameTime_us(uint32_t bps, uint16_t size);
+
+/**
+* @brief Modbus inter-frame silence t3.5.
+* @param  bps: bit per second
+* @retval time in us, rounded up
+*/
+uint32_t BRITER_RS485_T35_us(uint32_t bps);
+
 /**
  * @}
  */
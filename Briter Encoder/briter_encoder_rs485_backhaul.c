@@ -0,0 +1,99 @@
+/**
+ * @file   briter_encoder_rs485_backhaul.c
+ * @brief  Source file of Briter RS485 backhaul ingestion.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_rs485_backhaul.h"
+#include "briter_encoder_time.h"
+#include <string.h>
+
+/** Data byte count of pushed value frame*/
+#define BACKHAUL_VALUE_BYTE_COUNT	4
+
+/** @defgroup briter_encoder_rs485_backhaul Private Functions
+ * @{
+ */
+static void Backhaul_Frame_Callback(void *context, const uint8_t *frame, uint16_t size);
+/**
+ * @}
+ */
+
+HAL_StatusTypeDef BRITER_RS485_Backhaul_Init(Briter_RS485_Backhaul_t *backhaul, Briter_Encoder_t *handler, uint32_t period) {
+    //Check if parameter is NULL ptr
+    if (!backhaul || !handler || !handler->huart)
+	return HAL_ERROR;
+    memset(backhaul, 0, sizeof(Briter_RS485_Backhaul_t));
+    backhaul->handler = handler;
+    backhaul->period = period;
+    BRITER_Sample_Ring_Init(&backhaul->ring);
+    return BRITER_RS485_Parser_Init(&backhaul->parser, handler->addr, Backhaul_Frame_Callback, backhaul);
+}
+
+HAL_StatusTypeDef BRITER_RS485_Backhaul_Start(Briter_RS485_Backhaul_t *backhaul) {
+    backhaul->last_pos = 0;
+    BRITER_RS485_Parser_Reset(&backhaul->parser);
+    return HAL_UARTEx_ReceiveToIdle_DMA(backhaul->handler->huart, backhaul->dma_buf, sizeof(backhaul->dma_buf));
+}
+
+HAL_StatusTypeDef BRITER_RS485_Backhaul_Stop(Briter_RS485_Backhaul_t *backhaul) {
+    return HAL_UART_AbortReceive(backhaul->handler->huart);
+}
+
+uint8_t BRITER_RS485_Backhaul_Read(Briter_RS485_Backhaul_t *backhaul, Briter_Sample_t *sample) {
+    return BRITER_Sample_Ring_Pop(&backhaul->ring, sample);
+}
+
+void BRITER_RS485_Backhaul_GetStats(const Briter_RS485_Backhaul_t *backhaul, Briter_RS485_Backhaul_Stats_t *stats) {
+    stats->sample_count = backhaul->sequence;
+    stats->dropped_count = backhaul->ring.dropped;
+    stats->overrun_count = backhaul->overrun_count;
+    stats->missed_count = backhaul->missed_count;
+    stats->crc_error_count = backhaul->parser.crc_error_count;
+}
+
+void BRITER_RS485_Backhaul_RxEventCallback(Briter_RS485_Backhaul_t *backhaul, UART_HandleTypeDef *huart, uint16_t Size) {
+    if (huart != backhaul->handler->huart)
+	return;
+    //Called on half, full and idle, feed only byte written since last event
+    backhaul->last_pos = BRITER_RS485_Parser_FeedCircular(&backhaul->parser, backhaul->dma_buf, sizeof(backhaul->dma_buf),
+	    backhaul->last_pos, Size);
+}
+
+void BRITER_RS485_Backhaul_ErrorCallback(Briter_RS485_Backhaul_t *backhaul, UART_HandleTypeDef *huart) {
+    if (huart != backhaul->handler->huart)
+	return;
+    if (huart->ErrorCode & HAL_UART_ERROR_ORE)
+	backhaul->overrun_count++;
+    //HAL stop DMA reception on error, partial frame is lost
+    HAL_UART_AbortReceive(huart);
+    BRITER_RS485_Backhaul_Start(backhaul);
+}
+
+/**
+ * @brief  Turn valid pushed frame into sample.
+ * @param  context pointer to backhaul handler
+ * @param  frame pointer to validated frame
+ * @param  size size of frame
+ * @retval none
+ */
+static void Backhaul_Frame_Callback(void *context, const uint8_t *frame, uint16_t size) {
+    Briter_RS485_Backhaul_t *backhaul = (Briter_RS485_Backhaul_t*) context;
+    if (frame[1] != 0x03 || frame[2] != BACKHAUL_VALUE_BYTE_COUNT)
+	return;
+    Briter_Sample_t sample;
+    sample.position = backhaul->handler->model->decode(frame);
+    sample.timestamp = BRITER_Encoder_GetTick();
+    sample.sequence = backhaul->sequence++;
+    //Gap over 1.5 period means at least one push did not arrive
+    if (backhaul->period && sample.sequence) {
+	uint32_t gap = BRITER_TICK_ELAPSED(sample.timestamp, backhaul->last_timestamp);
+	if (gap > backhaul->period + backhaul->period / 2)
+	    backhaul->missed_count += (gap + backhaul->period / 2) / backhaul->period - 1;
+    }
+    backhaul->last_timestamp = sample.timestamp;
+    backhaul->handler->encoder_value = sample.position;
+    backhaul->handler->timestamp = sample.timestamp;
+    backhaul->handler->sequence++;
+    BRITER_Sample_Ring_Push(&backhaul->ring, &sample);
+}
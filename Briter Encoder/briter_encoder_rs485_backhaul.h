@@ -0,0 +1,132 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_rs485_backhaul.h
+  * @author  Ang Chin Xian
+  * @brief   Ingestion of Briter RS485 encoder in backhaul (auto return) mode.
+  *
+  ==============================================================================
+                        ##### How to use this driver #####
+  ==============================================================================
+  1. Configure encoder with BRITER_RS485_SetReturnTime() and then
+      BRITER_RS485_SetDataMode(RS485_ENC_MODE_BACKHAUL), one encoder per UART
+  2. Set UART RX DMA to circular mode
+  3. Initialize with BRITER_RS485_Backhaul_Init() and call
+      BRITER_RS485_Backhaul_Start()
+  4. Route UART callbacks
+      - HAL_UARTEx_RxEventCallback() -> BRITER_RS485_Backhaul_RxEventCallback()
+      - HAL_UART_ErrorCallback()     -> BRITER_RS485_Backhaul_ErrorCallback()
+  5. Control task drain sample with BRITER_RS485_Backhaul_Read(), one
+      interrupt producer and one task consumer, no lock needed
+  6. Pushed frame has the same layout as read value response, each valid
+      frame become one Briter_Sample_t timestamped when it is received
+  7. Lost sample is counted as
+      - dropped : ring was full, control task is too slow
+      - overrun : UART overrun, byte lost before reaching DMA
+      - missed  : gap between two sample longer than 1.5 push period
+*/
+#ifndef BRITER_ENCODER_RS485_BACKHAUL_H_
+#define BRITER_ENCODER_RS485_BACKHAUL_H_
+
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_rs485_parser.h"
+#include "briter_encoder_sample.h"
+
+/** @defgroup BRITER_ENCODER_RS485_BACKHAUL_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_RS485_BACKHAUL_DMA_SIZE
+#define BRITER_RS485_BACKHAUL_DMA_SIZE	64	/*!< Circular DMA buffer size*/
+#endif
+/**
+ * @}
+ */
+
+/** Backhaul ingestion handler*/
+typedef struct {
+    Briter_Encoder_t *handler;
+    Briter_RS485_Parser_t parser;
+    Briter_Sample_Ring_t ring;
+    uint16_t last_pos; /*!< DMA position already fed to parser*/
+    uint32_t period; /*!< Expected tick between push, 0 to disable missed check*/
+    uint32_t last_timestamp;
+    uint32_t sequence;
+    uint32_t overrun_count;
+    uint32_t missed_count;
+    uint8_t dma_buf[BRITER_RS485_BACKHAUL_DMA_SIZE]; /*!< Circular DMA receive buffer*/
+} Briter_RS485_Backhaul_t;
+
+/** Backhaul statistic*/
+typedef struct {
+    uint32_t sample_count; /*!< Sample produced*/
+    uint32_t dropped_count; /*!< Sample lost as ring was full*/
+    uint32_t overrun_count; /*!< UART overrun*/
+    uint32_t missed_count; /*!< Push period missed*/
+    uint32_t crc_error_count; /*!< Frame with wrong CRC*/
+} Briter_RS485_Backhaul_Stats_t;
+
+/** @defgroup Briter_RS485_Backhaul_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize backhaul ingestion.
+* @param  backhaul: backhaul handler
+* @param  handler: initialized encoder handler, already in backhaul mode
+* @param  period: expected tick between push, 0 to disable missed check
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Backhaul_Init(Briter_RS485_Backhaul_t *backhaul, Briter_Encoder_t *handler, uint32_t period);
+
+/**
+* @brief  Start circular DMA reception.
+* @param  backhaul: backhaul handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Backhaul_Start(Briter_RS485_Backhaul_t *backhaul);
+
+/**
+* @brief  Stop reception.
+* @param  backhaul: backhaul handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Backhaul_Stop(Briter_RS485_Backhaul_t *backhaul);
+
+/**
+* @brief  Take oldest sample.
+* @param  backhaul: backhaul handler
+* @param  sample: oldest sample
+* @retval 1 if sample is taken, 0 if none
+*/
+uint8_t BRITER_RS485_Backhaul_Read(Briter_RS485_Backhaul_t *backhaul, Briter_Sample_t *sample);
+
+/**
+* @brief  Get statistic.
+* @param  backhaul: backhaul handler
+* @param  stats: copy of counters
+* @retval none
+*/
+void BRITER_RS485_Backhaul_GetStats(const Briter_RS485_Backhaul_t *backhaul, Briter_RS485_Backhaul_Stats_t *stats);
+
+/**
+* @brief  Receive event callback.
+* @param  backhaul: backhaul handler
+* @param  huart: uart handler from HAL callback
+* @param  Size: DMA position in circular buffer
+* @retval none
+* @note   Use inside HAL_UARTEx_RxEventCallback()
+*/
+void BRITER_RS485_Backhaul_RxEventCallback(Briter_RS485_Backhaul_t *backhaul, UART_HandleTypeDef *huart, uint16_t Size);
+
+/**
+* @brief  Error callback, count overrun and restart reception.
+* @param  backhaul: backhaul handler
+* @param  huart: uart handler from HAL callback
+* @retval none
+* @note   Use inside HAL_UART_ErrorCallback()
+*/
+void BRITER_RS485_Backhaul_ErrorCallback(Briter_RS485_Backhaul_t *backhaul, UART_HandleTypeDef *huart);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_RS485_BACKHAUL_H_ */
@@ -0,0 +1,385 @@
+/**
+ * @file   briter_encoder_rs485_bus.c
+ * @brief  Source file of Briter RS485 bus scheduler.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_rs485_bus.h"
+#include "briter_encoder_time.h"
+#include <string.h>
+
+/** Data byte count of response to read value request*/
+#define BUS_VALUE_BYTE_COUNT	4
+
+/** @defgroup briter_encoder_rs485_bus Private Functions
+ * @{
+ */
+static void Bus_Start_Next(Briter_RS485_Bus_t *bus, uint32_t now, uint32_t gap_us);
+static void Bus_Send(Briter_RS485_Bus_t *bus);
+static HAL_StatusTypeDef Bus_Receive(Briter_RS485_Bus_t *bus);
+static void Bus_Response(Briter_RS485_Bus_t *bus, uint16_t size);
+static void Bus_Check(Briter_RS485_Bus_t *bus, uint8_t index, const uint8_t *buf, uint16_t size, uint32_t start, uint32_t now);
+static void Bus_Fail(Briter_RS485_Bus_t *bus, uint8_t index, Briter_Stats_Class_e result);
+static void Bus_Frame_Callback(void *context, const uint8_t *frame, uint16_t size);
+static Briter_RS485_Bus_Slot_t* Bus_Find(Briter_RS485_Bus_t *bus, const Briter_Encoder_t *handler);
+/**
+ * @}
+ */
+
+HAL_StatusTypeDef BRITER_RS485_Bus_Init(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart, uint32_t timeout) {
+    //Check if parameter is NULL ptr
+    if (!bus || !huart || timeout == 0)
+	return HAL_ERROR;
+    memset(bus, 0, sizeof(Briter_RS485_Bus_t));
+    bus->huart = huart;
+    bus->timeout = timeout;
+    bus->state = BRITER_RS485_BUS_IDLE;
+    //Idle event come after one byte of silence, rest of t3.5 is left before next request
+    uint32_t bps = huart->Init.BaudRate ? huart->Init.BaudRate : BRITER_RS485_BaudrateValue(RS485_ENC_BAUDRATE_9600);
+    bus->gap_us = BRITER_RS485_T35_us(bps) - BRITER_RS485_FrameTime_us(bps, 1);
+    //Tick is only known to have passed once it changed twice
+    bus->gap_tick = (uint32_t) (((uint64_t) bus->gap_us * BRITER_TICK_PER_MS + 999) / 1000) + 1;
+    return BRITER_RS485_Parser_Init(&bus->parser, 0, Bus_Frame_Callback, bus);
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_Add(Briter_RS485_Bus_t *bus, Briter_Encoder_t *handler, uint32_t period) {
+    if (!bus || !handler || handler->huart != bus->huart || bus->slot_count >= BRITER_RS485_BUS_MAX_ENCODER)
+	return HAL_ERROR;
+    if (bus->running)
+	return HAL_BUSY;
+    if (Bus_Find(bus, handler) != NULL)
+	return HAL_ERROR;
+    Briter_RS485_Bus_Slot_t *slot = &bus->slot[bus->slot_count];
+    memset(slot, 0, sizeof(Briter_RS485_Bus_Slot_t));
+    slot->handler = handler;
+    slot->period = period;
+    bus->slot_count++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_SetPeriod(Briter_RS485_Bus_t *bus, Briter_Encoder_t *handler, uint32_t period) {
+    Briter_RS485_Bus_Slot_t *slot = Bus_Find(bus, handler);
+    if (slot == NULL)
+	return HAL_ERROR;
+    slot->period = period;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_SetOrder(Briter_RS485_Bus_t *bus, Briter_Encoder_t *const *order, uint8_t count) {
+    if (!bus || !order || count != bus->slot_count)
+	return HAL_ERROR;
+    if (bus->running)
+	return HAL_BUSY;
+    //Move each slot to its new position, order must be a permutation of registered handler
+    for (uint8_t i = 0; i < count; i++) {
+	Briter_RS485_Bus_Slot_t *slot = Bus_Find(bus, order[i]);
+	if (slot == NULL || slot < &bus->slot[i])
+	    return HAL_ERROR;
+	Briter_RS485_Bus_Slot_t tmp = bus->slot[i];
+	bus->slot[i] = *slot;
+	*slot = tmp;
+    }
+    bus->next = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_Start(Briter_RS485_Bus_t *bus) {
+    if (!bus || bus->slot_count == 0)
+	return HAL_ERROR;
+    uint32_t now = BRITER_Encoder_GetTick();
+    for (uint8_t i = 0; i < bus->slot_count; i++)
+	bus->slot[i].next_due = now;
+    bus->next = 0;
+    //Line is taken as quiet long enough, first request leave at once
+    bus->quiet_tick = now - bus->gap_tick;
+    bus->running = 1;
+    BRITER_RS485_Bus_Process(bus);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_Stop(Briter_RS485_Bus_t *bus) {
+    if (!bus)
+	return HAL_ERROR;
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    bus->running = 0;
+    if (bus->state != BRITER_RS485_BUS_IDLE) {
+	HAL_UART_Abort(bus->huart);
+	bus->state = BRITER_RS485_BUS_IDLE;
+    }
+    __set_PRIMASK(primask);
+    return HAL_OK;
+}
+
+void BRITER_RS485_Bus_Process(Briter_RS485_Bus_t *bus) {
+    uint32_t now = BRITER_Encoder_GetTick();
+    //Callback may change state from interrupt, keep check and update atomic
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (bus->running) {
+	if (bus->state == BRITER_RS485_BUS_IDLE) {
+	    //No gap needed once line has been quiet long enough since last transaction
+	    Bus_Start_Next(bus, now, BRITER_TICK_ELAPSED(now, bus->quiet_tick) >= bus->gap_tick ? 0 : bus->gap_us);
+	}
+	else if (bus->state == BRITER_RS485_BUS_GAP) {
+	    //No timer, send once gap is over on tick. Timer lost, gap is long over
+	    if (BRITER_TICK_ELAPSED(now, bus->start_tick) >= (bus->gap_timer ? bus->timeout : bus->gap_tick))
+		Bus_Send(bus);
+	}
+	else if (BRITER_TICK_ELAPSED(now, bus->start_tick) >= bus->timeout) {
+	    HAL_UART_Abort(bus->huart);
+	    Bus_Fail(bus, bus->current, bus->state == BRITER_RS485_BUS_TX ? BRITER_STATS_TX_TIMEOUT : BRITER_STATS_RX_TIMEOUT);
+	    bus->state = BRITER_RS485_BUS_IDLE;
+	    //Late response may still be on the line
+	    bus->quiet_tick = now;
+	    Bus_Start_Next(bus, now, bus->gap_us);
+	}
+    }
+    __set_PRIMASK(primask);
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_SetPipeline(Briter_RS485_Bus_t *bus, uint8_t enable) {
+    if (!bus)
+	return HAL_ERROR;
+    if (bus->running)
+	return HAL_BUSY;
+    bus->pipeline = enable ? 1 : 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_RS485_Bus_GetLatest(Briter_RS485_Bus_t *bus, const Briter_Encoder_t *handler, uint32_t *value, uint32_t *timestamp) {
+    Briter_RS485_Bus_Slot_t *slot = Bus_Find(bus, handler);
+    if (slot == NULL || value == NULL)
+	return HAL_ERROR;
+    //Value and timestamp are written together in RX callback
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t count = slot->sample_count;
+    *value = handler->encoder_value;
+    if (timestamp)
+	*timestamp = handler->timestamp;
+    __set_PRIMASK(primask);
+    return count ? HAL_OK : HAL_ERROR;
+}
+
+void BRITER_RS485_Bus_TxCpltCallback(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart) {
+    if (huart != bus->huart || bus->state != BRITER_RS485_BUS_TX)
+	return;
+    //Request is out, reception armed before it run until line goes idle after response
+    bus->state = BRITER_RS485_BUS_RX;
+    //Idle event served first when both interrupt are pending
+    if (bus->rx_pending) {
+	bus->rx_pending = 0;
+	Bus_Response(bus, bus->rx_pending_size);
+    }
+}
+
+void BRITER_RS485_Bus_RxEventCallback(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart, uint16_t Size) {
+    if (huart != bus->huart)
+	return;
+    if (bus->state == BRITER_RS485_BUS_TX) {
+	//TX complete of this request is still pending, response is handled there
+	bus->rx_pending = 1;
+	bus->rx_pending_size = Size;
+	return;
+    }
+    if (bus->state != BRITER_RS485_BUS_RX)
+	return;
+    Bus_Response(bus, Size);
+}
+
+void BRITER_RS485_Bus_ErrorCallback(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart) {
+    if (huart != bus->huart || bus->state == BRITER_RS485_BUS_IDLE)
+	return;
+    HAL_UART_Abort(huart);
+    Bus_Fail(bus, bus->current, BRITER_STATS_BUS_ERROR);
+    bus->state = BRITER_RS485_BUS_IDLE;
+    bus->quiet_tick = BRITER_Encoder_GetTick();
+    if (bus->running)
+	Bus_Start_Next(bus, bus->quiet_tick, bus->gap_us);
+}
+
+void BRITER_RS485_Bus_TimerCallback(Briter_RS485_Bus_t *bus) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    if (bus->state == BRITER_RS485_BUS_GAP)
+	Bus_Send(bus);
+    __set_PRIMASK(primask);
+}
+
+__weak uint8_t BRITER_RS485_Bus_StartTimer(Briter_RS485_Bus_t *bus, uint32_t delay_us) {
+    (void) bus;
+    (void) delay_us;
+    return 0;
+}
+
+/**
+ * @brief  Handle line idle after response of current encoder.
+ * @param  bus pointer to bus handler
+ * @param  size number of byte received
+ * @retval none
+ */
+static void Bus_Response(Briter_RS485_Bus_t *bus, uint16_t size) {
+    uint32_t now = BRITER_Encoder_GetTick();
+    uint8_t done = bus->current;
+    uint32_t start = bus->start_tick;
+    const uint8_t *buf = bus->rx_buf[bus->rx_index];
+    bus->state = BRITER_RS485_BUS_IDLE;
+    bus->quiet_tick = now;
+    if (bus->pipeline) {
+	//Next response go to other buffer, next request go out before this one is checked
+	bus->rx_index ^= 1;
+	if (bus->running)
+	    Bus_Start_Next(bus, now, bus->gap_us);
+	Bus_Check(bus, done, buf, size, start, now);
+    }
+    else {
+	Bus_Check(bus, done, buf, size, start, now);
+	if (bus->running)
+	    Bus_Start_Next(bus, now, bus->gap_us);
+    }
+}
+
+/**
+ * @brief  Pick next due encoder, round robin from last one, and start its request.
+ * @param  bus pointer to bus handler
+ * @param  now current tick
+ * @param  gap_us line silence still needed before request, 0 if none
+ * @retval none
+ * @note   Bus is left idle if no encoder is due, BRITER_RS485_Bus_Process() restart it
+ */
+static void Bus_Start_Next(Briter_RS485_Bus_t *bus, uint32_t now, uint32_t gap_us) {
+    bus->state = BRITER_RS485_BUS_IDLE;
+    for (uint8_t k = 0; k < bus->slot_count; k++) {
+	uint8_t i = (uint8_t) ((bus->next + k) % bus->slot_count);
+	Briter_RS485_Bus_Slot_t *slot = &bus->slot[i];
+	if (!BRITER_TICK_REACHED(now, slot->next_due))
+	    continue;
+	//Keep period phase, resync if more than one period behind
+	slot->next_due += slot->period;
+	if (BRITER_TICK_REACHED(now, slot->next_due))
+	    slot->next_due = now + slot->period;
+	bus->current = i;
+	bus->next = (uint8_t) ((i + 1) % bus->slot_count);
+	bus->start_tick = now;
+	//Arm reception first, response can not be missed however late TX complete is served
+	if (Bus_Receive(bus) != HAL_OK) {
+	    Bus_Fail(bus, i, BRITER_STATS_BUS_ERROR);
+	    return;
+	}
+	if (gap_us) {
+	    //State is set first, timer may expire before hook return
+	    bus->state = BRITER_RS485_BUS_GAP;
+	    //Without timer BRITER_RS485_Bus_Process() send once gap is over
+	    bus->gap_timer = BRITER_RS485_Bus_StartTimer(bus, gap_us);
+	    return;
+	}
+	Bus_Send(bus);
+	return;
+    }
+}
+
+/**
+ * @brief  Send prebuilt request of current encoder.
+ * @param  bus pointer to bus handler
+ * @retval none
+ */
+static void Bus_Send(Briter_RS485_Bus_t *bus) {
+    if (bus->state == BRITER_RS485_BUS_TX)
+	return;
+    bus->start_tick = BRITER_Encoder_GetTick();
+    bus->state = BRITER_RS485_BUS_TX;
+    if (HAL_UART_Transmit_DMA(bus->huart, bus->slot[bus->current].handler->query_frame, BRITER_RS485_QUERY_FRAME_SIZE) != HAL_OK) {
+	HAL_UART_AbortReceive(bus->huart);
+	Bus_Fail(bus, bus->current, BRITER_STATS_TX_TIMEOUT);
+	bus->state = BRITER_RS485_BUS_IDLE;
+    }
+}
+
+/**
+ * @brief  Start reception into active receive buffer until line goes idle.
+ * @param  bus pointer to bus handler
+ * @retval HAL status
+ */
+static HAL_StatusTypeDef Bus_Receive(Briter_RS485_Bus_t *bus) {
+    bus->rx_pending = 0;
+    if (HAL_UARTEx_ReceiveToIdle_DMA(bus->huart, bus->rx_buf[bus->rx_index], BRITER_RS485_BUS_RX_SIZE) != HAL_OK)
+	return HAL_ERROR;
+    __HAL_DMA_DISABLE_IT(bus->huart->hdmarx, DMA_IT_HT);
+    return HAL_OK;
+}
+
+/**
+ * @brief  Validate response of one encoder and store its value.
+ * @param  bus pointer to bus handler
+ * @param  index slot of encoder
+ * @param  buf received byte
+ * @param  size number of byte received
+ * @param  start tick when request was sent
+ * @param  now tick when response was received
+ * @retval none
+ */
+static void Bus_Check(Briter_RS485_Bus_t *bus, uint8_t index, const uint8_t *buf, uint16_t size, uint32_t start, uint32_t now) {
+    Briter_RS485_Bus_Slot_t *slot = &bus->slot[index];
+    //Parser skips noise before response and validates CRC
+    bus->response_ok = 0;
+    bus->model = slot->handler->model;
+    bus->parser.address = slot->handler->addr;
+    BRITER_RS485_Parser_Reset(&bus->parser);
+    uint32_t crc_error = bus->parser.crc_error_count;
+    BRITER_RS485_Parser_Feed(&bus->parser, buf, size);
+    if (bus->response_ok) {
+	slot->handler->encoder_value = bus->value;
+	slot->handler->timestamp = now;
+	slot->handler->sequence++;
+	slot->sample_count++;
+	BRITER_STATS_RECORD(&slot->handler->stats, BRITER_STATS_OK, now - start);
+    }
+    else {
+	Bus_Fail(bus, index, bus->parser.crc_error_count != crc_error ? BRITER_STATS_CRC : BRITER_STATS_MISMATCH);
+    }
+}
+
+/**
+ * @brief  Count failed transaction of encoder.
+ * @param  bus pointer to bus handler
+ * @param  index slot of encoder
+ * @param  result failure class, recorded in handler stats if enabled
+ * @retval none
+ */
+static void Bus_Fail(Briter_RS485_Bus_t *bus, uint8_t index, Briter_Stats_Class_e result) {
+    (void) result;
+    bus->slot[index].error_count++;
+    BRITER_STATS_RECORD(&bus->slot[index].handler->stats, result, 0);
+}
+
+/**
+ * @brief  Keep value of valid read response.
+ * @param  context pointer to bus handler
+ * @param  frame pointer to validated frame
+ * @param  size size of frame
+ * @retval none
+ */
+static void Bus_Frame_Callback(void *context, const uint8_t *frame, uint16_t size) {
+    Briter_RS485_Bus_t *bus = (Briter_RS485_Bus_t*) context;
+    if (frame[1] != 0x03 || frame[2] != BUS_VALUE_BYTE_COUNT)
+	return;
+    bus->value = bus->model->decode(frame);
+    bus->response_ok = 1;
+}
+
+/**
+ * @brief  Find slot of registered encoder.
+ * @param  bus pointer to bus handler
+ * @param  handler pointer to encoder handler
+ * @retval pointer to slot, NULL if not registered
+ */
+static Briter_RS485_Bus_Slot_t* Bus_Find(Briter_RS485_Bus_t *bus, const Briter_Encoder_t *handler) {
+    if (!bus || !handler)
+	return NULL;
+    for (uint8_t i = 0; i < bus->slot_count; i++) {
+	if (bus->slot[i].handler == handler)
+	    return &bus->slot[i];
+    }
+    return NULL;
+}
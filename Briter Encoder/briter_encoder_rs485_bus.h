@@ -0,0 +1,232 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_rs485_bus.h
+  * @author  Ang Chin Xian
+  * @brief   Non-blocking scheduler polling several Briter encoders sharing
+  *          one RS485 line through UART DMA.
+  *
+  ==============================================================================
+                        ##### How to use this driver #####
+  ==============================================================================
+  1. Initialize every encoder with BRITER_RS485_Init() on the same UART
+  2. Initialize bus with BRITER_RS485_Bus_Init() and response timeout in tick
+  3. Register encoders with BRITER_RS485_Bus_Add(), encoders are polled in
+      order of registration, change it with BRITER_RS485_Bus_SetOrder()
+      - period is minimum tick between two poll of same encoder, 0 to poll
+	every round
+  4. Route UART callbacks to the bus
+      - HAL_UART_TxCpltCallback()    -> BRITER_RS485_Bus_TxCpltCallback()
+      - HAL_UARTEx_RxEventCallback() -> BRITER_RS485_Bus_RxEventCallback()
+      - HAL_UART_ErrorCallback()     -> BRITER_RS485_Bus_ErrorCallback()
+  5. Call BRITER_RS485_Bus_Start(), then BRITER_RS485_Bus_Process() periodically
+      (main loop or SysTick). It never wait, it only restart an idle bus, end
+      inter-frame gap without timer and handle response timeout
+  6. Read result with BRITER_RS485_Bus_GetLatest(), value and timestamp are
+      also kept in Briter_Encoder_t::encoder_value and ::timestamp
+  7. Tick is BRITER_Encoder_GetTick(), refer to briter_encoder_time.h
+  8. Reception of response is armed before request is sent, so a late TX
+      complete interrupt never lose a byte, idle event served before it is
+      held until TX complete
+  9. Modbus want t3.5 silence between frame, idle event only give one byte
+      of it. Implement BRITER_RS485_Bus_StartTimer() with a one shot timer
+      calling BRITER_RS485_Bus_TimerCallback() to send exactly on the
+      boundary. Without it (default weak one return 0) request wait for
+      BRITER_RS485_Bus_Process() to see the gap over on tick
+  10. Pipeline mode, BRITER_RS485_Bus_SetPipeline() before start
+      - Next response go to the other buffer, gap and next request start on
+	response idle event and response just received is checked meanwhile
+      - Single mode check response before starting gap
+*/
+#ifndef BRITER_ENCODER_RS485_BUS_H_
+#define BRITER_ENCODER_RS485_BUS_H_
+
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_rs485_parser.h"
+
+/** @defgroup BRITER_ENCODER_RS485_BUS_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_RS485_BUS_MAX_ENCODER
+#define BRITER_RS485_BUS_MAX_ENCODER	8	/*!< Maximum encoder per bus*/
+#endif
+#define BRITER_RS485_BUS_RX_SIZE	16	/*!< Receive buffer, larger than read response*/
+/**
+ * @}
+ */
+
+/** Bus transaction state*/
+typedef enum {
+    BRITER_RS485_BUS_IDLE = 0x00,
+    BRITER_RS485_BUS_GAP, /*!< Waiting inter-frame silence before request*/
+    BRITER_RS485_BUS_TX, /*!< Request being sent by DMA*/
+    BRITER_RS485_BUS_RX, /*!< Waiting for line idle after response*/
+} Briter_RS485_Bus_State_e;
+
+/** Encoder polled by bus*/
+typedef struct {
+    Briter_Encoder_t *handler;
+    uint32_t period; /*!< Minimum tick between two poll*/
+    uint32_t next_due; /*!< Tick when encoder is due again*/
+    uint32_t sample_count; /*!< Number of valid response*/
+    uint32_t error_count; /*!< Number of failed transaction*/
+} Briter_RS485_Bus_Slot_t;
+
+/** RS485 bus scheduler*/
+typedef struct {
+    UART_HandleTypeDef *huart;
+    Briter_RS485_Bus_Slot_t slot[BRITER_RS485_BUS_MAX_ENCODER];
+    uint8_t slot_count;
+    uint8_t current; /*!< Slot of transaction in progress*/
+    uint8_t next; /*!< Slot to start searching on next transaction*/
+    volatile uint8_t running;
+    volatile Briter_RS485_Bus_State_e state;
+    uint32_t start_tick; /*!< Tick when transaction started*/
+    uint32_t timeout; /*!< Response timeout in tick*/
+    uint8_t rx_buf[2][BRITER_RS485_BUS_RX_SIZE]; /*!< DMA receive buffer, alternate in pipeline mode*/
+    uint8_t rx_index; /*!< Buffer of reception in progress*/
+    uint8_t pipeline; /*!< Send next request before checking response*/
+    uint8_t rx_pending; /*!< Idle event arrived before TX complete, held for TX complete*/
+    uint16_t rx_pending_size; /*!< Size of held idle event*/
+    uint32_t gap_us; /*!< Silence left after idle event before next request*/
+    uint32_t gap_tick; /*!< Tick covering gap_us for BRITER_RS485_Bus_Process()*/
+    uint8_t gap_timer; /*!< Gap is timed by BRITER_RS485_Bus_StartTimer()*/
+    uint32_t quiet_tick; /*!< Tick when line last went quiet*/
+    Briter_RS485_Parser_t parser; /*!< Find response in received byte*/
+    uint8_t response_ok; /*!< Set by parser when response is found*/
+    uint32_t value; /*!< Value of response found by parser*/
+    const Briter_Model_t *model; /*!< Model of encoder being checked*/
+} Briter_RS485_Bus_t;
+
+/** @defgroup Briter_RS485_Bus_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize bus scheduler.
+* @param  bus: bus handler
+* @param  huart: uart handler shared by encoders
+* @param  timeout: tick allowed from request start to response
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_Init(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart, uint32_t timeout);
+
+/**
+* @brief  Register encoder to bus, poll order follow registration order.
+* @param  bus: bus handler
+* @param  handler: initialized encoder handler on same uart
+* @param  period: minimum tick between two poll, 0 to poll every round
+* @retval HAL status, HAL_BUSY if bus is running
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_Add(Briter_RS485_Bus_t *bus, Briter_Encoder_t *handler, uint32_t period);
+
+/**
+* @brief  Change poll period of registered encoder.
+* @param  bus: bus handler
+* @param  handler: registered encoder handler
+* @param  period: minimum tick between two poll, 0 to poll every round
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_SetPeriod(Briter_RS485_Bus_t *bus, Briter_Encoder_t *handler, uint32_t period);
+
+/**
+* @brief  Change poll order.
+* @param  bus: bus handler
+* @param  order: every registered encoder handler, in new poll order
+* @param  count: number of handler in order, must equal registered count
+* @retval HAL status, HAL_BUSY if bus is running
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_SetOrder(Briter_RS485_Bus_t *bus, Briter_Encoder_t *const *order, uint8_t count);
+
+/**
+* @brief  Start polling.
+* @param  bus: bus handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_Start(Briter_RS485_Bus_t *bus);
+
+/**
+* @brief  Stop polling, transaction in progress is aborted.
+* @param  bus: bus handler
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_Stop(Briter_RS485_Bus_t *bus);
+
+/**
+* @brief  Restart idle bus, end inter-frame gap not timed by timer and check
+* 	  response timeout.
+* @param  bus: bus handler
+* @retval none
+* @note   Call periodically, does not block
+*/
+void BRITER_RS485_Bus_Process(Briter_RS485_Bus_t *bus);
+
+/**
+* @brief  Enable or disable pipeline mode.
+* @param  bus: bus handler
+* @param  enable: 1 to enable
+* @retval HAL status, HAL_BUSY if bus is running
+* @note   Mode is only changed here, without BRITER_RS485_Bus_StartTimer() the
+* 	  request wait for BRITER_RS485_Bus_Process() after t3.5
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_SetPipeline(Briter_RS485_Bus_t *bus, uint8_t enable);
+
+/**
+* @brief  Get latest value of encoder.
+* @param  bus: bus handler
+* @param  handler: registered encoder handler
+* @param  value: latest encoder value
+* @param  timestamp: tick when value was received, can be NULL
+* @retval HAL status, HAL_ERROR if no value received yet
+*/
+HAL_StatusTypeDef BRITER_RS485_Bus_GetLatest(Briter_RS485_Bus_t *bus, const Briter_Encoder_t *handler, uint32_t *value, uint32_t *timestamp);
+
+/**
+* @brief  Bus transmit complete callback.
+* @param  bus: bus handler
+* @param  huart: uart handler from HAL callback
+* @retval none
+* @note   Use inside HAL_UART_TxCpltCallback()
+*/
+void BRITER_RS485_Bus_TxCpltCallback(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart);
+
+/**
+* @brief  Bus receive event callback.
+* @param  bus: bus handler
+* @param  huart: uart handler from HAL callback
+* @param  Size: number of byte received
+* @retval none
+* @note   Use inside HAL_UARTEx_RxEventCallback()
+*/
+void BRITER_RS485_Bus_RxEventCallback(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart, uint16_t Size);
+
+/**
+* @brief  Bus error callback.
+* @param  bus: bus handler
+* @param  huart: uart handler from HAL callback
+* @retval none
+* @note   Use inside HAL_UART_ErrorCallback()
+*/
+void BRITER_RS485_Bus_ErrorCallback(Briter_RS485_Bus_t *bus, UART_HandleTypeDef *huart);
+
+/**
+* @brief  Inter-frame timer expired callback.
+* @param  bus: bus handler
+* @retval none
+* @note   Call from one shot timer started by BRITER_RS485_Bus_StartTimer()
+*/
+void BRITER_RS485_Bus_TimerCallback(Briter_RS485_Bus_t *bus);
+
+/**
+* @brief  Start one shot inter-frame timer.
+* @param  bus: bus handler
+* @param  delay_us: silence left before next request
+* @retval 1 if timer is started, 0 if no timer, BRITER_RS485_Bus_Process() then
+* 	  send the request
+* @note   Weak, default return 0
+*/
+uint8_t BRITER_RS485_Bus_StartTimer(Briter_RS485_Bus_t *bus, uint32_t delay_us);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_RS485_BUS_H_ */
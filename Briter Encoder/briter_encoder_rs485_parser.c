@@ -0,0 +1,177 @@
+/**
+ * @file   briter_encoder_rs485_parser.c
+ * @brief  Source file of streaming Modbus-RTU frame parser.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_rs485_parser.h"
+#include "briter_encoder_crc.h"
+#include <string.h>
+
+/** Returned by Parser_Expected() when function code cannot start a frame*/
+#define PARSER_INVALID	0xFFFF
+
+/** @defgroup briter_encoder_rs485_parser Private Functions
+ * @{
+ */
+static void Parser_Process(Briter_RS485_Parser_t *parser);
+static uint16_t Parser_Expected(const Briter_RS485_Parser_t *parser);
+static void Parser_Consume(Briter_RS485_Parser_t *parser, uint16_t count);
+static void Parser_Resync(Briter_RS485_Parser_t *parser);
+static uint8_t Parser_Accept_Address(const Briter_RS485_Parser_t *parser, uint8_t address);
+/**
+ * @}
+ */
+
+HAL_StatusTypeDef BRITER_RS485_Parser_Init(Briter_RS485_Parser_t *parser, uint8_t address, Briter_RS485_Frame_Callback callback, void *context) {
+    if (!parser || !callback)
+	return HAL_ERROR;
+    memset(parser, 0, sizeof(Briter_RS485_Parser_t));
+    parser->address = address;
+    parser->callback = callback;
+    parser->context = context;
+    parser->crc = BRITER_CRC16_INIT;
+    return HAL_OK;
+}
+
+void BRITER_RS485_Parser_Reset(Briter_RS485_Parser_t *parser) {
+    parser->discard_count += parser->length;
+    parser->length = 0;
+    parser->expected = 0;
+    parser->crc = BRITER_CRC16_INIT;
+}
+
+void BRITER_RS485_Parser_Feed(Briter_RS485_Parser_t *parser, const uint8_t *pData, uint16_t Size) {
+    while (Size--) {
+	uint8_t byte = *pData++;
+	//Skip byte that cannot start a frame without touching buffer
+	if (parser->length == 0 && !Parser_Accept_Address(parser, byte)) {
+	    parser->discard_count++;
+	    continue;
+	}
+	parser->frame[parser->length++] = byte;
+	parser->crc = BRITER_CRC16_UpdateByte(parser->crc, byte);
+	Parser_Process(parser);
+    }
+}
+
+uint16_t BRITER_RS485_Parser_FeedCircular(Briter_RS485_Parser_t *parser, const uint8_t *pBuf, uint16_t buf_size, uint16_t last_pos, uint16_t pos) {
+    if (pos > buf_size || last_pos >= buf_size)
+	return 0;
+    if (pos >= last_pos) {
+	BRITER_RS485_Parser_Feed(parser, &pBuf[last_pos], (uint16_t) (pos - last_pos));
+    }
+    else {
+	//DMA wrapped around end of buffer
+	BRITER_RS485_Parser_Feed(parser, &pBuf[last_pos], (uint16_t) (buf_size - last_pos));
+	BRITER_RS485_Parser_Feed(parser, pBuf, pos);
+    }
+    return (pos == buf_size) ? 0 : pos;
+}
+
+/**
+ * @brief  Emit complete frame or resync, until more byte is needed.
+ * @param  parser pointer to parser handler
+ * @retval none
+ */
+static void Parser_Process(Briter_RS485_Parser_t *parser) {
+    while (parser->length) {
+	if (parser->expected == 0) {
+	    parser->expected = Parser_Expected(parser);
+	    if (parser->expected == 0)
+		return; //Need more byte to know frame size
+	}
+	if (parser->expected == PARSER_INVALID) {
+	    Parser_Resync(parser);
+	    continue;
+	}
+	if (parser->length < parser->expected)
+	    return;
+	//CRC over whole frame including its CRC byte is 0 for valid frame
+	uint16_t crc = parser->crc;
+	if (parser->length != parser->expected)
+	    crc = BRITER_CRC16_Calculate(parser->frame, parser->expected);
+	if (crc != 0) {
+	    parser->crc_error_count++;
+	    Parser_Resync(parser);
+	    continue;
+	}
+	parser->frame_count++;
+	parser->callback(parser->context, parser->frame, parser->expected);
+	Parser_Consume(parser, parser->expected);
+    }
+}
+
+/**
+ * @brief  Work out frame size from buffered header.
+ * @param  parser pointer to parser handler
+ * @retval frame size, 0 if more byte needed, PARSER_INVALID if not a frame
+ */
+static uint16_t Parser_Expected(const Briter_RS485_Parser_t *parser) {
+    if (!Parser_Accept_Address(parser, parser->frame[0]))
+	return PARSER_INVALID;
+    if (parser->length < 2)
+	return 0;
+    uint16_t size;
+    switch (parser->frame[1]) {
+    case 0x03: //Read, addr + func + byte count + data + CRC
+	if (parser->length < 3)
+	    return 0;
+	size = (uint16_t) (parser->frame[2] + 5);
+	break;
+    case 0x06: //Write single, echo of request
+    case 0x10: //Write multi, addr + func + start + count + CRC
+	size = 8;
+	break;
+    case 0x83:
+    case 0x86:
+    case 0x90: //Exception, addr + func + code + CRC
+	size = 5;
+	break;
+    default:
+	return PARSER_INVALID;
+    }
+    return (size > BRITER_RS485_PARSER_MAX_FRAME) ? PARSER_INVALID : size;
+}
+
+/**
+ * @brief  Remove byte from front of buffer.
+ * @param  parser pointer to parser handler
+ * @param  count number of byte to remove
+ * @retval none
+ */
+static void Parser_Consume(Briter_RS485_Parser_t *parser, uint16_t count) {
+    parser->length = (uint16_t) (parser->length - count);
+    if (parser->length)
+	memmove(parser->frame, &parser->frame[count], parser->length);
+    parser->expected = 0;
+    parser->crc = BRITER_CRC16_Calculate(parser->frame, parser->length);
+}
+
+/**
+ * @brief  Drop first byte and restart from next byte that may start a frame.
+ * @param  parser pointer to parser handler
+ * @retval none
+ */
+static void Parser_Resync(Briter_RS485_Parser_t *parser) {
+    uint16_t i;
+    for (i = 1; i < parser->length; i++) {
+	if (Parser_Accept_Address(parser, parser->frame[i]))
+	    break;
+    }
+    parser->discard_count += i;
+    Parser_Consume(parser, i);
+}
+
+/**
+ * @brief  Check if byte can be address of frame.
+ * @param  parser pointer to parser handler
+ * @param  address byte to check
+ * @retval 1 if accepted
+ */
+static uint8_t Parser_Accept_Address(const Briter_RS485_Parser_t *parser, uint8_t address) {
+    if (parser->address)
+	return address == parser->address;
+    //Any slave address, 0 is broadcast and never answers
+    return address != 0 && address <= 247;
+}
@@ -0,0 +1,106 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_rs485_parser.h
+  * @author  Ang Chin Xian
+  * @brief   Streaming Modbus-RTU frame parser for Briter RS485 receive path.
+  *
+  ==============================================================================
+                        ##### How to use this driver #####
+  ==============================================================================
+  1. Initialize parser with BRITER_RS485_Parser_Init(), give address to accept
+      (0 for any) and callback called for every valid frame
+  2. Feed received byte in any chunk size
+      - Linear buffer : BRITER_RS485_Parser_Feed()
+      - Circular DMA  : in HAL_UARTEx_RxEventCallback(), call
+	last = BRITER_RS485_Parser_FeedCircular(&parser, RxBuf, RxBuf_SIZE, last, Size);
+  3. CRC is updated as each byte arrive, frame is validated once its last
+      byte is fed. Garbage byte and broken frame are skipped, parser resync
+      on next address/function boundary
+  4. Frame pointer given to callback points into parser buffer, it is only
+      valid during callback. Byte is copied once from DMA buffer as frame may
+      wrap around circular buffer end
+  5. Call BRITER_RS485_Parser_Reset() to drop partial frame, e.g. on t3.5 gap
+*/
+#ifndef BRITER_ENCODER_RS485_PARSER_H_
+#define BRITER_ENCODER_RS485_PARSER_H_
+
+#include <stdint.h>
+#include "briter_encoder_rs485.h"
+
+/** @defgroup BRITER_ENCODER_RS485_PARSER_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_RS485_PARSER_MAX_FRAME
+#define BRITER_RS485_PARSER_MAX_FRAME	64	/*!< Longest frame accepted, longer frame is dropped*/
+#endif
+/**
+ * @}
+ */
+
+/**
+* @brief  Called for every valid frame.
+* @param  context: user context given in BRITER_RS485_Parser_Init()
+* @param  frame: frame including address and CRC
+* @param  size: number of byte in frame
+*/
+typedef void (*Briter_RS485_Frame_Callback)(void *context, const uint8_t *frame, uint16_t size);
+
+/** Parser handler*/
+typedef struct {
+    uint8_t address; /*!< Address to accept, 0 for any*/
+    uint16_t length; /*!< Byte buffered in frame*/
+    uint16_t expected; /*!< Total frame size, 0 if not known yet*/
+    uint16_t crc; /*!< Running CRC of buffered byte*/
+    uint32_t frame_count; /*!< Valid frame*/
+    uint32_t crc_error_count; /*!< Complete frame with wrong CRC*/
+    uint32_t discard_count; /*!< Byte skipped to resync*/
+    Briter_RS485_Frame_Callback callback;
+    void *context;
+    uint8_t frame[BRITER_RS485_PARSER_MAX_FRAME];
+} Briter_RS485_Parser_t;
+
+/** @defgroup Briter_RS485_Parser_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize parser.
+* @param  parser: parser handler
+* @param  address: slave address to accept, 0 for any
+* @param  callback: called for every valid frame
+* @param  context: passed to callback
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_RS485_Parser_Init(Briter_RS485_Parser_t *parser, uint8_t address, Briter_RS485_Frame_Callback callback, void *context);
+
+/**
+* @brief  Drop partial frame.
+* @param  parser: parser handler
+* @retval none
+*/
+void BRITER_RS485_Parser_Reset(Briter_RS485_Parser_t *parser);
+
+/**
+* @brief  Feed received byte.
+* @param  parser: parser handler
+* @param  pData: pointer to received byte
+* @param  Size: number of byte
+* @retval none
+*/
+void BRITER_RS485_Parser_Feed(Briter_RS485_Parser_t *parser, const uint8_t *pData, uint16_t Size);
+
+/**
+* @brief  Feed new byte of circular DMA buffer.
+* @param  parser: parser handler
+* @param  pBuf: circular DMA buffer
+* @param  buf_size: size of circular buffer
+* @param  last_pos: position returned by previous call, 0 at start
+* @param  pos: current DMA write position, Size of HAL_UARTEx_RxEventCallback()
+* @retval position to give on next call
+*/
+uint16_t BRITER_RS485_Parser_FeedCircular(Briter_RS485_Parser_t *parser, const uint8_t *pBuf, uint16_t buf_size, uint16_t last_pos, uint16_t pos);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_RS485_PARSER_H_ */
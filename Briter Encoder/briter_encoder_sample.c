@@ -0,0 +1,45 @@
+/**
+ * @file   briter_encoder_sample.c
+ * @brief  Source file of lock-free encoder sample ring.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_sample.h"
+#include "briter_encoder_port.h"
+#include <string.h>
+
+#define RING_MASK	(BRITER_SAMPLE_RING_SIZE - 1)
+
+void BRITER_Sample_Ring_Init(Briter_Sample_Ring_t *ring) {
+    memset(ring, 0, sizeof(Briter_Sample_Ring_t));
+}
+
+uint8_t BRITER_Sample_Ring_Push(Briter_Sample_Ring_t *ring, const Briter_Sample_t *sample) {
+    uint32_t head = ring->head;
+    if (head - ring->tail >= BRITER_SAMPLE_RING_SIZE) {
+	ring->dropped++;
+	return 0;
+    }
+    ring->buf[head & RING_MASK] = *sample;
+    //Sample must be visible before consumer sees new head
+    __DMB();
+    ring->head = head + 1;
+    return 1;
+}
+
+uint8_t BRITER_Sample_Ring_Pop(Briter_Sample_Ring_t *ring, Briter_Sample_t *sample) {
+    uint32_t tail = ring->tail;
+    if (ring->head == tail)
+	return 0;
+    //Head is read before sample it publishes
+    __DMB();
+    *sample = ring->buf[tail & RING_MASK];
+    //Sample is copied out before slot is given back to producer
+    __DMB();
+    ring->tail = tail + 1;
+    return 1;
+}
+
+uint32_t BRITER_Sample_Ring_Count(const Briter_Sample_Ring_t *ring) {
+    return ring->head - ring->tail;
+}
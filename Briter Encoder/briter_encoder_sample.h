@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_sample.h
+  * @author  Ang Chin Xian
+  * @brief   Timestamped encoder sample and lock-free single producer/single
+  *          consumer sample ring shared by the Briter encoder drivers.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Producer (usually UART/CAN interrupt) call BRITER_Sample_Ring_Push()
+  2. Consumer (main loop or RTOS task) call BRITER_Sample_Ring_Pop()
+  3. Only one producer and one consumer per ring, no lock or critical section
+      is used, ordering is kept with memory barrier
+  4. When ring is full new sample is dropped and counted in ::dropped,
+      gap in ::sequence of popped sample also shows lost sample
+*/
+#ifndef BRITER_ENCODER_SAMPLE_H_
+#define BRITER_ENCODER_SAMPLE_H_
+
+#include <stdint.h>
+
+/** @defgroup BRITER_ENCODER_SAMPLE_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_SAMPLE_RING_SIZE
+#define BRITER_SAMPLE_RING_SIZE		32	/*!< Sample per ring, power of 2*/
+#endif
+
+#if (BRITER_SAMPLE_RING_SIZE & (BRITER_SAMPLE_RING_SIZE - 1)) != 0
+#error "BRITER_SAMPLE_RING_SIZE must be power of 2"
+#endif
+/**
+ * @}
+ */
+
+/** Encoder sample*/
+typedef struct {
+    uint32_t position; /*!< Raw encoder value*/
+    uint32_t timestamp; /*!< BRITER_Encoder_GetTick() when sample was received*/
+    uint32_t sequence; /*!< Incremented on every sample produced*/
+} Briter_Sample_t;
+
+/** Single producer/single consumer sample ring*/
+typedef struct {
+    volatile uint32_t head; /*!< Written by producer only*/
+    volatile uint32_t tail; /*!< Written by consumer only*/
+    volatile uint32_t dropped; /*!< Sample lost as ring was full, written by producer only*/
+    Briter_Sample_t buf[BRITER_SAMPLE_RING_SIZE];
+} Briter_Sample_Ring_t;
+
+/** @defgroup Briter_Sample_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize empty ring.
+* @param  ring: sample ring
+* @retval none
+*/
+void BRITER_Sample_Ring_Init(Briter_Sample_Ring_t *ring);
+
+/**
+* @brief  Add sample to ring, producer side.
+* @param  ring: sample ring
+* @param  sample: sample to copy into ring
+* @retval 1 if added, 0 if ring is full and sample is dropped
+*/
+uint8_t BRITER_Sample_Ring_Push(Briter_Sample_Ring_t *ring, const Briter_Sample_t *sample);
+
+/**
+* @brief  Take oldest sample from ring, consumer side.
+* @param  ring: sample ring
+* @param  sample: copy of oldest sample
+* @retval 1 if sample is taken, 0 if ring is empty
+*/
+uint8_t BRITER_Sample_Ring_Pop(Briter_Sample_Ring_t *ring, Briter_Sample_t *sample);
+
+/**
+* @brief  Number of sample waiting in ring.
+* @param  ring: sample ring
+* @retval number of sample
+*/
+uint32_t BRITER_Sample_Ring_Count(const Briter_Sample_Ring_t *ring);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_SAMPLE_H_ */
@@ -0,0 +1,44 @@
+/**
+ * @file   briter_encoder_shadow.c
+ * @brief  Source file of Briter encoder configuration register shadow.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_shadow.h"
+#include <string.h>
+
+void BRITER_Shadow_Init(Briter_Shadow_t *shadow) {
+    memset(shadow, 0, sizeof(Briter_Shadow_t));
+}
+
+void BRITER_Shadow_Update(Briter_Shadow_t *shadow, uint8_t key, uint16_t value, HAL_StatusTypeDef status) {
+    uint16_t bit = (uint16_t) (1U << key);
+    //Asynchronous write complete in interrupt, mask update must not be torn
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    shadow->value[key] = value;
+    if (status == HAL_OK) {
+	shadow->valid |= bit;
+	shadow->dirty &= (uint16_t) ~bit;
+    } else {
+	//Encoder may or may not have taken it
+	shadow->valid &= (uint16_t) ~bit;
+	shadow->dirty |= bit;
+    }
+    __set_PRIMASK(primask);
+}
+
+void BRITER_Shadow_Invalidate(Briter_Shadow_t *shadow) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    shadow->dirty |= shadow->valid;
+    shadow->valid = 0;
+    __set_PRIMASK(primask);
+}
+
+HAL_StatusTypeDef BRITER_Shadow_Get(const Briter_Shadow_t *shadow, uint8_t key, uint16_t *value) {
+    if (!(shadow->valid & (1U << key)))
+	return HAL_ERROR;
+    *value = shadow->value[key];
+    return HAL_OK;
+}
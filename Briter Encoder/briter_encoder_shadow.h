@@ -0,0 +1,89 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_shadow.h
+  * @author  Ang Chin Xian
+  * @brief   Shadow of configuration register last written to Briter encoder.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. RS485 and CAN handler carry a Briter_Shadow_t, setter check it before
+      going to the bus, nothing to call for normal use
+      - RS485 key is register address, CAN key is command
+  2. Each key is in one of three state
+      - valid, encoder is known to hold value, writing same value is skipped
+      - dirty, value is wanted but not confirmed on encoder, e.g. write
+	failed or encoder may have reset since
+      - neither, nothing is known, first write always go to the bus
+  3. Call BRITER_RS485_Shadow_Invalidate()/BRITER_CAN_Shadow_Invalidate() when
+      encoder may have power-cycled, every valid key turn dirty
+  4. BRITER_RS485_Shadow_Flush()/BRITER_CAN_Shadow_Flush() write back only dirty
+      key, so re-applying config after fault send the delta only
+  5. Action register such as set zero are not shadowed and always sent
+*/
+#ifndef BRITER_ENCODER_SHADOW_H_
+#define BRITER_ENCODER_SHADOW_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+
+/** @defgroup BRITER_ENCODER_SHADOW_Exported_Constants
+ * @{
+ */
+#define BRITER_SHADOW_KEY_COUNT		16	/*!< Key 0 to 15, one bit each in mask*/
+/**
+ * @}
+ */
+
+typedef struct {
+    uint16_t value[BRITER_SHADOW_KEY_COUNT]; /*!< Known value if valid, wanted value if dirty*/
+    uint16_t valid; /*!< Bit n set, encoder hold value[n]*/
+    uint16_t dirty; /*!< Bit n set, value[n] still to be written*/
+} Briter_Shadow_t;
+
+/**
+* @brief  Check if writing value would change nothing on encoder.
+* @param  shadow: pointer to shadow
+* @param  key: register or command
+* @param  value: value to be written
+* @retval 1 if key is valid and hold value, 0 otherwise
+*/
+static inline uint8_t BRITER_Shadow_Match(const Briter_Shadow_t *shadow, uint8_t key, uint16_t value) {
+    return (shadow->valid & (1U << key)) && shadow->value[key] == value;
+}
+
+/**
+* @brief  Clear every key, nothing known and nothing to write.
+* @param  shadow: pointer to shadow
+* @retval none
+*/
+void BRITER_Shadow_Init(Briter_Shadow_t *shadow);
+
+/**
+* @brief  Record result of write.
+* @param  shadow: pointer to shadow
+* @param  key: register or command
+* @param  value: value written
+* @param  status: HAL_OK mark key valid, otherwise mark key dirty
+* @retval none
+* @note   Safe to call from interrupt
+*/
+void BRITER_Shadow_Update(Briter_Shadow_t *shadow, uint8_t key, uint16_t value, HAL_StatusTypeDef status);
+
+/**
+* @brief  Turn every valid key dirty, e.g. after encoder power-cycle.
+* @param  shadow: pointer to shadow
+* @retval none
+*/
+void BRITER_Shadow_Invalidate(Briter_Shadow_t *shadow);
+
+/**
+* @brief  Get known value of key.
+* @param  shadow: pointer to shadow
+* @param  key: register or command
+* @param  value: output value
+* @retval HAL_OK if key is valid, HAL_ERROR otherwise
+*/
+HAL_StatusTypeDef BRITER_Shadow_Get(const Briter_Shadow_t *shadow, uint8_t key, uint16_t *value);
+
+#endif /* BRITER_ENCODER_SHADOW_H_ */
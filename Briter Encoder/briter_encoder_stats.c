@@ -0,0 +1,27 @@
+/**
+ * @file   briter_encoder_stats.c
+ * @brief  Source file of Briter encoder transaction statistic.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_stats.h"
+#include <string.h>
+
+void BRITER_Stats_Snapshot(const Briter_Stats_t *stats, Briter_Stats_t *snapshot) {
+    //Handler update stats from interrupt, copy must not be torn
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    memcpy(snapshot, stats, sizeof(Briter_Stats_t));
+    __set_PRIMASK(primask);
+}
+
+void BRITER_Stats_Reset(Briter_Stats_t *stats) {
+    uint32_t primask = __get_PRIMASK();
+    __disable_irq();
+    uint32_t start = stats->start;
+    uint8_t pending = stats->pending;
+    memset(stats, 0, sizeof(Briter_Stats_t));
+    stats->start = start;
+    stats->pending = pending;
+    __set_PRIMASK(primask);
+}
@@ -0,0 +1,150 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_stats.h
+  * @author  Ang Chin Xian
+  * @brief   Optional transaction statistic of Briter encoder handler.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Define BRITER_ENCODER_STATS in compiler option, RS485 and CAN handler then
+      carry a Briter_Stats_t and every read transaction is recorded, without
+      it handler has no stats member and every record macro compile to nothing
+  2. Each transaction end in one class of ::Briter_Stats_Class_e
+  3. Latency from request to valid response is in BRITER_Encoder_GetTick()
+      tick, override it with a faster timer for finer histogram
+      - latency_hist[0] count 0 tick
+      - latency_hist[n] count 2^(n-1) to 2^n - 1 tick
+      - last bin also count everything above it
+  4. Take copy with BRITER_RS485_GetStats()/BRITER_CAN_GetStats(), clear with
+      BRITER_RS485_ResetStats()/BRITER_CAN_ResetStats()
+*/
+#ifndef BRITER_ENCODER_STATS_H_
+#define BRITER_ENCODER_STATS_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+
+/** @defgroup BRITER_ENCODER_STATS_Exported_Constants
+ * @{
+ */
+#ifndef BRITER_STATS_HIST_BINS
+#define BRITER_STATS_HIST_BINS		16	/*!< Latency histogram bin, up to 33*/
+#endif
+/**
+ * @}
+ */
+
+/** Transaction result*/
+typedef enum {
+    BRITER_STATS_OK = 0x00, /*!< Valid response*/
+    BRITER_STATS_TX_TIMEOUT, /*!< Request not sent, UART timeout/busy or no free CAN mailbox*/
+    BRITER_STATS_RX_TIMEOUT, /*!< No response before timeout or next request*/
+    BRITER_STATS_MISMATCH, /*!< Response of other address/function, or incomplete*/
+    BRITER_STATS_CRC, /*!< Response with wrong CRC*/
+    BRITER_STATS_BUS_ERROR, /*!< Peripheral error, framing/noise/overrun*/
+    BRITER_STATS_CLASS_COUNT,
+} Briter_Stats_Class_e;
+
+typedef struct {
+    uint32_t count[BRITER_STATS_CLASS_COUNT]; /*!< Transaction per class, index by ::Briter_Stats_Class_e*/
+    uint32_t latency_hist[BRITER_STATS_HIST_BINS]; /*!< Log2 histogram of latency in tick*/
+    uint32_t latency_max; /*!< Highest latency in tick*/
+    uint32_t start; /*!< Tick of outstanding request*/
+    uint8_t pending; /*!< Request sent and not answered yet*/
+} Briter_Stats_t;
+
+/**
+* @brief  Count transaction with known latency, latency recorded only if result is OK.
+* @param  stats: pointer to stats
+* @param  result: transaction result
+* @param  latency: tick from request to response
+* @retval none
+* @note   For caller keeping its own request tick, e.g. pipelined bus where
+* 	next request may go out before response is checked
+*/
+static inline void BRITER_Stats_Record(Briter_Stats_t *stats, Briter_Stats_Class_e result, uint32_t latency) {
+    stats->count[result]++;
+    if (result != BRITER_STATS_OK)
+	return;
+    uint32_t bin = 32 - __CLZ(latency);
+    if (bin >= BRITER_STATS_HIST_BINS)
+	bin = BRITER_STATS_HIST_BINS - 1;
+    stats->latency_hist[bin]++;
+    if (latency > stats->latency_max)
+	stats->latency_max = latency;
+}
+
+/**
+* @brief  Mark request sent, previous request still pending is counted as RX timeout.
+* @param  stats: pointer to stats
+* @param  tick: current tick
+* @retval none
+*/
+static inline void BRITER_Stats_Start(Briter_Stats_t *stats, uint32_t tick) {
+    if (stats->pending)
+	stats->count[BRITER_STATS_RX_TIMEOUT]++;
+    stats->start = tick;
+    stats->pending = 1;
+}
+
+/**
+* @brief  Count valid response, latency recorded only if a request is pending.
+* @param  stats: pointer to stats
+* @param  tick: current tick
+* @retval none
+*/
+static inline void BRITER_Stats_Done(Briter_Stats_t *stats, uint32_t tick) {
+    if (!stats->pending) {
+	stats->count[BRITER_STATS_OK]++;
+	return;
+    }
+    stats->pending = 0;
+    BRITER_Stats_Record(stats, BRITER_STATS_OK, tick - stats->start);
+}
+
+/**
+* @brief  Count failed transaction.
+* @param  stats: pointer to stats
+* @param  result: failure class
+* @retval none
+*/
+static inline void BRITER_Stats_Fail(Briter_Stats_t *stats, Briter_Stats_Class_e result) {
+    stats->count[result]++;
+    stats->pending = 0;
+}
+
+#ifdef BRITER_ENCODER_STATS
+#define BRITER_STATS_START(stats, tick)		BRITER_Stats_Start((stats), (tick))
+#define BRITER_STATS_DONE(stats, tick)		BRITER_Stats_Done((stats), (tick))
+#define BRITER_STATS_FAIL(stats, result)	BRITER_Stats_Fail((stats), (result))
+#define BRITER_STATS_RECORD(stats, result, latency)	BRITER_Stats_Record((stats), (result), (latency))
+#else
+#define BRITER_STATS_START(stats, tick)		((void)0)
+#define BRITER_STATS_DONE(stats, tick)		((void)0)
+#define BRITER_STATS_FAIL(stats, result)	((void)0)
+#define BRITER_STATS_RECORD(stats, result, latency)	((void)0)
+#endif
+
+/** @defgroup Briter_Stats_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Copy stats in one critical section.
+* @param  stats: pointer to stats
+* @param  snapshot: pointer to copy
+* @retval none
+*/
+void BRITER_Stats_Snapshot(const Briter_Stats_t *stats, Briter_Stats_t *snapshot);
+
+/**
+* @brief  Clear counter and histogram, outstanding request is kept.
+* @param  stats: pointer to stats
+* @retval none
+*/
+void BRITER_Stats_Reset(Briter_Stats_t *stats);
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_STATS_H_ */
@@ -0,0 +1,12 @@
+/**
+ * @file   briter_encoder_time.c
+ * @brief  Default time base of Briter encoder drivers.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_time.h"
+#include "briter_encoder_port.h"
+
+__weak uint32_t BRITER_Encoder_GetTick(void) {
+    return HAL_GetTick();
+}
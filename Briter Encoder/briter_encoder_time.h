@@ -0,0 +1,46 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_time.h
+  * @author  Ang Chin Xian
+  * @brief   Time base shared by the Briter encoder drivers.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. By default timestamp is HAL_GetTick(), in ms
+  2. For finer resolution, define BRITER_Encoder_GetTick() in application
+      (weak symbol), e.g. return a free running us timer or DWT->CYCCNT
+  3. Tick must be free running 32 bit and wrap around at 0xFFFFFFFF,
+      compare tick with BRITER_TICK_ELAPSED() so wrap is handled
+  4. When tick is not ms, define BRITER_TICK_PER_MS in compiler option so
+      timeout given in ms are converted, e.g. -DBRITER_TICK_PER_MS=1000
+*/
+#ifndef BRITER_ENCODER_TIME_H_
+#define BRITER_ENCODER_TIME_H_
+
+#include <stdint.h>
+
+#ifndef BRITER_TICK_PER_MS
+#define BRITER_TICK_PER_MS	1	/*!< BRITER_Encoder_GetTick() per ms, 1 for HAL_GetTick()*/
+#endif
+
+/** Tick in ms, saturate at 0xFFFFFFFF*/
+#define BRITER_TICK_FROM_MS(ms)	((uint32_t) (ms) < 0xFFFFFFFFUL / BRITER_TICK_PER_MS ? (uint32_t) (ms) * BRITER_TICK_PER_MS : 0xFFFFFFFFUL)
+
+/** Ms covering tick, rounded up*/
+#define BRITER_TICK_TO_MS(tick)	((uint32_t) (tick) / BRITER_TICK_PER_MS + ((uint32_t) (tick) % BRITER_TICK_PER_MS != 0))
+
+/** Tick elapsed from start to now, wrap safe*/
+#define BRITER_TICK_ELAPSED(now, start)	((uint32_t) ((uint32_t) (now) - (uint32_t) (start)))
+
+/** True if tick has reached deadline, wrap safe*/
+#define BRITER_TICK_REACHED(now, deadline)	((int32_t) ((uint32_t) (now) - (uint32_t) (deadline)) >= 0)
+
+/**
+* @brief  Get current timestamp used by encoder drivers.
+* @retval tick value
+* @note   Weak, default to HAL_GetTick()
+*/
+uint32_t BRITER_Encoder_GetTick(void);
+
+#endif /* BRITER_ENCODER_TIME_H_ */
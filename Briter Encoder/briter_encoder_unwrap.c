@@ -0,0 +1,80 @@
+/**
+ * @file   briter_encoder_unwrap.c
+ * @brief  Source file of Briter encoder position unwrap.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_encoder_unwrap.h"
+#include "briter_encoder_crc.h"
+#include <stddef.h>
+
+HAL_StatusTypeDef BRITER_Unwrap_Init(Briter_Unwrap_t *unwrap, uint32_t modulus) {
+    if (!unwrap || modulus > 0x3FFFFFFF)
+	return HAL_ERROR;
+    unwrap->modulus = modulus;
+    unwrap->last_raw = 0;
+    unwrap->position = 0;
+    unwrap->initialized = 0;
+    return HAL_OK;
+}
+
+int64_t BRITER_Unwrap_Update(Briter_Unwrap_t *unwrap, uint32_t raw) {
+    return BRITER_Unwrap_UpdatePredicted(unwrap, raw, 0);
+}
+
+int64_t BRITER_Unwrap_UpdatePredicted(Briter_Unwrap_t *unwrap, uint32_t raw, int32_t expected) {
+    if (!unwrap->initialized) {
+	unwrap->last_raw = raw;
+	unwrap->position = raw;
+	unwrap->initialized = 1;
+	return unwrap->position;
+    }
+    int64_t delta;
+    if (unwrap->modulus == 0) {
+	//32 bit difference wraps by itself, error to expected taken the short way
+	delta = (int64_t) (int32_t) (raw - unwrap->last_raw - (uint32_t) expected) + expected;
+    }
+    else {
+	int32_t modulus = (int32_t) unwrap->modulus;
+	int32_t half = modulus / 2;
+	if (expected >= modulus)
+	    expected = modulus - 1;
+	if (expected <= -modulus)
+	    expected = -modulus + 1;
+	//Raw difference and its error to expected both stay within two modulus
+	int32_t diff = (int32_t) raw - (int32_t) unwrap->last_raw;
+	int32_t error = diff - expected;
+	int32_t wrap = (error > half) - (error < -half) + (error > half + modulus) - (error < -half - modulus);
+	delta = diff - wrap * modulus;
+    }
+    unwrap->last_raw = raw;
+    unwrap->position += delta;
+    return unwrap->position;
+}
+
+int64_t BRITER_Unwrap_GetPosition(const Briter_Unwrap_t *unwrap) {
+    return unwrap->position;
+}
+
+HAL_StatusTypeDef BRITER_Unwrap_Save(const Briter_Unwrap_t *unwrap, Briter_Unwrap_Backup_t *backup) {
+    if (!unwrap || !backup || !unwrap->initialized)
+	return HAL_ERROR;
+    int64_t offset = unwrap->position - unwrap->last_raw;
+    backup->turn = (int32_t) (unwrap->modulus ? offset / unwrap->modulus : offset >> 32);
+    backup->last_raw = unwrap->last_raw;
+    backup->modulus = unwrap->modulus;
+    backup->crc = BRITER_CRC16_Calculate((const uint8_t*) backup, offsetof(Briter_Unwrap_Backup_t, crc));
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Unwrap_Restore(Briter_Unwrap_t *unwrap, const Briter_Unwrap_Backup_t *backup) {
+    if (!unwrap || !backup || backup->modulus != unwrap->modulus
+	    || backup->crc != BRITER_CRC16_Calculate((const uint8_t*) backup, offsetof(Briter_Unwrap_Backup_t, crc)))
+	return HAL_ERROR;
+    int64_t span = unwrap->modulus ? (int64_t) unwrap->modulus : (int64_t) 1 << 32;
+    //Next value is unwrapped against saved one, motion while off is kept
+    unwrap->last_raw = backup->last_raw;
+    unwrap->position = (int64_t) backup->turn * span + backup->last_raw;
+    unwrap->initialized = 1;
+    return HAL_OK;
+}
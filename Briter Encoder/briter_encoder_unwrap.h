@@ -0,0 +1,105 @@
+/**
+  ******************************************************************************
+  * @file    briter_encoder_unwrap.h
+  * @author  Ang Chin Xian
+  * @brief   Continuous 64 bit position from wrapping Briter encoder value.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. Keep one Briter_Unwrap_t per encoder handler, initialize with
+      BRITER_Unwrap_Init()
+      - modulus : model->modulus of handler, refer to briter_encoder_model.h,
+	or 0 for raw 32 bit value
+  2. Feed every raw value to BRITER_Unwrap_Update(), it return signed 64 bit
+      continuous position
+      - Motion between two fed value must stay below half of modulus
+	(12 turn for 24 turn encoder), skipped sample are fine within that
+      - If longer gap is possible, give expected motion, e.g. from
+	briter_encoder_estimator.h, to BRITER_Unwrap_UpdatePredicted(), motion
+	then only need to be within half modulus of expected
+  3. For warm restart without homing
+      - BRITER_Unwrap_Save() before power down, keep backup in backup RAM or
+	flash
+      - BRITER_Unwrap_Restore() at start, before first update, backup is
+	checked with CRC
+      - Encoder must not move more than half modulus while off
+*/
+#ifndef BRITER_ENCODER_UNWRAP_H_
+#define BRITER_ENCODER_UNWRAP_H_
+
+#include <stdint.h>
+#include "briter_encoder_port.h"
+
+/** Unwrap handler*/
+typedef struct {
+    uint32_t modulus; /*!< Raw value wrap, 0 for full 32 bit*/
+    uint32_t last_raw; /*!< Last raw value fed*/
+    int64_t position; /*!< Continuous position of last_raw*/
+    uint8_t initialized;
+} Briter_Unwrap_t;
+
+/** Persisted unwrap state*/
+typedef struct {
+    int32_t turn; /*!< Number of modulus wrapped*/
+    uint32_t last_raw;
+    uint32_t modulus;
+    uint16_t crc; /*!< CRC-16/Modbus of field above*/
+} Briter_Unwrap_Backup_t;
+
+/** @defgroup Briter_Unwrap_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize unwrap, first value fed start at turn 0.
+* @param  unwrap: unwrap handler
+* @param  modulus: raw value wrap, 0 for full 32 bit
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Unwrap_Init(Briter_Unwrap_t *unwrap, uint32_t modulus);
+
+/**
+* @brief  Feed raw value.
+* @param  unwrap: unwrap handler
+* @param  raw: raw encoder value
+* @retval continuous position
+*/
+int64_t BRITER_Unwrap_Update(Briter_Unwrap_t *unwrap, uint32_t raw);
+
+/**
+* @brief  Feed raw value with expected motion since last value.
+* @param  unwrap: unwrap handler
+* @param  raw: raw encoder value
+* @param  expected: expected count moved since last value, clamped within modulus
+* @retval continuous position
+*/
+int64_t BRITER_Unwrap_UpdatePredicted(Briter_Unwrap_t *unwrap, uint32_t raw, int32_t expected);
+
+/**
+* @brief  Get continuous position of last value fed.
+* @param  unwrap: unwrap handler
+* @retval continuous position
+*/
+int64_t BRITER_Unwrap_GetPosition(const Briter_Unwrap_t *unwrap);
+
+/**
+* @brief  Save turn offset for warm restart.
+* @param  unwrap: unwrap handler, at least one value fed
+* @param  backup: state to persist
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Unwrap_Save(const Briter_Unwrap_t *unwrap, Briter_Unwrap_Backup_t *backup);
+
+/**
+* @brief  Restore turn offset.
+* @param  unwrap: initialized unwrap handler, same modulus as saved
+* @param  backup: persisted state
+* @retval HAL status, HAL_ERROR if backup is corrupted or from other modulus
+*/
+HAL_StatusTypeDef BRITER_Unwrap_Restore(Briter_Unwrap_t *unwrap, const Briter_Unwrap_Backup_t *backup);
+
+/**
+ * @}
+ */
+
+#endif /* BRITER_ENCODER_UNWRAP_H_ */
@@ -0,0 +1,488 @@
+/**
+ * @file   briter_host_encoder.c
+ * @brief  Virtual Briter encoder, RS485 Modbus and CAN protocol side.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_host_encoder.h"
+#include <string.h>
+
+/** Register map of encoder, kept apart from driver so both side are checked*/
+typedef enum {
+    ENCODER_REG_VALUE_HIGH = 0x00,
+    ENCODER_REG_VALUE_LOW = 0x01,
+    ENCODER_REG_TURN = 0x02,
+    ENCODER_REG_SINGLE_TURN = 0x03,
+    ENCODER_REG_ADDRESS = 0x04,
+    ENCODER_REG_BAUDRATE = 0x05,
+    ENCODER_REG_MODE = 0x06,
+    ENCODER_REG_RETURN_TIME = 0x07,
+    ENCODER_REG_RESET_ZERO = 0x08,
+    ENCODER_REG_DIRECTION = 0x09,
+    ENCODER_REG_POSITION_HIGH = 0x0B,
+    ENCODER_REG_POSITION_LOW = 0x0C,
+    ENCODER_REG_MIDPOINT = 0x0E,
+    ENCODER_REG_MUL_5 = 0x0F,
+} Encoder_Register_e;
+
+/** Modbus function of encoder*/
+typedef enum {
+    ENCODER_FUNC_READ = 0x03,
+    ENCODER_FUNC_WRITE_SINGLE = 0x06,
+    ENCODER_FUNC_WRITE_MULTI = 0x10,
+} Encoder_Func_e;
+
+/** CAN command of encoder*/
+typedef enum {
+    ENCODER_CAN_GET_VALUE = 0x01,
+    ENCODER_CAN_SET_ID,
+    ENCODER_CAN_SET_BAUDRATE,
+    ENCODER_CAN_SET_MODE,
+    ENCODER_CAN_SET_RETURN_TIME,
+    ENCODER_CAN_SET_ZERO,
+} Encoder_CAN_Command_e;
+
+static const uint32_t encoder_rs485_bps[] = { 9600, 19200, 38400, 57600, 115200 };
+static const uint32_t encoder_can_bps[] = { 500000, 1000000, 250000, 125000, 100000 };
+
+/** @defgroup briter_host_encoder Private Functions
+ * @{
+ */
+static void Encoder_RS485_Listener(void *context, UART_HandleTypeDef *huart, const uint8_t *frame, uint16_t size);
+static void Encoder_CAN_Listener(void *context, CAN_HandleTypeDef *hcan, const CAN_TxHeaderTypeDef *header, const uint8_t *data);
+static void Encoder_RS485_Send(Briter_Host_Encoder_t *encoder, uint8_t *frame, uint16_t size, uint32_t delay_us);
+static void Encoder_CAN_Send(Briter_Host_Encoder_t *encoder, uint32_t delay_us);
+static uint16_t Encoder_RS485_Read(const Briter_Host_Encoder_t *encoder, uint8_t reg);
+static void Encoder_RS485_Write(Briter_Host_Encoder_t *encoder, uint8_t reg, uint16_t value);
+static void Encoder_Push(void *context);
+static void Encoder_Push_Arm(Briter_Host_Encoder_t *encoder);
+static void Encoder_SetValue(Briter_Host_Encoder_t *encoder, uint32_t value);
+static int64_t Encoder_Raw(const Briter_Host_Encoder_t *encoder);
+static uint32_t Encoder_Delay_us(Briter_Host_Encoder_t *encoder);
+static uint8_t Encoder_Chance(Briter_Host_Encoder_t *encoder, uint32_t ppm);
+static uint16_t Encoder_CRC16(const uint8_t *data, uint16_t size);
+/**
+ * @}
+ */
+
+HAL_StatusTypeDef BRITER_Host_Encoder_Init(Briter_Host_Encoder_t *encoder, uint8_t address) {
+    if (encoder == NULL)
+	return HAL_ERROR;
+    memset(encoder, 0, sizeof(Briter_Host_Encoder_t));
+    encoder->address = address;
+    encoder->ppr = 4096;
+    encoder->turns = 24;
+    encoder->return_time = BRITER_HOST_ENCODER_RETURN_TIME;
+    encoder->latency_us = BRITER_HOST_ENCODER_LATENCY_US;
+    encoder->seed = 1U + address;
+    encoder->origin_ns = BRITER_Host_Time_ns();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_Encoder_Attach_RS485(Briter_Host_Encoder_t *encoder, UART_HandleTypeDef *huart) {
+    if (encoder == NULL || BRITER_Host_UART_Attach(huart, Encoder_RS485_Listener, encoder) != HAL_OK)
+	return HAL_ERROR;
+    encoder->huart = huart;
+    encoder->bps = BRITER_Host_UART_GetBaudrate(huart);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_Encoder_Attach_CAN(Briter_Host_Encoder_t *encoder, CAN_HandleTypeDef *hcan) {
+    if (encoder == NULL || BRITER_Host_CAN_Attach(hcan, Encoder_CAN_Listener, encoder) != HAL_OK)
+	return HAL_ERROR;
+    encoder->hcan = hcan;
+    encoder->bps = BRITER_Host_CAN_GetBaudrate(hcan);
+    return HAL_OK;
+}
+
+void BRITER_Host_Encoder_SetMotion(Briter_Host_Encoder_t *encoder, uint32_t value, int32_t velocity) {
+    encoder->origin = 0;
+    encoder->origin_ns = BRITER_Host_Time_ns();
+    //Raw count is shaft motion, direction decide how value follow it
+    encoder->velocity = encoder->direction ? -velocity : velocity;
+    Encoder_SetValue(encoder, value);
+}
+
+uint32_t BRITER_Host_Encoder_GetValue(const Briter_Host_Encoder_t *encoder) {
+    int64_t modulus = (int64_t) encoder->ppr * encoder->turns;
+    int64_t raw = Encoder_Raw(encoder);
+    int64_t value = (encoder->direction ? -raw : raw) + encoder->offset;
+    value %= modulus;
+    if (value < 0)
+	value += modulus;
+    return (uint32_t) value;
+}
+
+/**
+ * @brief  Request frame on RS485 line, answer it as Modbus slave.
+ * @param  context pointer to virtual encoder
+ * @param  huart uart handler of line
+ * @param  frame request frame
+ * @param  size size of frame
+ * @retval none
+ */
+static void Encoder_RS485_Listener(void *context, UART_HandleTypeDef *huart, const uint8_t *frame, uint16_t size) {
+    Briter_Host_Encoder_t *encoder = (Briter_Host_Encoder_t*) context;
+    //Frame at other rate is only garbage to encoder
+    if (encoder->bps != BRITER_Host_UART_GetBaudrate(huart) || size < 4 || Encoder_CRC16(frame, (uint16_t) (size - 2)) != (uint16_t) (frame[size - 2] | frame[size - 1] << 8)) {
+	encoder->stats.ignored++;
+	return;
+    }
+    uint8_t broadcast = (frame[0] == 0);
+    if (frame[0] != encoder->address && !broadcast)
+	return;
+    encoder->stats.request++;
+    if (Encoder_Chance(encoder, encoder->drop_ppm)) {
+	encoder->stats.dropped++;
+	return;
+    }
+    uint8_t reply[5 + 2 * BRITER_HOST_ENCODER_REGISTER + 2];
+    uint16_t reg = (uint16_t) (frame[2] << 8 | frame[3]);
+    uint16_t count = (uint16_t) (frame[4] << 8 | frame[5]);
+    uint32_t delay_us = Encoder_Delay_us(encoder);
+    reply[0] = encoder->address;
+    reply[1] = frame[1];
+    switch (frame[1]) {
+    case ENCODER_FUNC_READ:
+	if (size != 8 || broadcast) {
+	    encoder->stats.ignored++;
+	    return;
+	}
+	if (count == 0 || reg + count > BRITER_HOST_ENCODER_REGISTER) {
+	    //Illegal data address
+	    reply[1] |= 0x80;
+	    reply[2] = 0x02;
+	    Encoder_RS485_Send(encoder, reply, 3, delay_us);
+	    return;
+	}
+	//Value is latched when request end
+	reply[2] = (uint8_t) (2 * count);
+	for (uint16_t i = 0; i < count; i++) {
+	    uint16_t value = Encoder_RS485_Read(encoder, (uint8_t) (reg + i));
+	    reply[3 + 2 * i] = (uint8_t) (value >> 8);
+	    reply[4 + 2 * i] = (uint8_t) value;
+	}
+	Encoder_RS485_Send(encoder, reply, (uint16_t) (3 + 2 * count), delay_us);
+	return;
+    case ENCODER_FUNC_WRITE_SINGLE:
+	if (size != 8 || reg >= BRITER_HOST_ENCODER_REGISTER) {
+	    encoder->stats.ignored++;
+	    return;
+	}
+	//Echo leave at old address and rate, then setting apply
+	memcpy(&reply[2], &frame[2], 4);
+	if (!broadcast)
+	    Encoder_RS485_Send(encoder, reply, 6, delay_us);
+	Encoder_RS485_Write(encoder, (uint8_t) reg, count);
+	return;
+    case ENCODER_FUNC_WRITE_MULTI:
+	if (size != 9 + 2 * count || frame[6] != 2 * count || reg + count > BRITER_HOST_ENCODER_REGISTER) {
+	    encoder->stats.ignored++;
+	    return;
+	}
+	memcpy(&reply[2], &frame[2], 4);
+	if (!broadcast)
+	    Encoder_RS485_Send(encoder, reply, 6, delay_us);
+	for (uint16_t i = 0; i < count; i++)
+	    Encoder_RS485_Write(encoder, (uint8_t) (reg + i), (uint16_t) (frame[7 + 2 * i] << 8 | frame[8 + 2 * i]));
+	return;
+    default:
+	//Illegal function
+	if (broadcast)
+	    return;
+	reply[1] |= 0x80;
+	reply[2] = 0x01;
+	Encoder_RS485_Send(encoder, reply, 3, delay_us);
+	return;
+    }
+}
+
+/**
+ * @brief  Frame on CAN bus, answer read and apply setting.
+ * @param  context pointer to virtual encoder
+ * @param  hcan can handler of bus
+ * @param  header frame header
+ * @param  data frame data
+ * @retval none
+ */
+static void Encoder_CAN_Listener(void *context, CAN_HandleTypeDef *hcan, const CAN_TxHeaderTypeDef *header, const uint8_t *data) {
+    Briter_Host_Encoder_t *encoder = (Briter_Host_Encoder_t*) context;
+    if (header->StdId != encoder->address)
+	return;
+    if (encoder->bps != BRITER_Host_CAN_GetBaudrate(hcan) || header->DLC < 4 || data[0] != header->DLC || data[1] != encoder->address) {
+	encoder->stats.ignored++;
+	return;
+    }
+    encoder->stats.request++;
+    if (Encoder_Chance(encoder, encoder->drop_ppm)) {
+	encoder->stats.dropped++;
+	return;
+    }
+    switch (data[2]) {
+    case ENCODER_CAN_GET_VALUE:
+	Encoder_CAN_Send(encoder, Encoder_Delay_us(encoder));
+	break;
+    case ENCODER_CAN_SET_ID:
+	encoder->address = data[3];
+	break;
+    case ENCODER_CAN_SET_BAUDRATE:
+	if (data[3] < sizeof(encoder_can_bps) / sizeof(encoder_can_bps[0]))
+	    encoder->bps = encoder_can_bps[data[3]];
+	break;
+    case ENCODER_CAN_SET_MODE:
+	encoder->mode = data[3];
+	Encoder_Push_Arm(encoder);
+	break;
+    case ENCODER_CAN_SET_RETURN_TIME:
+	if (header->DLC >= 5)
+	    encoder->return_time = (uint16_t) (data[3] | data[4] << 8);
+	break;
+    case ENCODER_CAN_SET_ZERO:
+	Encoder_SetValue(encoder, 0);
+	break;
+    default:
+	encoder->stats.ignored++;
+	break;
+    }
+}
+
+/**
+ * @brief  Append CRC, inject error and put reply on the line.
+ * @param  encoder virtual encoder
+ * @param  frame reply without CRC, 2 byte spare at end
+ * @param  size size of reply without CRC
+ * @param  delay_us time from now to first start bit
+ * @retval none
+ */
+static void Encoder_RS485_Send(Briter_Host_Encoder_t *encoder, uint8_t *frame, uint16_t size, uint32_t delay_us) {
+    uint8_t flag[5 + 2 * BRITER_HOST_ENCODER_REGISTER + 2];
+    uint16_t crc = Encoder_CRC16(frame, size);
+    frame[size++] = (uint8_t) crc;
+    frame[size++] = (uint8_t) (crc >> 8);
+    uint8_t corrupted = 0;
+    if (Encoder_Chance(encoder, encoder->crc_ppm)) {
+	frame[size - 1] ^= 0xA5;
+	corrupted = 1;
+    }
+    for (uint16_t i = 0; i < size; i++) {
+	flag[i] = 0;
+	if (Encoder_Chance(encoder, encoder->noise_ppm)) {
+	    frame[i] ^= (uint8_t) (1U << (BRITER_Host_Random(&encoder->seed) % 8));
+	    corrupted = 1;
+	}
+	if (Encoder_Chance(encoder, encoder->framing_ppm)) {
+	    //Byte with bad stop bit is garbage as well
+	    frame[i] = (uint8_t) ~frame[i];
+	    flag[i] = BRITER_HOST_BYTE_FRAMING;
+	    corrupted = 1;
+	}
+    }
+    encoder->stats.corrupted += corrupted;
+    encoder->stats.reply++;
+    BRITER_Host_UART_Reply(encoder->huart, delay_us, frame, flag, size);
+}
+
+/**
+ * @brief  Put value frame on CAN bus, bus error cost resend.
+ * @param  encoder virtual encoder
+ * @param  delay_us time from now until frame is ready for arbitration
+ * @retval none
+ */
+static void Encoder_CAN_Send(Briter_Host_Encoder_t *encoder, uint32_t delay_us) {
+    uint32_t value = BRITER_Host_Encoder_GetValue(encoder);
+    uint8_t data[7] = { 0x07, encoder->address, ENCODER_CAN_GET_VALUE, (uint8_t) value, (uint8_t) (value >> 8), (uint8_t) (value >> 16), (uint8_t) (value >> 24) };
+    uint8_t error_count = Encoder_Chance(encoder, encoder->crc_ppm);
+    for (uint8_t i = 0; i < sizeof(data); i++)
+	error_count = (uint8_t) (error_count + Encoder_Chance(encoder, encoder->noise_ppm));
+    encoder->stats.corrupted += (error_count != 0);
+    encoder->stats.reply++;
+    BRITER_Host_CAN_Reply(encoder->hcan, delay_us, encoder->address, data, sizeof(data), error_count);
+}
+
+/**
+ * @brief  Register value as read by Modbus master.
+ * @param  encoder virtual encoder
+ * @param  reg register address
+ * @retval register value
+ */
+static uint16_t Encoder_RS485_Read(const Briter_Host_Encoder_t *encoder, uint8_t reg) {
+    uint32_t value = BRITER_Host_Encoder_GetValue(encoder);
+    switch (reg) {
+    case ENCODER_REG_VALUE_HIGH:
+	return (uint16_t) (value >> 16);
+    case ENCODER_REG_VALUE_LOW:
+	return (uint16_t) value;
+    case ENCODER_REG_TURN:
+	return (uint16_t) (value / encoder->ppr);
+    case ENCODER_REG_SINGLE_TURN:
+	return (uint16_t) (value % encoder->ppr);
+    case ENCODER_REG_ADDRESS:
+	return encoder->address;
+    case ENCODER_REG_BAUDRATE:
+	for (uint16_t i = 0; i < sizeof(encoder_rs485_bps) / sizeof(encoder_rs485_bps[0]); i++) {
+	    if (encoder_rs485_bps[i] == encoder->bps)
+		return i;
+	}
+	return 0;
+    case ENCODER_REG_MODE:
+	return encoder->mode;
+    case ENCODER_REG_RETURN_TIME:
+	return encoder->return_time;
+    case ENCODER_REG_DIRECTION:
+	return encoder->direction;
+    default:
+	return 0;
+    }
+}
+
+/**
+ * @brief  Apply register written by Modbus master.
+ * @param  encoder virtual encoder
+ * @param  reg register address
+ * @param  value register value
+ * @retval none
+ */
+static void Encoder_RS485_Write(Briter_Host_Encoder_t *encoder, uint8_t reg, uint16_t value) {
+    uint32_t modulus = encoder->ppr * encoder->turns;
+    switch (reg) {
+    case ENCODER_REG_ADDRESS:
+	if (value >= 1 && value <= 247)
+	    encoder->address = (uint8_t) value;
+	break;
+    case ENCODER_REG_BAUDRATE:
+	if (value < sizeof(encoder_rs485_bps) / sizeof(encoder_rs485_bps[0]))
+	    encoder->bps = encoder_rs485_bps[value];
+	break;
+    case ENCODER_REG_MODE:
+	encoder->mode = (uint8_t) value;
+	Encoder_Push_Arm(encoder);
+	break;
+    case ENCODER_REG_RETURN_TIME:
+	encoder->return_time = value;
+	break;
+    case ENCODER_REG_RESET_ZERO:
+	if (value)
+	    Encoder_SetValue(encoder, 0);
+	break;
+    case ENCODER_REG_DIRECTION: {
+	//Value stay where it is, motion from now count the other way
+	uint32_t now = BRITER_Host_Encoder_GetValue(encoder);
+	encoder->direction = (value != 0);
+	Encoder_SetValue(encoder, now);
+	break;
+    }
+    case ENCODER_REG_POSITION_HIGH:
+	encoder->position_high = value;
+	break;
+    case ENCODER_REG_POSITION_LOW:
+	Encoder_SetValue(encoder, ((uint32_t) encoder->position_high << 16 | value) % modulus);
+	break;
+    case ENCODER_REG_MIDPOINT:
+	if (value)
+	    Encoder_SetValue(encoder, modulus / 2);
+	break;
+    case ENCODER_REG_MUL_5:
+	if (value)
+	    Encoder_SetValue(encoder, 5 * encoder->ppr + BRITER_Host_Encoder_GetValue(encoder) % encoder->ppr);
+	break;
+    default:
+	break;
+    }
+}
+
+/**
+ * @brief  Push timer, send value and arm next push while in push mode.
+ * @param  context pointer to virtual encoder
+ * @retval none
+ */
+static void Encoder_Push(void *context) {
+    Briter_Host_Encoder_t *encoder = (Briter_Host_Encoder_t*) context;
+    encoder->push_armed = 0;
+    if (encoder->mode == 0)
+	return;
+    encoder->stats.push++;
+    if (encoder->huart != NULL) {
+	uint32_t value = BRITER_Host_Encoder_GetValue(encoder);
+	uint8_t frame[9] = { encoder->address, ENCODER_FUNC_READ, 4, (uint8_t) (value >> 24), (uint8_t) (value >> 16), (uint8_t) (value >> 8), (uint8_t) value };
+	Encoder_RS485_Send(encoder, frame, 7, 0);
+    }
+    if (encoder->hcan != NULL)
+	Encoder_CAN_Send(encoder, 0);
+    Encoder_Push_Arm(encoder);
+}
+
+/**
+ * @brief  Start push timer if in push mode and not running yet.
+ * @param  encoder virtual encoder
+ * @retval none
+ */
+static void Encoder_Push_Arm(Briter_Host_Encoder_t *encoder) {
+    if (encoder->mode == 0 || encoder->push_armed)
+	return;
+    uint32_t period_ms = encoder->return_time ? encoder->return_time : 1;
+    if (BRITER_Host_Schedule(period_ms * 1000U, Encoder_Push, encoder) == HAL_OK)
+	encoder->push_armed = 1;
+}
+
+/**
+ * @brief  Move offset so value is the given one now.
+ * @param  encoder virtual encoder
+ * @param  value wanted value
+ * @retval none
+ */
+static void Encoder_SetValue(Briter_Host_Encoder_t *encoder, uint32_t value) {
+    int64_t raw = Encoder_Raw(encoder);
+    encoder->offset = (int64_t) value - (encoder->direction ? -raw : raw);
+}
+
+/**
+ * @brief  Shaft count now from origin and speed.
+ * @param  encoder virtual encoder
+ * @retval raw count, not wrapped
+ */
+static int64_t Encoder_Raw(const Briter_Host_Encoder_t *encoder) {
+    int64_t elapsed_us = (int64_t) ((BRITER_Host_Time_ns() - encoder->origin_ns) / 1000ULL);
+    return encoder->origin + (int64_t) encoder->velocity * elapsed_us / 1000000LL;
+}
+
+/**
+ * @brief  Reply delay after request end, RS485 keep t3.5 silence first.
+ * @param  encoder virtual encoder
+ * @retval delay in us
+ */
+static uint32_t Encoder_Delay_us(Briter_Host_Encoder_t *encoder) {
+    uint32_t delay_us = encoder->latency_us;
+    if (encoder->jitter_us)
+	delay_us += BRITER_Host_Random(&encoder->seed) % encoder->jitter_us;
+    if (encoder->huart != NULL)
+	delay_us += (encoder->bps > 19200) ? 1750 : (35000000UL + encoder->bps - 1) / encoder->bps;
+    return delay_us;
+}
+
+/**
+ * @brief  Draw from seed of encoder.
+ * @param  encoder virtual encoder
+ * @param  ppm chance in part per million
+ * @retval 1 if hit
+ */
+static uint8_t Encoder_Chance(Briter_Host_Encoder_t *encoder, uint32_t ppm) {
+    if (ppm == 0)
+	return 0;
+    return (BRITER_Host_Random(&encoder->seed) % 1000000UL) < ppm;
+}
+
+/**
+ * @brief  CRC-16/Modbus bit by bit, independent from driver table.
+ * @param  data frame
+ * @param  size number of byte
+ * @retval CRC, low byte is sent first
+ */
+static uint16_t Encoder_CRC16(const uint8_t *data, uint16_t size) {
+    uint16_t crc = 0xFFFF;
+    for (uint16_t i = 0; i < size; i++) {
+	crc ^= data[i];
+	for (uint8_t bit = 0; bit < 8; bit++)
+	    crc = (crc & 1) ? (uint16_t) ((crc >> 1) ^ 0xA001) : (uint16_t) (crc >> 1);
+    }
+    return crc;
+}
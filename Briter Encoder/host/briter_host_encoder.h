@@ -0,0 +1,139 @@
+/**
+  ******************************************************************************
+  * @file    briter_host_encoder.h
+  * @author  Ang Chin Xian
+  * @brief   Virtual Briter encoder answering on host UART line or CAN bus of
+  *          briter_host_hal.h, with configurable latency and error injection.
+  *
+  ==============================================================================
+                        ##### How to use this module #####
+  ==============================================================================
+  1. BRITER_Host_Encoder_Init() with address, encoder is 4096 x 24 turn, at
+      rest on value 0, answer in query mode
+  2. Put it on the line with BRITER_Host_Encoder_Attach_RS485() or on the bus
+      with BRITER_Host_Encoder_Attach_CAN(), it take the line rate as its own
+  3. Motion, BRITER_Host_Encoder_SetMotion() give value now and speed in
+      count per second, value is sampled when request end
+  4. Timing, set after init
+      - RS485 reply start t3.5 + latency_us + [0, jitter_us) after request end
+      - CAN reply wait latency_us + [0, jitter_us) then bus arbitration
+  5. Error injection, chance in ppm, drawn from seed so run is repeatable
+      - drop_ppm : request not answered
+      - crc_ppm : RS485 reply with wrong CRC, CAN reply hit by bus error and
+	sent again by hardware
+      - noise_ppm : RS485 reply byte with one flipped bit, CAN reply hit by
+	bus error
+      - framing_ppm : RS485 reply byte raise framing error
+  6. Register and command follow the driver, RS485
+      - Read holding register 0x00 to 0x0F, write single and write multi
+      - Address and baudrate change after the echo, encoder at other rate than
+	the line ignore every frame
+      - Mode 1 push value every return time, as read response of 2 register
+      - Unknown function answer Modbus exception 01
+  7. CAN, GET_VALUE answer [0x07, addr, 0x01, value little endian], setting
+      is not answered, auto mode push value every return time
+  8. Count of request, reply and injected error in ::Briter_Host_Encoder_Stats_t
+*/
+#ifndef BRITER_HOST_ENCODER_H_
+#define BRITER_HOST_ENCODER_H_
+
+#include "briter_host_hal.h"
+
+/** @defgroup BRITER_HOST_ENCODER_Exported_Constants
+ * @{
+ */
+#define BRITER_HOST_ENCODER_REGISTER	0x10	/*!< Register 0x00 to 0x0F*/
+#define BRITER_HOST_ENCODER_RETURN_TIME	50	/*!< Default push period in ms*/
+#define BRITER_HOST_ENCODER_LATENCY_US	250	/*!< Default processing time*/
+/**
+ * @}
+ */
+
+/** Count of virtual encoder*/
+typedef struct {
+    uint32_t request; /*!< Frame addressed to encoder*/
+    uint32_t reply; /*!< Frame sent, push included*/
+    uint32_t push; /*!< Value pushed in backhaul or auto mode*/
+    uint32_t ignored; /*!< Frame with bad CRC, other rate or bad length*/
+    uint32_t dropped; /*!< Request not answered by drop_ppm*/
+    uint32_t corrupted; /*!< Reply hit by crc_ppm, noise_ppm or framing_ppm*/
+} Briter_Host_Encoder_Stats_t;
+
+/** Virtual encoder*/
+typedef struct {
+    //Timing and error injection, set after init
+    uint32_t latency_us;
+    uint32_t jitter_us;
+    uint32_t drop_ppm;
+    uint32_t crc_ppm;
+    uint32_t noise_ppm;
+    uint32_t framing_ppm;
+    uint32_t seed;
+    //Encoder
+    uint8_t address;
+    uint32_t ppr;
+    uint32_t turns;
+    uint32_t bps; /*!< Rate encoder listen at*/
+    uint8_t mode; /*!< 0 query, 1 push*/
+    uint16_t return_time; /*!< Push period in ms*/
+    uint8_t direction; /*!< 1 count down on positive motion*/
+    uint16_t position_high; /*!< Set position high word until low word is written*/
+    //Motion
+    int64_t origin; /*!< Raw count at origin_ns*/
+    int32_t velocity; /*!< Raw count per second*/
+    uint64_t origin_ns;
+    int64_t offset; /*!< Value minus raw, zero and set position*/
+    //Line
+    UART_HandleTypeDef *huart;
+    CAN_HandleTypeDef *hcan;
+    uint8_t push_armed;
+    Briter_Host_Encoder_Stats_t stats;
+} Briter_Host_Encoder_t;
+
+/** @defgroup Briter_Host_Encoder_Exported_Functions
+ * @{
+ */
+/**
+* @brief  Initialize virtual encoder at rest on value 0.
+* @param  encoder: virtual encoder
+* @param  address: RS485 or CAN address
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Host_Encoder_Init(Briter_Host_Encoder_t *encoder, uint8_t address);
+
+/**
+* @brief  Put encoder on host UART line, it listen at line rate.
+* @param  encoder: virtual encoder
+* @param  huart: uart handler already passed to BRITER_Host_UART_Init()
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Host_Encoder_Attach_RS485(Briter_Host_Encoder_t *encoder, UART_HandleTypeDef *huart);
+
+/**
+* @brief  Put encoder on host CAN bus, it listen at bus rate.
+* @param  encoder: virtual encoder
+* @param  hcan: can handler already passed to BRITER_Host_CAN_Init()
+* @retval HAL status
+*/
+HAL_StatusTypeDef BRITER_Host_Encoder_Attach_CAN(Briter_Host_Encoder_t *encoder, CAN_HandleTypeDef *hcan);
+
+/**
+* @brief  Set value now and constant speed from now.
+* @param  encoder: virtual encoder
+* @param  value: encoder value now, before wrap
+* @param  velocity: value count per second, sign as seen by MCU
+* @retval none
+*/
+void BRITER_Host_Encoder_SetMotion(Briter_Host_Encoder_t *encoder, uint32_t value, int32_t velocity);
+
+/**
+* @brief  Value encoder would answer now.
+* @param  encoder: virtual encoder
+* @retval value, 0 to ppr * turns - 1
+*/
+uint32_t BRITER_Host_Encoder_GetValue(const Briter_Host_Encoder_t *encoder);
+/**
+ * @}
+ */
+
+#endif /* BRITER_HOST_ENCODER_H_ */
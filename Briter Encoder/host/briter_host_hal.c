@@ -0,0 +1,1016 @@
+/**
+ * @file   briter_host_hal.c
+ * @brief  Virtual time, UART/DMA line and CAN bus model behind the host HAL.
+ * @author Ang Chin Xian
+ */
+
+#include "briter_host_hal.h"
+#include <string.h>
+#include <time.h>
+
+/** Event kind*/
+typedef enum {
+    HOST_EVENT_TIMER = 0x00,
+    HOST_EVENT_UART_TX_END, /*!< Last stop bit of MCU frame left the pin*/
+    HOST_EVENT_UART_TX_CPLT, /*!< TX complete interrupt, late by irq latency*/
+    HOST_EVENT_UART_RX_BYTE, /*!< Device byte received, arg byte | flag << 8*/
+    HOST_EVENT_UART_IDLE, /*!< One byte time of silence, arg receive sequence*/
+    HOST_EVENT_CAN_ARBITRATE, /*!< Bus may be free, start next frame*/
+    HOST_EVENT_CAN_DONE, /*!< Frame on bus reached end of frame*/
+} Host_Event_e;
+
+typedef struct {
+    uint64_t time; /*!< ns*/
+    uint64_t order; /*!< Keep insertion order of event due at same time*/
+    Host_Event_e type;
+    void *object;
+    uint32_t arg;
+    Briter_Host_Callback callback;
+} Host_Event_t;
+
+/** Reception mode of UART*/
+typedef enum {
+    HOST_RX_NONE = 0x00,
+    HOST_RX_BLOCKING,
+    HOST_RX_IDLE_DMA,
+} Host_RX_Mode_e;
+
+typedef struct {
+    Briter_Host_UART_Listener listener;
+    Briter_Host_CAN_Listener can_listener;
+    void *context;
+} Host_Node_t;
+
+typedef struct {
+    UART_HandleTypeDef *huart;
+    uint32_t bps;
+    uint64_t byte_ns;
+    uint64_t tx_cplt_ns; /*!< TX complete interrupt latency*/
+    //Transmit
+    uint8_t tx_busy;
+    uint8_t tx_dma;
+    uint32_t tx_generation; /*!< Cancel event of aborted transmission*/
+    uint8_t tx_frame[BRITER_HOST_UART_FRAME_MAX];
+    uint16_t tx_size;
+    //Receive
+    Host_RX_Mode_e rx_mode;
+    uint8_t rx_circular;
+    uint8_t *rx_buf;
+    uint16_t rx_size;
+    uint16_t rx_pos;
+    uint32_t rx_sequence; /*!< Bumped on every stored byte and every arm, match idle event*/
+    uint8_t rdr_full; /*!< Byte held in data register while reception is not armed*/
+    uint8_t rdr;
+    //Device side of line
+    uint64_t line_free_ns;
+    Host_Node_t node[BRITER_HOST_NODE_MAX];
+    uint8_t node_count;
+    Briter_Host_Line_Stats_t stats;
+} Host_UART_t;
+
+typedef struct {
+    uint8_t used;
+    uint32_t std_id;
+    uint8_t dlc;
+    uint8_t data[8];
+    uint8_t error_count; /*!< Bus error before frame get through*/
+    uint64_t ready_ns;
+} Host_CAN_Frame_t;
+
+typedef struct {
+    CAN_HandleTypeDef *hcan;
+    uint32_t bps;
+    uint32_t it; /*!< Active notification*/
+    Host_CAN_Frame_t mailbox[3];
+    uint16_t mailbox_time[3]; /*!< Timer at start of frame, HAL_CAN_GetTxTimestamp()*/
+    Host_CAN_Frame_t device[BRITER_HOST_EVENT_MAX / 16]; /*!< Frame waiting from device*/
+    int8_t on_bus; /*!< Mailbox 0 to 2, device frame from 3, -1 if bus idle*/
+    uint64_t on_bus_start;
+    CAN_FilterTypeDef filter[28];
+    CAN_RxHeaderTypeDef fifo_header[2][BRITER_HOST_CAN_FIFO_SIZE];
+    uint8_t fifo_data[2][BRITER_HOST_CAN_FIFO_SIZE][8];
+    uint8_t fifo_head[2];
+    uint8_t fifo_count[2];
+    Host_Node_t node[BRITER_HOST_NODE_MAX];
+    uint8_t node_count;
+    Briter_Host_Line_Stats_t stats;
+} Host_CAN_t;
+
+uint32_t briter_host_primask;
+CoreDebug_Type briter_host_core_debug;
+uint32_t SystemCoreClock = 1000000000UL;
+
+static DWT_Type host_dwt;
+static uint64_t host_now;
+static uint64_t host_order;
+static Host_Event_t host_event[BRITER_HOST_EVENT_MAX];
+static uint32_t host_event_count;
+static Host_UART_t host_uart[BRITER_HOST_UART_MAX];
+static Host_CAN_t host_can[BRITER_HOST_CAN_MAX];
+
+/** @defgroup briter_host_hal Private Functions
+ * @{
+ */
+static HAL_StatusTypeDef Host_Post(uint64_t time, Host_Event_e type, void *object, uint32_t arg, Briter_Host_Callback callback);
+static uint8_t Host_Step(uint64_t limit);
+static void Host_Dispatch(const Host_Event_t *event);
+static Host_UART_t* Host_UART_Find(const UART_HandleTypeDef *huart);
+static void Host_UART_TxStart(Host_UART_t *uart, const uint8_t *data, uint16_t size, uint8_t dma);
+static void Host_UART_TxEnd(Host_UART_t *uart, uint32_t generation);
+static void Host_UART_RxByte(Host_UART_t *uart, uint8_t byte, uint8_t flag);
+static void Host_UART_Idle(Host_UART_t *uart, uint32_t sequence);
+static void Host_UART_Fail(Host_UART_t *uart, uint32_t error);
+static Host_CAN_t* Host_CAN_Find(const CAN_HandleTypeDef *hcan);
+static Host_CAN_Frame_t* Host_CAN_Slot(Host_CAN_t *can, int8_t index);
+static void Host_CAN_Arbitrate(Host_CAN_t *can);
+static void Host_CAN_Done(Host_CAN_t *can);
+static void Host_CAN_Receive(Host_CAN_t *can, const Host_CAN_Frame_t *frame, uint16_t timestamp);
+static int8_t Host_CAN_Match(const CAN_FilterTypeDef *filter, uint32_t std_id, uint32_t *index);
+static uint16_t Host_CAN_Timer(const Host_CAN_t *can, uint64_t time);
+/**
+ * @}
+ */
+
+DWT_Type* BRITER_Host_DWT(void) {
+    static uint64_t base;
+    static uint32_t last;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    uint64_t ns = (uint64_t) ts.tv_sec * 1000000000ULL + (uint64_t) ts.tv_nsec;
+    //Counter written since last access, or stopped, count on from its value
+    if (!(host_dwt.CTRL & DWT_CTRL_CYCCNTENA_Msk) || host_dwt.CYCCNT != last)
+	base = ns - host_dwt.CYCCNT;
+    else
+	host_dwt.CYCCNT = (uint32_t) (ns - base);
+    last = host_dwt.CYCCNT;
+    return &host_dwt;
+}
+
+uint32_t HAL_GetTick(void) {
+    return (uint32_t) (host_now / 1000000ULL);
+}
+
+void HAL_Delay(uint32_t Delay) {
+    uint64_t until = host_now + (uint64_t) Delay * 1000000ULL;
+    while (Host_Step(until))
+	;
+}
+
+void BRITER_Host_Reset(void) {
+    host_now = 0;
+    host_order = 0;
+    host_event_count = 0;
+    briter_host_primask = 0;
+    memset(host_uart, 0, sizeof(host_uart));
+    memset(host_can, 0, sizeof(host_can));
+}
+
+uint64_t BRITER_Host_Time_ns(void) {
+    return host_now;
+}
+
+uint64_t BRITER_Host_Time_us(void) {
+    return host_now / 1000ULL;
+}
+
+void BRITER_Host_Run(uint32_t us) {
+    uint64_t until = host_now + (uint64_t) us * 1000ULL;
+    while (Host_Step(until))
+	;
+}
+
+uint8_t BRITER_Host_RunUntil(volatile const uint8_t *flag, uint32_t timeout_us) {
+    uint64_t until = host_now + (uint64_t) timeout_us * 1000ULL;
+    while (!*flag && Host_Step(until))
+	;
+    return *flag;
+}
+
+uint32_t BRITER_Host_Pending(void) {
+    return host_event_count;
+}
+
+HAL_StatusTypeDef BRITER_Host_Schedule(uint32_t delay_us, Briter_Host_Callback callback, void *context) {
+    if (callback == NULL)
+	return HAL_ERROR;
+    return Host_Post(host_now + (uint64_t) delay_us * 1000ULL, HOST_EVENT_TIMER, context, 0, callback);
+}
+
+uint32_t BRITER_Host_Random(uint32_t *seed) {
+    //xorshift32, seed 0 would stay 0
+    uint32_t x = *seed ? *seed : 0x9E3779B9UL;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *seed = x;
+    return x;
+}
+
+HAL_StatusTypeDef BRITER_Host_UART_Init(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdmatx, DMA_HandleTypeDef *hdmarx, uint32_t bps) {
+    if (huart == NULL || bps == 0)
+	return HAL_ERROR;
+    Host_UART_t *uart = Host_UART_Find(huart);
+    for (uint8_t i = 0; uart == NULL && i < BRITER_HOST_UART_MAX; i++) {
+	if (host_uart[i].huart == NULL)
+	    uart = &host_uart[i];
+    }
+    if (uart == NULL)
+	return HAL_ERROR;
+    memset(uart, 0, sizeof(Host_UART_t));
+    uart->huart = huart;
+    uart->stats.tx_gap_min_ns = UINT64_MAX;
+    huart->Init.BaudRate = bps;
+    huart->Init.WordLength = UART_WORDLENGTH_8B;
+    huart->Init.StopBits = UART_STOPBITS_1;
+    huart->Init.Parity = UART_PARITY_NONE;
+    huart->hdmatx = hdmatx;
+    huart->hdmarx = hdmarx;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    return HAL_UART_Init(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || huart->Init.BaudRate == 0)
+	return HAL_ERROR;
+    //Start + data + parity + stop, 9 bit word carry the parity bit
+    uint32_t bits = 1 + 8 + ((huart->Init.WordLength == UART_WORDLENGTH_9B) ? 1 : 0) + ((huart->Init.StopBits == UART_STOPBITS_2) ? 2 : 1);
+    uart->bps = huart->Init.BaudRate;
+    uart->byte_ns = (bits * 1000000000ULL + uart->bps / 2) / uart->bps;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_UART_SetIrqLatency(UART_HandleTypeDef *huart, uint32_t tx_cplt_us) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL)
+	return HAL_ERROR;
+    uart->tx_cplt_ns = (uint64_t) tx_cplt_us * 1000ULL;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_UART_Attach(UART_HandleTypeDef *huart, Briter_Host_UART_Listener listener, void *context) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || listener == NULL || uart->node_count >= BRITER_HOST_NODE_MAX)
+	return HAL_ERROR;
+    uart->node[uart->node_count].listener = listener;
+    uart->node[uart->node_count].context = context;
+    uart->node_count++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_UART_Reply(UART_HandleTypeDef *huart, uint32_t delay_us, const uint8_t *data, const uint8_t *flag, uint16_t size) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || data == NULL || host_event_count + size > BRITER_HOST_EVENT_MAX)
+	return HAL_ERROR;
+    uint64_t start = host_now + (uint64_t) delay_us * 1000ULL;
+    for (uint16_t i = 0; i < size; i++) {
+	uint64_t byte_start = start + i * uart->byte_ns;
+	uint8_t byte = data[i];
+	uint8_t byte_flag = flag ? flag[i] : 0;
+	//Two driver on the line at once, receiver see garbage
+	if (byte_start < uart->line_free_ns) {
+	    byte = (uint8_t) ~byte;
+	    byte_flag |= BRITER_HOST_BYTE_FRAMING;
+	    uart->stats.collision++;
+	}
+	Host_Post(byte_start + uart->byte_ns, HOST_EVENT_UART_RX_BYTE, uart, (uint32_t) byte | (uint32_t) byte_flag << 8, NULL);
+    }
+    uint64_t end = start + size * uart->byte_ns;
+    if (end > uart->line_free_ns) {
+	uart->stats.busy_ns += end - ((start > uart->line_free_ns) ? start : uart->line_free_ns);
+	uart->line_free_ns = end;
+    }
+    return HAL_OK;
+}
+
+uint64_t BRITER_Host_UART_ByteTime_ns(const UART_HandleTypeDef *huart) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    return uart ? uart->byte_ns : 0;
+}
+
+uint32_t BRITER_Host_UART_GetBaudrate(const UART_HandleTypeDef *huart) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    return uart ? uart->bps : 0;
+}
+
+void BRITER_Host_UART_GetStats(const UART_HandleTypeDef *huart, Briter_Host_Line_Stats_t *stats) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart != NULL)
+	*stats = uart->stats;
+    else
+	memset(stats, 0, sizeof(Briter_Host_Line_Stats_t));
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || pData == NULL || Size == 0 || Size > BRITER_HOST_UART_FRAME_MAX)
+	return HAL_ERROR;
+    if (uart->tx_busy)
+	return HAL_BUSY;
+    Host_UART_TxStart(uart, pData, Size, 0);
+    uint64_t end = host_now + Size * uart->byte_ns;
+    Host_Post(end, HOST_EVENT_UART_TX_END, uart, uart->tx_generation, NULL);
+    uint64_t deadline = (Timeout == HAL_MAX_DELAY) ? UINT64_MAX : host_now + (uint64_t) Timeout * 1000000ULL;
+    while (uart->tx_busy && Host_Step(deadline))
+	;
+    if (uart->tx_busy) {
+	HAL_UART_AbortTransmit(huart);
+	return HAL_TIMEOUT;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || pData == NULL || Size == 0)
+	return HAL_ERROR;
+    if (uart->rx_mode != HOST_RX_NONE)
+	return HAL_BUSY;
+    uart->rx_mode = HOST_RX_BLOCKING;
+    uart->rx_buf = pData;
+    uart->rx_size = Size;
+    uart->rx_pos = 0;
+    //Polling reception read what was left in data register first
+    if (uart->rdr_full) {
+	uart->rdr_full = 0;
+	uart->rx_buf[uart->rx_pos++] = uart->rdr;
+    }
+    uint64_t deadline = (Timeout == HAL_MAX_DELAY) ? UINT64_MAX : host_now + (uint64_t) Timeout * 1000000ULL;
+    while (uart->rx_pos < uart->rx_size && Host_Step(deadline))
+	;
+    HAL_StatusTypeDef status = (uart->rx_pos < uart->rx_size) ? HAL_TIMEOUT : HAL_OK;
+    uart->rx_mode = HOST_RX_NONE;
+    return status;
+}
+
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || pData == NULL || Size == 0 || Size > BRITER_HOST_UART_FRAME_MAX)
+	return HAL_ERROR;
+    if (uart->tx_busy)
+	return HAL_BUSY;
+    Host_UART_TxStart(uart, pData, Size, 1);
+    if (huart->hdmatx != NULL)
+	huart->hdmatx->ITMask = DMA_IT_TC | DMA_IT_HT;
+    return Host_Post(host_now + Size * uart->byte_ns, HOST_EVENT_UART_TX_END, uart, uart->tx_generation, NULL);
+}
+
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL || pData == NULL || Size == 0 || huart->hdmarx == NULL)
+	return HAL_ERROR;
+    if (uart->rx_mode != HOST_RX_NONE)
+	return HAL_BUSY;
+    uart->rx_mode = HOST_RX_IDLE_DMA;
+    uart->rx_circular = (huart->hdmarx->Init.Mode == DMA_CIRCULAR);
+    uart->rx_buf = pData;
+    uart->rx_size = Size;
+    uart->rx_pos = 0;
+    uart->rx_sequence++;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    huart->hdmarx->ITMask = DMA_IT_TC | DMA_IT_HT;
+    //HAL clear overrun before DMA request, data register is read out by it
+    uart->rdr_full = 0;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart) {
+    HAL_UART_AbortTransmit(huart);
+    return HAL_UART_AbortReceive(huart);
+}
+
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef *huart) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL)
+	return HAL_ERROR;
+    //Device see partial frame as nothing, event of it is ignored
+    uart->tx_busy = 0;
+    uart->tx_generation++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart) {
+    Host_UART_t *uart = Host_UART_Find(huart);
+    if (uart == NULL)
+	return HAL_ERROR;
+    uart->rx_mode = HOST_RX_NONE;
+    uart->rx_sequence++;
+    huart->ErrorCode = HAL_UART_ERROR_NONE;
+    return HAL_OK;
+}
+
+__weak void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart) {
+    (void) huart;
+}
+
+__weak void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart) {
+    (void) huart;
+}
+
+__weak void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size) {
+    (void) huart;
+    (void) Size;
+}
+
+HAL_StatusTypeDef BRITER_Host_CAN_Init(CAN_HandleTypeDef *hcan, uint32_t bps) {
+    if (hcan == NULL || bps == 0)
+	return HAL_ERROR;
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    for (uint8_t i = 0; can == NULL && i < BRITER_HOST_CAN_MAX; i++) {
+	if (host_can[i].hcan == NULL)
+	    can = &host_can[i];
+    }
+    if (can == NULL)
+	return HAL_ERROR;
+    memset(can, 0, sizeof(Host_CAN_t));
+    can->hcan = hcan;
+    can->bps = bps;
+    can->on_bus = -1;
+    hcan->ErrorCode = HAL_CAN_ERROR_NONE;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_CAN_Attach(CAN_HandleTypeDef *hcan, Briter_Host_CAN_Listener listener, void *context) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || listener == NULL || can->node_count >= BRITER_HOST_NODE_MAX)
+	return HAL_ERROR;
+    can->node[can->node_count].can_listener = listener;
+    can->node[can->node_count].context = context;
+    can->node_count++;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef BRITER_Host_CAN_Reply(CAN_HandleTypeDef *hcan, uint32_t delay_us, uint32_t std_id, const uint8_t *data, uint8_t dlc, uint8_t error_count) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || dlc > 8 || (dlc && data == NULL))
+	return HAL_ERROR;
+    for (uint8_t i = 0; i < sizeof(can->device) / sizeof(can->device[0]); i++) {
+	Host_CAN_Frame_t *frame = &can->device[i];
+	if (frame->used)
+	    continue;
+	frame->used = 1;
+	frame->std_id = std_id & 0x7FF;
+	frame->dlc = dlc;
+	memcpy(frame->data, data, dlc);
+	frame->error_count = error_count;
+	frame->ready_ns = host_now + (uint64_t) delay_us * 1000ULL;
+	return Host_Post(frame->ready_ns, HOST_EVENT_CAN_ARBITRATE, can, 0, NULL);
+    }
+    return HAL_ERROR;
+}
+
+uint64_t BRITER_Host_CAN_FrameTime_ns(const CAN_HandleTypeDef *hcan, uint8_t dlc) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL)
+	return 0;
+    //Standard data frame, worst case stuffing from SOF to CRC, 3 bit interframe space
+    uint64_t bits = 47 + 8 * dlc + (34 + 8 * dlc - 1) / 4;
+    return (bits * 1000000000ULL + can->bps - 1) / can->bps;
+}
+
+uint32_t BRITER_Host_CAN_GetBaudrate(const CAN_HandleTypeDef *hcan) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    return can ? can->bps : 0;
+}
+
+void BRITER_Host_CAN_GetStats(const CAN_HandleTypeDef *hcan, Briter_Host_Line_Stats_t *stats) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can != NULL)
+	*stats = can->stats;
+    else
+	memset(stats, 0, sizeof(Briter_Host_Line_Stats_t));
+}
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, const CAN_FilterTypeDef *sFilterConfig) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || sFilterConfig == NULL || sFilterConfig->FilterBank >= 28) {
+	if (hcan != NULL)
+	    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+	return HAL_ERROR;
+    }
+    can->filter[sFilterConfig->FilterBank] = *sFilterConfig;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, const CAN_TxHeaderTypeDef *pHeader, const uint8_t aData[], uint32_t *pTxMailbox) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || pHeader == NULL || pHeader->DLC > 8 || pHeader->IDE != CAN_ID_STD || pHeader->StdId > 0x7FF)
+	return HAL_ERROR;
+    for (uint8_t i = 0; i < 3; i++) {
+	Host_CAN_Frame_t *frame = &can->mailbox[i];
+	if (frame->used)
+	    continue;
+	frame->used = 1;
+	frame->std_id = pHeader->StdId;
+	frame->dlc = (uint8_t) pHeader->DLC;
+	memcpy(frame->data, aData, pHeader->DLC);
+	frame->error_count = 0;
+	frame->ready_ns = host_now;
+	*pTxMailbox = 1UL << i;
+	//Arbitration run as event, interrupt never nest in caller
+	return Host_Post(host_now, HOST_EVENT_CAN_ARBITRATE, can, 0, NULL);
+    }
+    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+    return HAL_ERROR;
+}
+
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef *hcan) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    uint32_t free_level = 0;
+    for (uint8_t i = 0; can != NULL && i < 3; i++) {
+	if (!can->mailbox[i].used)
+	    free_level++;
+    }
+    return free_level;
+}
+
+uint32_t HAL_CAN_GetTxTimestamp(const CAN_HandleTypeDef *hcan, uint32_t TxMailbox) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || TxMailbox == 0 || TxMailbox > CAN_TX_MAILBOX2)
+	return 0;
+    return can->mailbox_time[TxMailbox >> 1];
+}
+
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader, uint8_t aData[]) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || RxFifo > CAN_RX_FIFO1 || can->fifo_count[RxFifo] == 0) {
+	if (hcan != NULL)
+	    hcan->ErrorCode |= HAL_CAN_ERROR_PARAM;
+	return HAL_ERROR;
+    }
+    uint8_t head = can->fifo_head[RxFifo];
+    *pHeader = can->fifo_header[RxFifo][head];
+    memcpy(aData, can->fifo_data[RxFifo][head], pHeader->DLC);
+    can->fifo_head[RxFifo] = (uint8_t) ((head + 1) % BRITER_HOST_CAN_FIFO_SIZE);
+    can->fifo_count[RxFifo]--;
+    return HAL_OK;
+}
+
+uint32_t HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef *hcan, uint32_t RxFifo) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL || RxFifo > CAN_RX_FIFO1)
+	return 0;
+    return can->fifo_count[RxFifo];
+}
+
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL)
+	return HAL_ERROR;
+    can->it |= ActiveITs;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs) {
+    Host_CAN_t *can = Host_CAN_Find(hcan);
+    if (can == NULL)
+	return HAL_ERROR;
+    can->it &= ~InactiveITs;
+    return HAL_OK;
+}
+
+__weak void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+    (void) hcan;
+}
+
+__weak void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+    (void) hcan;
+}
+
+__weak void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+    (void) hcan;
+}
+
+__weak void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    (void) hcan;
+}
+
+__weak void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    (void) hcan;
+}
+
+/**
+ * @brief  Queue event, kept as binary min heap on time then insertion order.
+ * @param  time virtual time in ns
+ * @param  type event kind
+ * @param  object peripheral model or timer context
+ * @param  arg event argument
+ * @param  callback timer function, NULL for peripheral event
+ * @retval HAL status, HAL_ERROR if queue is full
+ */
+static HAL_StatusTypeDef Host_Post(uint64_t time, Host_Event_e type, void *object, uint32_t arg, Briter_Host_Callback callback) {
+    if (host_event_count >= BRITER_HOST_EVENT_MAX)
+	return HAL_ERROR;
+    Host_Event_t event = { time, host_order++, type, object, arg, callback };
+    uint32_t i = host_event_count++;
+    while (i > 0) {
+	uint32_t parent = (i - 1) / 2;
+	const Host_Event_t *p = &host_event[parent];
+	if (p->time < time || (p->time == time && p->order < event.order))
+	    break;
+	host_event[i] = *p;
+	i = parent;
+    }
+    host_event[i] = event;
+    return HAL_OK;
+}
+
+/**
+ * @brief  Serve earliest event if it is due by limit, else move time to limit.
+ * @param  limit virtual time in ns
+ * @retval 1 if an event was served, 0 if time reached limit
+ */
+static uint8_t Host_Step(uint64_t limit) {
+    if (host_event_count == 0 || host_event[0].time > limit) {
+	if (limit != UINT64_MAX && limit > host_now)
+	    host_now = limit;
+	return 0;
+    }
+    Host_Event_t event = host_event[0];
+    Host_Event_t last = host_event[--host_event_count];
+    uint32_t i = 0;
+    for (;;) {
+	uint32_t child = 2 * i + 1;
+	if (child >= host_event_count)
+	    break;
+	if (child + 1 < host_event_count && (host_event[child + 1].time < host_event[child].time
+		|| (host_event[child + 1].time == host_event[child].time && host_event[child + 1].order < host_event[child].order)))
+	    child++;
+	if (last.time < host_event[child].time || (last.time == host_event[child].time && last.order < host_event[child].order))
+	    break;
+	host_event[i] = host_event[child];
+	i = child;
+    }
+    host_event[i] = last;
+    if (event.time > host_now)
+	host_now = event.time;
+    Host_Dispatch(&event);
+    return 1;
+}
+
+/**
+ * @brief  Run event like the interrupt it stand for.
+ * @param  event event taken from queue
+ * @retval none
+ */
+static void Host_Dispatch(const Host_Event_t *event) {
+    switch (event->type) {
+    case HOST_EVENT_TIMER:
+	event->callback(event->object);
+	break;
+    case HOST_EVENT_UART_TX_END:
+	Host_UART_TxEnd((Host_UART_t*) event->object, event->arg);
+	break;
+    case HOST_EVENT_UART_TX_CPLT: {
+	Host_UART_t *uart = (Host_UART_t*) event->object;
+	if (event->arg != uart->tx_generation || !uart->tx_busy)
+	    break;
+	uart->tx_busy = 0;
+	HAL_UART_TxCpltCallback(uart->huart);
+	break;
+    }
+    case HOST_EVENT_UART_RX_BYTE:
+	Host_UART_RxByte((Host_UART_t*) event->object, (uint8_t) event->arg, (uint8_t) (event->arg >> 8));
+	break;
+    case HOST_EVENT_UART_IDLE:
+	Host_UART_Idle((Host_UART_t*) event->object, event->arg);
+	break;
+    case HOST_EVENT_CAN_ARBITRATE:
+	Host_CAN_Arbitrate((Host_CAN_t*) event->object);
+	break;
+    case HOST_EVENT_CAN_DONE:
+	Host_CAN_Done((Host_CAN_t*) event->object);
+	break;
+    }
+}
+
+/**
+ * @brief  Find model of UART.
+ * @param  huart uart handler
+ * @retval model, NULL if BRITER_Host_UART_Init() was not called
+ */
+static Host_UART_t* Host_UART_Find(const UART_HandleTypeDef *huart) {
+    for (uint8_t i = 0; huart != NULL && i < BRITER_HOST_UART_MAX; i++) {
+	if (host_uart[i].huart == huart)
+	    return &host_uart[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief  MCU frame start on the line, keep shortest silence before it.
+ * @param  uart UART model
+ * @param  data frame
+ * @param  size frame size
+ * @param  dma 1 if sent by DMA
+ * @retval none
+ */
+static void Host_UART_TxStart(Host_UART_t *uart, const uint8_t *data, uint16_t size, uint8_t dma) {
+    //Nothing was on the line before first frame
+    if (uart->line_free_ns) {
+	uint64_t gap = (host_now > uart->line_free_ns) ? host_now - uart->line_free_ns : 0;
+	if (gap < uart->stats.tx_gap_min_ns)
+	    uart->stats.tx_gap_min_ns = gap;
+    }
+    uart->tx_busy = 1;
+    uart->tx_dma = dma;
+    uart->tx_size = size;
+    memcpy(uart->tx_frame, data, size);
+}
+
+/**
+ * @brief  MCU frame left the pin, hand it to device and raise TX complete.
+ * @param  uart UART model
+ * @param  generation transmission the event belong to
+ * @retval none
+ */
+static void Host_UART_TxEnd(Host_UART_t *uart, uint32_t generation) {
+    if (generation != uart->tx_generation || !uart->tx_busy)
+	return;
+    uart->stats.tx_frame++;
+    uart->stats.tx_byte += uart->tx_size;
+    uart->stats.busy_ns += uart->tx_size * uart->byte_ns;
+    if (host_now > uart->line_free_ns)
+	uart->line_free_ns = host_now;
+    for (uint8_t i = 0; i < uart->node_count; i++)
+	uart->node[i].listener(uart->node[i].context, uart->huart, uart->tx_frame, uart->tx_size);
+    if (!uart->tx_dma) {
+	uart->tx_busy = 0;
+	return;
+    }
+    //Device answer is already queued, a late interrupt may come after its first byte
+    if (uart->tx_cplt_ns) {
+	Host_Post(host_now + uart->tx_cplt_ns, HOST_EVENT_UART_TX_CPLT, uart, generation, NULL);
+	return;
+    }
+    uart->tx_busy = 0;
+    HAL_UART_TxCpltCallback(uart->huart);
+}
+
+/**
+ * @brief  Byte from device reached MCU.
+ * @param  uart UART model
+ * @param  byte received byte
+ * @param  flag BRITER_HOST_BYTE_xxx
+ * @retval none
+ */
+static void Host_UART_RxByte(Host_UART_t *uart, uint8_t byte, uint8_t flag) {
+    if (uart->rx_mode == HOST_RX_NONE) {
+	//Data register hold one byte, next one overrun it
+	if (uart->rdr_full)
+	    uart->stats.lost_byte++;
+	uart->rdr = byte;
+	uart->rdr_full = 1;
+	return;
+    }
+    if (uart->rx_mode == HOST_RX_IDLE_DMA && (flag & BRITER_HOST_BYTE_OVERRUN)) {
+	uart->stats.lost_byte++;
+	Host_UART_Fail(uart, HAL_UART_ERROR_ORE);
+	return;
+    }
+    uart->stats.rx_byte++;
+    uart->rx_buf[uart->rx_pos++] = byte;
+    if (uart->rx_mode == HOST_RX_BLOCKING) {
+	//Polling reception does not look at error flag
+	if (uart->rx_pos >= uart->rx_size)
+	    uart->rx_mode = HOST_RX_NONE;
+	return;
+    }
+    if (flag & (BRITER_HOST_BYTE_NOISE | BRITER_HOST_BYTE_FRAMING)) {
+	Host_UART_Fail(uart, ((flag & BRITER_HOST_BYTE_NOISE) ? HAL_UART_ERROR_NE : 0) | ((flag & BRITER_HOST_BYTE_FRAMING) ? HAL_UART_ERROR_FE : 0));
+	return;
+    }
+    uint32_t sequence = ++uart->rx_sequence;
+    Host_Post(host_now + uart->byte_ns, HOST_EVENT_UART_IDLE, uart, sequence, NULL);
+    UART_HandleTypeDef *huart = uart->huart;
+    if (uart->rx_pos == uart->rx_size / 2 && (huart->hdmarx->ITMask & DMA_IT_HT))
+	HAL_UARTEx_RxEventCallback(huart, (uint16_t) (uart->rx_size / 2));
+    if (uart->rx_pos == uart->rx_size && uart->rx_sequence == sequence) {
+	//Normal DMA stop when full, circular start over
+	if (uart->rx_circular)
+	    uart->rx_pos = 0;
+	else
+	    uart->rx_mode = HOST_RX_NONE;
+	HAL_UARTEx_RxEventCallback(huart, uart->rx_size);
+    }
+}
+
+/**
+ * @brief  Line idle one byte time after last received byte.
+ * @param  uart UART model
+ * @param  sequence receive sequence when idle event was queued
+ * @retval none
+ */
+static void Host_UART_Idle(Host_UART_t *uart, uint32_t sequence) {
+    if (sequence != uart->rx_sequence || uart->rx_mode != HOST_RX_IDLE_DMA)
+	return;
+    //HAL report idle only when some but not all of buffer is filled
+    if (uart->rx_pos == 0)
+	return;
+    uint16_t size = uart->rx_pos;
+    if (!uart->rx_circular)
+	uart->rx_mode = HOST_RX_NONE;
+    HAL_UARTEx_RxEventCallback(uart->huart, size);
+}
+
+/**
+ * @brief  Stop DMA reception on error and raise error callback, as HAL does.
+ * @param  uart UART model
+ * @param  error HAL_UART_ERROR_xxx
+ * @retval none
+ */
+static void Host_UART_Fail(Host_UART_t *uart, uint32_t error) {
+    uart->rx_mode = HOST_RX_NONE;
+    uart->rx_sequence++;
+    uart->stats.error++;
+    uart->huart->ErrorCode |= error;
+    HAL_UART_ErrorCallback(uart->huart);
+}
+
+/**
+ * @brief  Find model of CAN peripheral.
+ * @param  hcan can handler
+ * @retval model, NULL if BRITER_Host_CAN_Init() was not called
+ */
+static Host_CAN_t* Host_CAN_Find(const CAN_HandleTypeDef *hcan) {
+    for (uint8_t i = 0; hcan != NULL && i < BRITER_HOST_CAN_MAX; i++) {
+	if (host_can[i].hcan == hcan)
+	    return &host_can[i];
+    }
+    return NULL;
+}
+
+/**
+ * @brief  Frame slot by bus index, mailbox 0 to 2 then device frame.
+ * @param  can CAN model
+ * @param  index slot index
+ * @retval frame slot
+ */
+static Host_CAN_Frame_t* Host_CAN_Slot(Host_CAN_t *can, int8_t index) {
+    return (index < 3) ? &can->mailbox[index] : &can->device[index - 3];
+}
+
+/**
+ * @brief  Start frame with lowest ID among ready ones if bus is idle.
+ * @param  can CAN model
+ * @retval none
+ */
+static void Host_CAN_Arbitrate(Host_CAN_t *can) {
+    if (can->on_bus >= 0)
+	return;
+    int8_t winner = -1;
+    int8_t count = (int8_t) (3 + sizeof(can->device) / sizeof(can->device[0]));
+    for (int8_t i = 0; i < count; i++) {
+	Host_CAN_Frame_t *frame = Host_CAN_Slot(can, i);
+	if (!frame->used || frame->ready_ns > host_now)
+	    continue;
+	if (winner < 0 || frame->std_id < Host_CAN_Slot(can, winner)->std_id)
+	    winner = i;
+    }
+    if (winner < 0)
+	return;
+    Host_CAN_Frame_t *frame = Host_CAN_Slot(can, winner);
+    can->on_bus = winner;
+    can->on_bus_start = host_now;
+    //Every bus error cost the frame so far plus error frame, then it is sent again
+    uint64_t frame_ns = BRITER_Host_CAN_FrameTime_ns(can->hcan, frame->dlc);
+    uint64_t error_ns = (20ULL * 1000000000ULL + can->bps - 1) / can->bps;
+    uint64_t busy = frame_ns + frame->error_count * (frame_ns + error_ns);
+    can->stats.error += frame->error_count;
+    can->stats.busy_ns += busy;
+    Host_Post(host_now + busy, HOST_EVENT_CAN_DONE, can, 0, NULL);
+}
+
+/**
+ * @brief  Frame on bus is through, deliver it and start next one.
+ * @param  can CAN model
+ * @retval none
+ */
+static void Host_CAN_Done(Host_CAN_t *can) {
+    int8_t index = can->on_bus;
+    Host_CAN_Frame_t frame = *Host_CAN_Slot(can, index);
+    uint64_t frame_ns = BRITER_Host_CAN_FrameTime_ns(can->hcan, frame.dlc);
+    uint16_t timestamp = Host_CAN_Timer(can, host_now - frame_ns);
+    Host_CAN_Slot(can, index)->used = 0;
+    can->on_bus = -1;
+    Host_Post(host_now, HOST_EVENT_CAN_ARBITRATE, can, 0, NULL);
+    if (index >= 3) {
+	Host_CAN_Receive(can, &frame, timestamp);
+	return;
+    }
+    can->stats.tx_frame++;
+    can->stats.tx_byte += frame.dlc;
+    can->mailbox_time[index] = timestamp;
+    CAN_TxHeaderTypeDef header = { frame.std_id, 0, CAN_ID_STD, CAN_RTR_DATA, frame.dlc, DISABLE };
+    for (uint8_t i = 0; i < can->node_count; i++)
+	can->node[i].can_listener(can->node[i].context, can->hcan, &header, frame.data);
+    if (!(can->it & CAN_IT_TX_MAILBOX_EMPTY))
+	return;
+    if (index == 0)
+	HAL_CAN_TxMailbox0CompleteCallback(can->hcan);
+    else if (index == 1)
+	HAL_CAN_TxMailbox1CompleteCallback(can->hcan);
+    else
+	HAL_CAN_TxMailbox2CompleteCallback(can->hcan);
+}
+
+/**
+ * @brief  Device frame through filter into FIFO, raise pending callback.
+ * @param  can CAN model
+ * @param  frame received frame
+ * @param  timestamp timer at start of frame
+ * @retval none
+ */
+static void Host_CAN_Receive(Host_CAN_t *can, const Host_CAN_Frame_t *frame, uint16_t timestamp) {
+    int8_t fifo = -1;
+    uint32_t index = 0;
+    for (uint8_t bank = 0; bank < 28 && fifo < 0; bank++)
+	fifo = Host_CAN_Match(&can->filter[bank], frame->std_id, &index);
+    if (fifo < 0)
+	return;
+    if (can->fifo_count[fifo] >= BRITER_HOST_CAN_FIFO_SIZE) {
+	can->stats.lost_byte += frame->dlc;
+	can->hcan->ErrorCode |= fifo ? HAL_CAN_ERROR_RX_FOV1 : HAL_CAN_ERROR_RX_FOV0;
+	return;
+    }
+    uint8_t slot = (uint8_t) ((can->fifo_head[fifo] + can->fifo_count[fifo]) % BRITER_HOST_CAN_FIFO_SIZE);
+    CAN_RxHeaderTypeDef *header = &can->fifo_header[fifo][slot];
+    header->StdId = frame->std_id;
+    header->ExtId = 0;
+    header->IDE = CAN_ID_STD;
+    header->RTR = CAN_RTR_DATA;
+    header->DLC = frame->dlc;
+    header->Timestamp = timestamp;
+    header->FilterMatchIndex = index;
+    memcpy(can->fifo_data[fifo][slot], frame->data, frame->dlc);
+    can->fifo_count[fifo]++;
+    can->stats.rx_byte += frame->dlc;
+    //Pending interrupt stay while FIFO is not empty, stop if callback leave it
+    uint32_t it = fifo ? CAN_IT_RX_FIFO1_MSG_PENDING : CAN_IT_RX_FIFO0_MSG_PENDING;
+    while ((can->it & it) && can->fifo_count[fifo]) {
+	uint8_t before = can->fifo_count[fifo];
+	if (fifo)
+	    HAL_CAN_RxFifo1MsgPendingCallback(can->hcan);
+	else
+	    HAL_CAN_RxFifo0MsgPendingCallback(can->hcan);
+	if (can->fifo_count[fifo] >= before)
+	    break;
+    }
+}
+
+/**
+ * @brief  Match standard ID against one filter bank as bxCAN.
+ * @param  filter filter bank
+ * @param  std_id standard ID of frame
+ * @param  index filter match index, bank * 4 + entry
+ * @retval FIFO of filter, -1 if no match
+ */
+static int8_t Host_CAN_Match(const CAN_FilterTypeDef *filter, uint32_t std_id, uint32_t *index) {
+    if (filter->FilterActivation != ENABLE)
+	return -1;
+    int8_t fifo = (int8_t) filter->FilterFIFOAssignment;
+    uint32_t base = filter->FilterBank * 4;
+    if (filter->FilterScale == CAN_FILTERSCALE_32BIT) {
+	//STID[10:0] EXID[17:0] IDE RTR 0, data standard frame
+	uint32_t id = std_id << 21;
+	uint32_t first = filter->FilterIdHigh << 16 | (filter->FilterIdLow & 0xFFFF);
+	uint32_t second = filter->FilterMaskIdHigh << 16 | (filter->FilterMaskIdLow & 0xFFFF);
+	if (filter->FilterMode == CAN_FILTERMODE_IDMASK) {
+	    *index = base;
+	    return ((id & second) == (first & second)) ? fifo : -1;
+	}
+	*index = base;
+	if (id == first)
+	    return fifo;
+	*index = base + 1;
+	return (id == second) ? fifo : -1;
+    }
+    //STID[10:0] RTR IDE EXID[17:15]
+    uint32_t id = (std_id << 5) & 0xFFFF;
+    uint32_t entry[4] = { filter->FilterIdLow & 0xFFFF, filter->FilterIdHigh & 0xFFFF, filter->FilterMaskIdLow & 0xFFFF, filter->FilterMaskIdHigh & 0xFFFF };
+    if (filter->FilterMode == CAN_FILTERMODE_IDMASK) {
+	for (uint8_t i = 0; i < 2; i++) {
+	    uint32_t mask = entry[2 + i];
+	    *index = base + i;
+	    if ((id & mask) == (entry[i] & mask))
+		return fifo;
+	}
+	return -1;
+    }
+    for (uint8_t i = 0; i < 4; i++) {
+	*index = base + i;
+	if (id == entry[i])
+	    return fifo;
+    }
+    return -1;
+}
+
+/**
+ * @brief  16 bit CAN timer, count bit time, as used by TTCM.
+ * @param  can CAN model
+ * @param  time virtual time in ns
+ * @retval timer value
+ */
+static uint16_t Host_CAN_Timer(const Host_CAN_t *can, uint64_t time) {
+    return (uint16_t) ((unsigned __int128) time * can->bps / 1000000000ULL);
+}
@@ -0,0 +1,357 @@
+/**
+  ******************************************************************************
+  * @file    briter_host_hal.h
+  * @author  Ang Chin Xian
+  * @brief   STM32 HAL stand-in to build and run Briter encoder drivers on a
+  *          Linux host, with virtual time, UART/DMA line and CAN bus model.
+  *
+  ==============================================================================
+                        ##### How to use this file #####
+  ==============================================================================
+  1. Build driver with -DBRITER_HAL_HEADER=\"briter_host_hal.h\", CMakeLists.txt
+      of driver folder does it for every host target. Do not add host/ to
+      target build
+  2. Time is virtual, nothing run by itself
+      - BRITER_Host_Reset() clear every peripheral and set time to 0
+      - BRITER_Host_Run() serve every event due in the given time, callback
+	(HAL_UART_TxCpltCallback(), HAL_CAN_RxFifo0MsgPendingCallback()...)
+	is called from there like an interrupt
+      - Blocking HAL_UART_Transmit(), HAL_UART_Receive() and HAL_Delay()
+	serve event until they return
+      - HAL_GetTick() is virtual ms, BRITER_Host_Time_us() virtual us
+      - BRITER_Host_Schedule() call function after delay, stand-in of timer
+	interrupt
+  3. UART, call BRITER_Host_UART_Init() for every huart before use
+      - Byte take start, data, parity and stop bit time of huart->Init on
+	the line, call HAL_UART_Init() after changing it
+      - Line idle event come one byte time after last received byte
+      - hdmarx->Init.Mode DMA_CIRCULAR keep ReceiveToIdle_DMA running with
+	half, full and idle event
+      - MCU does not hear its own request
+  4. CAN, call BRITER_Host_CAN_Init() with bit rate for every hcan
+      - 3 mailbox, lowest ID win arbitration, frame time with worst case bit
+	stuffing
+      - Filter bank work as bxCAN, no active filter receive nothing
+      - FIFO hold 3 frame, more is lost
+      - Timestamp is 16 bit bit-time counter, as with TTCM
+  5. Device on the line, briter_host_encoder.h, attach with
+      BRITER_Host_UART_Attach() or BRITER_Host_CAN_Attach() and answer with
+      BRITER_Host_UART_Reply() or BRITER_Host_CAN_Reply()
+  6. DWT->CYCCNT count host ns, SystemCoreClock is 1 GHz so cycle and ns
+      are the same on host
+*/
+#ifndef BRITER_HOST_HAL_H_
+#define BRITER_HOST_HAL_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/** @defgroup BRITER_HOST_HAL_Core
+ * @{
+ */
+#define __weak	__attribute__((weak))
+#define __IO	volatile
+
+typedef enum {
+    HAL_OK = 0x00U,
+    HAL_ERROR = 0x01U,
+    HAL_BUSY = 0x02U,
+    HAL_TIMEOUT = 0x03U,
+} HAL_StatusTypeDef;
+
+typedef enum {
+    DISABLE = 0U,
+    ENABLE = !DISABLE,
+} FunctionalState;
+
+#define HAL_MAX_DELAY	0xFFFFFFFFU
+#define assert_param(expr)	((void) 0U)
+
+/** Interrupt mask of driver critical section, event only run from
+ * BRITER_Host_Run() and blocking HAL call so it never break into one*/
+extern uint32_t briter_host_primask;
+
+static inline void __disable_irq(void) {
+    briter_host_primask = 1;
+}
+
+static inline void __enable_irq(void) {
+    briter_host_primask = 0;
+}
+
+static inline uint32_t __get_PRIMASK(void) {
+    return briter_host_primask;
+}
+
+static inline void __set_PRIMASK(uint32_t primask) {
+    briter_host_primask = primask;
+}
+
+static inline void __DMB(void) {
+    __sync_synchronize();
+}
+
+static inline uint32_t __CLZ(uint32_t value) {
+    return value ? (uint32_t) __builtin_clz(value) : 32U;
+}
+
+/** Cycle counter, CYCCNT is brought up to date on every DWT access*/
+typedef struct {
+    __IO uint32_t CTRL;
+    __IO uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    __IO uint32_t DEMCR;
+} CoreDebug_Type;
+
+DWT_Type* BRITER_Host_DWT(void);
+extern CoreDebug_Type briter_host_core_debug;
+extern uint32_t SystemCoreClock;
+
+#define DWT	(BRITER_Host_DWT())
+#define CoreDebug	(&briter_host_core_debug)
+#define DWT_CTRL_CYCCNTENA_Msk	(1UL << 0)
+#define CoreDebug_DEMCR_TRCENA_Msk	(1UL << 24)
+
+uint32_t HAL_GetTick(void);
+void HAL_Delay(uint32_t Delay);
+/**
+ * @}
+ */
+
+/** @defgroup BRITER_HOST_HAL_UART
+ * @{
+ */
+typedef struct {
+    uint32_t Mode; /*!< DMA_NORMAL or DMA_CIRCULAR*/
+} DMA_InitTypeDef;
+
+typedef struct {
+    void *Instance;
+    DMA_InitTypeDef Init;
+    uint32_t ITMask; /*!< Interrupt left enabled, set again on every start*/
+} DMA_HandleTypeDef;
+
+#define DMA_NORMAL	0x00000000U
+#define DMA_CIRCULAR	0x00000100U
+#define DMA_IT_TC	0x00000010U
+#define DMA_IT_HT	0x00000008U
+
+#define __HAL_DMA_DISABLE_IT(__HANDLE__, __INTERRUPT__)	((__HANDLE__)->ITMask &= ~(__INTERRUPT__))
+#define __HAL_DMA_ENABLE_IT(__HANDLE__, __INTERRUPT__)	((__HANDLE__)->ITMask |= (__INTERRUPT__))
+
+typedef struct {
+    uint32_t BaudRate;
+    uint32_t WordLength;
+    uint32_t StopBits;
+    uint32_t Parity;
+    uint32_t Mode;
+    uint32_t HwFlowCtl;
+    uint32_t OverSampling;
+} UART_InitTypeDef;
+
+typedef struct {
+    void *Instance;
+    UART_InitTypeDef Init;
+    DMA_HandleTypeDef *hdmatx;
+    DMA_HandleTypeDef *hdmarx;
+    __IO uint32_t ErrorCode;
+} UART_HandleTypeDef;
+
+#define UART_WORDLENGTH_8B	0x00000000U
+#define UART_WORDLENGTH_9B	0x00001000U
+#define UART_STOPBITS_1	0x00000000U
+#define UART_STOPBITS_2	0x00002000U
+#define UART_PARITY_NONE	0x00000000U
+#define UART_PARITY_EVEN	0x00000400U
+#define UART_PARITY_ODD	0x00000600U
+
+#define HAL_UART_ERROR_NONE	0x00000000U
+#define HAL_UART_ERROR_PE	0x00000001U
+#define HAL_UART_ERROR_NE	0x00000002U
+#define HAL_UART_ERROR_FE	0x00000004U
+#define HAL_UART_ERROR_ORE	0x00000008U
+#define HAL_UART_ERROR_DMA	0x00000010U
+
+HAL_StatusTypeDef HAL_UART_Init(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_Transmit(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Receive(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size, uint32_t Timeout);
+HAL_StatusTypeDef HAL_UART_Transmit_DMA(UART_HandleTypeDef *huart, const uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UARTEx_ReceiveToIdle_DMA(UART_HandleTypeDef *huart, uint8_t *pData, uint16_t Size);
+HAL_StatusTypeDef HAL_UART_Abort(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_AbortTransmit(UART_HandleTypeDef *huart);
+HAL_StatusTypeDef HAL_UART_AbortReceive(UART_HandleTypeDef *huart);
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart);
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *huart, uint16_t Size);
+/**
+ * @}
+ */
+
+/** @defgroup BRITER_HOST_HAL_CAN
+ * @{
+ */
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t Mode;
+    FunctionalState TimeTriggeredMode;
+    FunctionalState AutoRetransmission;
+} CAN_InitTypeDef;
+
+typedef struct {
+    void *Instance;
+    CAN_InitTypeDef Init;
+    __IO uint32_t ErrorCode;
+} CAN_HandleTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    FunctionalState TransmitGlobalTime;
+} CAN_TxHeaderTypeDef;
+
+typedef struct {
+    uint32_t StdId;
+    uint32_t ExtId;
+    uint32_t IDE;
+    uint32_t RTR;
+    uint32_t DLC;
+    uint32_t Timestamp;
+    uint32_t FilterMatchIndex;
+} CAN_RxHeaderTypeDef;
+
+typedef struct {
+    uint32_t FilterIdHigh;
+    uint32_t FilterIdLow;
+    uint32_t FilterMaskIdHigh;
+    uint32_t FilterMaskIdLow;
+    uint32_t FilterFIFOAssignment;
+    uint32_t FilterBank;
+    uint32_t FilterMode;
+    uint32_t FilterScale;
+    uint32_t FilterActivation;
+    uint32_t SlaveStartFilterBank;
+} CAN_FilterTypeDef;
+
+#define CAN_ID_STD	0x00000000U
+#define CAN_ID_EXT	0x00000004U
+#define CAN_RTR_DATA	0x00000000U
+#define CAN_RTR_REMOTE	0x00000002U
+
+#define CAN_FILTERMODE_IDMASK	0x00000000U
+#define CAN_FILTERMODE_IDLIST	0x00000001U
+#define CAN_FILTERSCALE_16BIT	0x00000000U
+#define CAN_FILTERSCALE_32BIT	0x00000001U
+#define CAN_FILTER_FIFO0	0x00000000U
+#define CAN_FILTER_FIFO1	0x00000001U
+#define CAN_FILTER_DISABLE	0x00000000U
+#define CAN_FILTER_ENABLE	0x00000001U
+
+#define CAN_RX_FIFO0	0x00000000U
+#define CAN_RX_FIFO1	0x00000001U
+#define CAN_TX_MAILBOX0	0x00000001U
+#define CAN_TX_MAILBOX1	0x00000002U
+#define CAN_TX_MAILBOX2	0x00000004U
+
+#define CAN_IT_TX_MAILBOX_EMPTY	0x00000001U
+#define CAN_IT_RX_FIFO0_MSG_PENDING	0x00000002U
+#define CAN_IT_RX_FIFO1_MSG_PENDING	0x00000010U
+
+#define HAL_CAN_ERROR_NONE	0x00000000U
+#define HAL_CAN_ERROR_RX_FOV0	0x00000200U
+#define HAL_CAN_ERROR_RX_FOV1	0x00000800U
+#define HAL_CAN_ERROR_PARAM	0x00200000U
+
+HAL_StatusTypeDef HAL_CAN_ConfigFilter(CAN_HandleTypeDef *hcan, const CAN_FilterTypeDef *sFilterConfig);
+HAL_StatusTypeDef HAL_CAN_AddTxMessage(CAN_HandleTypeDef *hcan, const CAN_TxHeaderTypeDef *pHeader, const uint8_t aData[], uint32_t *pTxMailbox);
+uint32_t HAL_CAN_GetTxMailboxesFreeLevel(const CAN_HandleTypeDef *hcan);
+uint32_t HAL_CAN_GetTxTimestamp(const CAN_HandleTypeDef *hcan, uint32_t TxMailbox);
+HAL_StatusTypeDef HAL_CAN_GetRxMessage(CAN_HandleTypeDef *hcan, uint32_t RxFifo, CAN_RxHeaderTypeDef *pHeader, uint8_t aData[]);
+uint32_t HAL_CAN_GetRxFifoFillLevel(const CAN_HandleTypeDef *hcan, uint32_t RxFifo);
+HAL_StatusTypeDef HAL_CAN_ActivateNotification(CAN_HandleTypeDef *hcan, uint32_t ActiveITs);
+HAL_StatusTypeDef HAL_CAN_DeactivateNotification(CAN_HandleTypeDef *hcan, uint32_t InactiveITs);
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan);
+void HAL_CAN_RxFifo1MsgPendingCallback(CAN_HandleTypeDef *hcan);
+/**
+ * @}
+ */
+
+/** @defgroup BRITER_HOST_Simulation
+ * @{
+ */
+#ifndef BRITER_HOST_EVENT_MAX
+#define BRITER_HOST_EVENT_MAX	1024	/*!< Event pending at once*/
+#endif
+#ifndef BRITER_HOST_UART_MAX
+#define BRITER_HOST_UART_MAX	4	/*!< UART with model*/
+#endif
+#ifndef BRITER_HOST_CAN_MAX
+#define BRITER_HOST_CAN_MAX	2	/*!< CAN peripheral with model*/
+#endif
+#ifndef BRITER_HOST_NODE_MAX
+#define BRITER_HOST_NODE_MAX	8	/*!< Device attached per line or bus*/
+#endif
+#define BRITER_HOST_UART_FRAME_MAX	256	/*!< Longest request frame seen by device*/
+#define BRITER_HOST_CAN_FIFO_SIZE	3	/*!< Frame per receive FIFO, as bxCAN*/
+
+/** Byte flag of device reply*/
+#define BRITER_HOST_BYTE_NOISE	0x01U	/*!< Noise flag, HAL_UART_ERROR_NE*/
+#define BRITER_HOST_BYTE_FRAMING	0x02U	/*!< Framing error, HAL_UART_ERROR_FE*/
+#define BRITER_HOST_BYTE_OVERRUN	0x04U	/*!< DMA late, byte lost, HAL_UART_ERROR_ORE*/
+
+/** Function called after delay, BRITER_Host_Schedule()*/
+typedef void (*Briter_Host_Callback)(void *context);
+
+/** Request frame received by device on UART line, timestamped at its last stop bit*/
+typedef void (*Briter_Host_UART_Listener)(void *context, UART_HandleTypeDef *huart, const uint8_t *frame, uint16_t size);
+
+/** Frame received by device on CAN bus, at its end of frame*/
+typedef void (*Briter_Host_CAN_Listener)(void *context, CAN_HandleTypeDef *hcan, const CAN_TxHeaderTypeDef *header, const uint8_t *data);
+
+/** Line and bus counter*/
+typedef struct {
+    uint32_t tx_frame; /*!< Frame sent by MCU*/
+    uint32_t tx_byte; /*!< Byte sent by MCU*/
+    uint32_t rx_byte; /*!< Byte received by MCU*/
+    uint32_t lost_byte; /*!< Byte arrived while reception was not armed or buffer full*/
+    uint32_t collision; /*!< Byte sent by device over another one*/
+    uint32_t error; /*!< Error callback raised*/
+    uint64_t busy_ns; /*!< Time line or bus carried a frame*/
+    uint64_t tx_gap_min_ns; /*!< UART, shortest silence before a MCU frame, UINT64_MAX until one follow another frame*/
+} Briter_Host_Line_Stats_t;
+
+void BRITER_Host_Reset(void);
+uint64_t BRITER_Host_Time_ns(void);
+uint64_t BRITER_Host_Time_us(void);
+void BRITER_Host_Run(uint32_t us);
+uint8_t BRITER_Host_RunUntil(volatile const uint8_t *flag, uint32_t timeout_us);
+uint32_t BRITER_Host_Pending(void);
+HAL_StatusTypeDef BRITER_Host_Schedule(uint32_t delay_us, Briter_Host_Callback callback, void *context);
+uint32_t BRITER_Host_Random(uint32_t *seed);
+
+HAL_StatusTypeDef BRITER_Host_UART_Init(UART_HandleTypeDef *huart, DMA_HandleTypeDef *hdmatx, DMA_HandleTypeDef *hdmarx, uint32_t bps);
+HAL_StatusTypeDef BRITER_Host_UART_SetIrqLatency(UART_HandleTypeDef *huart, uint32_t tx_cplt_us);
+HAL_StatusTypeDef BRITER_Host_UART_Attach(UART_HandleTypeDef *huart, Briter_Host_UART_Listener listener, void *context);
+HAL_StatusTypeDef BRITER_Host_UART_Reply(UART_HandleTypeDef *huart, uint32_t delay_us, const uint8_t *data, const uint8_t *flag, uint16_t size);
+uint64_t BRITER_Host_UART_ByteTime_ns(const UART_HandleTypeDef *huart);
+uint32_t BRITER_Host_UART_GetBaudrate(const UART_HandleTypeDef *huart);
+void BRITER_Host_UART_GetStats(const UART_HandleTypeDef *huart, Briter_Host_Line_Stats_t *stats);
+
+HAL_StatusTypeDef BRITER_Host_CAN_Init(CAN_HandleTypeDef *hcan, uint32_t bps);
+HAL_StatusTypeDef BRITER_Host_CAN_Attach(CAN_HandleTypeDef *hcan, Briter_Host_CAN_Listener listener, void *context);
+HAL_StatusTypeDef BRITER_Host_CAN_Reply(CAN_HandleTypeDef *hcan, uint32_t delay_us, uint32_t std_id, const uint8_t *data, uint8_t dlc, uint8_t error_count);
+uint64_t BRITER_Host_CAN_FrameTime_ns(const CAN_HandleTypeDef *hcan, uint8_t dlc);
+uint32_t BRITER_Host_CAN_GetBaudrate(const CAN_HandleTypeDef *hcan);
+void BRITER_Host_CAN_GetStats(const CAN_HandleTypeDef *hcan, Briter_Host_Line_Stats_t *stats);
+/**
+ * @}
+ */
+
+#endif /* BRITER_HOST_HAL_H_ */
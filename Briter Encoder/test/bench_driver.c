@@ -0,0 +1,128 @@
+/**
+ * @file   bench_driver.c
+ * @brief  Cost of one encoder read, driver cycle per operation, allocator
+ *         call and poll time on simulated line at every baudrate, as CSV.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_can.h"
+#include "briter_encoder_convert.h"
+#include "briter_encoder_profile.h"
+#include "briter_host_encoder.h"
+#define BRITER_TEST_ALLOC_WRAP
+#include "briter_test.h"
+
+#define BENCH_POLL	2000	/*!< Read per baudrate*/
+#define BENCH_CONVERT	1024	/*!< Sample per batch conversion*/
+
+static volatile uint8_t can_received;
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &header, data) == HAL_OK && BRITER_CAN_Dispatch(hcan, &header, data) != NULL)
+	can_received = 1;
+}
+
+/**
+ * @brief  Blocking RS485 read at one baudrate.
+ * @param  out CSV output
+ * @param  bps line baudrate
+ * @retval none
+ */
+static void Bench_RS485(FILE *out, uint32_t bps) {
+    static UART_HandleTypeDef huart;
+    static DMA_HandleTypeDef hdma_tx;
+    static DMA_HandleTypeDef hdma_rx;
+    Briter_Host_Encoder_t encoder;
+    Briter_Encoder_t handler;
+    uint32_t fail = 0;
+    BRITER_Host_Reset();
+    BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, bps);
+    BRITER_Host_Encoder_Init(&encoder, 1);
+    BRITER_Host_Encoder_Attach_RS485(&encoder, &huart);
+    BRITER_Host_Encoder_SetMotion(&encoder, 0, 10000);
+    BRITER_RS485_Init(&handler, 1, &huart);
+    alloc_count = 0;
+    uint64_t start = BRITER_Host_Time_ns();
+    for (uint32_t i = 0; i < BENCH_POLL; i++)
+	fail += (BRITER_RS485_GetEncoderValue(&handler) == (uint32_t) BRITER_RS485_ERROR);
+    uint64_t elapsed = BRITER_Host_Time_ns() - start;
+    fprintf(out, "poll,rs485_read,%lu,%.1f,%.3f,%lu\n", (unsigned long) bps, (double) elapsed / 1000.0 / BENCH_POLL,
+	    (double) alloc_count / BENCH_POLL, (unsigned long) fail);
+}
+
+/**
+ * @brief  CAN read at one bit rate, from request until value is dispatched.
+ * @param  out CSV output
+ * @param  bps bus bit rate
+ * @retval none
+ */
+static void Bench_CAN(FILE *out, uint32_t bps) {
+    static CAN_HandleTypeDef hcan;
+    Briter_Host_Encoder_t encoder;
+    Briter_CAN_Handler_t handler;
+    uint32_t fail = 0;
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, bps);
+    BRITER_Host_Encoder_Init(&encoder, 1);
+    BRITER_Host_Encoder_Attach_CAN(&encoder, &hcan);
+    BRITER_Host_Encoder_SetMotion(&encoder, 0, 10000);
+    BRITER_CAN_Init(&handler, 1, &hcan);
+    BRITER_CAN_Register(&handler);
+    BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 1);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    alloc_count = 0;
+    uint64_t start = BRITER_Host_Time_ns();
+    for (uint32_t i = 0; i < BENCH_POLL; i++) {
+	can_received = 0;
+	if (BRITER_CAN_ReadValue(&handler) != HAL_OK || !BRITER_Host_RunUntil(&can_received, 10000))
+	    fail++;
+    }
+    uint64_t elapsed = BRITER_Host_Time_ns() - start;
+    fprintf(out, "poll,can_read,%lu,%.1f,%.3f,%lu\n", (unsigned long) bps, (double) elapsed / 1000.0 / BENCH_POLL,
+	    (double) alloc_count / BENCH_POLL, (unsigned long) fail);
+    BRITER_CAN_Unregister(&handler);
+}
+
+/**
+ * @brief  Batch conversion of full range count.
+ * @retval none
+ */
+static void Bench_Convert(void) {
+    static uint32_t count[BENCH_CONVERT];
+    static int32_t value[BENCH_CONVERT];
+    Briter_Convert_t conv;
+    BRITER_Convert_Init(&conv, BRITER_MODEL(CAN_4096X24), BRITER_CONVERT_RADIAN);
+    for (uint32_t i = 0; i < BENCH_CONVERT; i++)
+	count[i] = i * 96U;
+    for (uint32_t i = 0; i < 100; i++)
+	BRITER_Convert_Array(&conv, count, value, BENCH_CONVERT);
+}
+
+int main(int argc, char *argv[]) {
+    static char buf[4096];
+    FILE *out = stdout;
+    if (argc > 1 && (out = fopen(argv[1], "w")) == NULL) {
+	perror(argv[1]);
+	return 1;
+    }
+    BRITER_Profile_Init();
+    fprintf(out, "#op,<name>,<count>,<min cycle>,<max cycle>,<mean cycle>,<mean ns>\n");
+    fprintf(out, "#bus,<transaction>,<bit per second>,<modeled us>\n");
+    fprintf(out, "#poll,<transaction>,<bit per second>,<simulated us per poll>,<alloc per poll>,<failed poll>\n");
+    for (uint8_t i = RS485_ENC_BAUDRATE_9600; i <= RS485_ENC_BAUDRATE_115200; i++)
+	Bench_RS485(out, BRITER_RS485_BaudrateValue((RS485_Enc_Baudrate_e) i));
+    for (uint8_t i = BRITER_CAN_BAUDRATE_500K; i <= BRITER_CAN_BAUDRATE_100K; i++)
+	Bench_CAN(out, BRITER_CAN_BaudrateValue((Briter_CAN_Baudrate_e) i));
+    Bench_Convert();
+    //Cycle of every driver operation over all poll above
+    BRITER_Profile_Format(buf, sizeof(buf));
+    fputs(buf, out);
+    if (out != stdout)
+	fclose(out);
+    return 0;
+}
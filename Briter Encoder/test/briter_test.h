@@ -0,0 +1,54 @@
+/**
+ * @file   briter_test.h
+ * @brief  Check macro and allocator counter shared by host test program.
+ * @author Ang Chin Xian
+ *
+ * Include once in each test, every program is a single file:
+ *   - CHECK() print the failed condition and set failed, main return it
+ *   - Define BRITER_TEST_ALLOC_WRAP before include in program linked with
+ *     -Wl,--wrap=malloc,--wrap=calloc,--wrap=realloc,--wrap=free, every
+ *     allocator call is then counted in alloc_count
+ */
+#ifndef BRITER_TEST_H_
+#define BRITER_TEST_H_
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/** Set by failed CHECK(), exit code of test*/
+static int failed __attribute__((unused));
+
+#define CHECK(cond)	do { if (!(cond)) { printf("%s:%d: %s\n", __FILE__, __LINE__, #cond); failed = 1; } } while (0)
+
+#ifdef BRITER_TEST_ALLOC_WRAP
+/** Allocator call, free of NULL is not counted*/
+static volatile uint32_t alloc_count;
+
+void* __real_malloc(size_t size);
+void* __real_calloc(size_t count, size_t size);
+void* __real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+void* __wrap_malloc(size_t size) {
+    alloc_count++;
+    return __real_malloc(size);
+}
+
+void* __wrap_calloc(size_t count, size_t size) {
+    alloc_count++;
+    return __real_calloc(count, size);
+}
+
+void* __wrap_realloc(void *ptr, size_t size) {
+    alloc_count++;
+    return __real_realloc(ptr, size);
+}
+
+void __wrap_free(void *ptr) {
+    alloc_count += (ptr != NULL);
+    __real_free(ptr);
+}
+#endif
+
+#endif /* BRITER_TEST_H_ */
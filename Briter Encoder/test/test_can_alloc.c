@@ -0,0 +1,72 @@
+/**
+ * @file   test_can_alloc.c
+ * @brief  One million CAN read through mailbox, queue and dispatch without
+ *         a single allocator call. Linked with --wrap of malloc family.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "briter_encoder_can.h"
+#include "briter_host_encoder.h"
+#define BRITER_TEST_ALLOC_WRAP
+#include "briter_test.h"
+
+#define READ_COUNT	1000000UL
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &header, data) == HAL_OK)
+	BRITER_CAN_Dispatch(hcan, &header, data);
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *hcan) {
+    BRITER_CAN_TxQueue_Callback(hcan);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *hcan) {
+    BRITER_CAN_TxQueue_Callback(hcan);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *hcan) {
+    BRITER_CAN_TxQueue_Callback(hcan);
+}
+
+int main(void) {
+    static CAN_HandleTypeDef hcan;
+    static Briter_Host_Encoder_t encoder;
+    static Briter_CAN_Handler_t handler;
+    static Briter_Sample_Ring_t ring;
+    Briter_Sample_t sample;
+    uint32_t sample_count = 0;
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, 1000000);
+    BRITER_Host_Encoder_Init(&encoder, 1);
+    encoder.latency_us = 20;
+    BRITER_Host_Encoder_Attach_CAN(&encoder, &hcan);
+    BRITER_Host_Encoder_SetMotion(&encoder, 0, 100000);
+    CHECK(BRITER_CAN_Init(&handler, 1, &hcan) == HAL_OK);
+    CHECK(BRITER_CAN_Register(&handler) == HAL_OK);
+    CHECK(BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 1) == HAL_OK);
+    CHECK(BRITER_CAN_TxQueue_Enable(&hcan) == HAL_OK);
+    BRITER_Sample_Ring_Init(&ring);
+    CHECK(BRITER_CAN_AttachRing(&handler, &ring) == HAL_OK);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING | CAN_IT_TX_MAILBOX_EMPTY);
+    //Setup may allocate, count read path only
+    alloc_count = 0;
+    for (uint32_t i = 0; i < READ_COUNT; i++) {
+	if (BRITER_CAN_ReadValue(&handler) != HAL_OK)
+	    failed = 1;
+	BRITER_Host_Run(500);
+	while (BRITER_CAN_ReadSample(&handler, &sample))
+	    sample_count++;
+    }
+    uint32_t read_alloc = alloc_count;
+    CHECK(read_alloc == 0);
+    CHECK(handler.sequence == READ_COUNT);
+    CHECK(sample_count == READ_COUNT);
+    printf("%lu read, %lu allocator call\n", (unsigned long) READ_COUNT, (unsigned long) read_alloc);
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
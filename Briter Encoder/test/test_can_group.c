@@ -0,0 +1,148 @@
+/**
+ * @file   test_can_group.c
+ * @brief  Time aligned CAN group larger than mailbox count through transmit
+ *         queue, completion, skew, incomplete trigger and interpolation,
+ *         against virtual encoders and TTCM timestamp of simulated HAL.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include "briter_encoder_can_group.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+#define MEMBER	5
+#define BPS	500000
+
+static CAN_HandleTypeDef hcan;
+static volatile uint8_t done;
+static uint32_t callback_count;
+static uint32_t rx_count;
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *h) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(h, CAN_RX_FIFO0, &header, data) != HAL_OK)
+	return;
+    rx_count++;
+    BRITER_CAN_Dispatch(h, &header, data);
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *h) {
+    BRITER_CAN_TxComplete_Callback(h, CAN_TX_MAILBOX0);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *h) {
+    BRITER_CAN_TxComplete_Callback(h, CAN_TX_MAILBOX1);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *h) {
+    BRITER_CAN_TxComplete_Callback(h, CAN_TX_MAILBOX2);
+}
+
+static void Complete(void *context, const Briter_CAN_Group_Snapshot_t *snapshot) {
+    (void) context;
+    (void) snapshot;
+    callback_count++;
+    done = 1;
+}
+
+//Trigger and wait for snapshot, 0 if it never complete
+static uint8_t Sample(Briter_CAN_Group_t *group) {
+    done = 0;
+    CHECK(BRITER_CAN_Group_Trigger(group) == HAL_OK);
+    return BRITER_Host_RunUntil(&done, 5000);
+}
+
+//CAN timer now, same count as TTCM
+static uint16_t Timer_Now(void) {
+    return (uint16_t) (BRITER_Host_Time_ns() * BPS / 1000000000ULL);
+}
+
+int main(void) {
+    static Briter_Host_Encoder_t encoder[MEMBER];
+    static Briter_CAN_Handler_t handler[MEMBER];
+    static Briter_CAN_Group_t group;
+    Briter_CAN_Group_Snapshot_t first;
+    Briter_CAN_Group_Snapshot_t second;
+    Briter_CAN_Queue_Stats_t stats;
+    uint32_t position[BRITER_CAN_GROUP_MAX];
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, BPS);
+    BRITER_CAN_Group_Init(&group, Complete, NULL);
+    for (uint8_t i = 0; i < MEMBER; i++) {
+	BRITER_Host_Encoder_Init(&encoder[i], (uint8_t) (i + 1));
+	BRITER_Host_Encoder_Attach_CAN(&encoder[i], &hcan);
+	BRITER_CAN_Init(&handler[i], (uint8_t) (i + 1), &hcan);
+	BRITER_CAN_Register(&handler[i]);
+	CHECK(BRITER_CAN_Group_Add(&group, &handler[i]) == HAL_OK);
+    }
+    //Every axis its own speed, last one cross the multi turn wrap
+    uint32_t modulus = handler[0].model->modulus;
+    BRITER_Host_Encoder_SetMotion(&encoder[0], 1000, 2000);
+    BRITER_Host_Encoder_SetMotion(&encoder[1], 30000, -3000);
+    BRITER_Host_Encoder_SetMotion(&encoder[2], 50000, 0);
+    BRITER_Host_Encoder_SetMotion(&encoder[3], 70000, 1000);
+    BRITER_Host_Encoder_SetMotion(&encoder[4], modulus - 30, 5000);
+    CHECK(BRITER_CAN_Group_Add(&group, &handler[0]) == HAL_ERROR);
+    //Four address per bank
+    CHECK(BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 2) == HAL_OK);
+    BRITER_CAN_TxQueue_Enable(&hcan);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    CHECK(BRITER_CAN_Group_GetSnapshot(&group, &first) == HAL_ERROR);
+
+    //Two request wait in queue, snapshot complete only with every member
+    CHECK(Sample(&group));
+    CHECK(callback_count == 1);
+    CHECK(BRITER_CAN_TxQueue_GetStats(&hcan, &stats) == HAL_OK);
+    CHECK(stats.high_water[BRITER_CAN_PRIORITY_READ] == MEMBER - 3 && stats.dropped[BRITER_CAN_PRIORITY_READ] == 0);
+    CHECK(BRITER_CAN_Group_GetSnapshot(&group, &first) == HAL_OK && first.sequence == 1);
+    CHECK(BRITER_CAN_Group_Interpolate(&group, first.tx_time[0], position) == HAL_ERROR);
+    //Request leave in order, skew is first to last, at least back-to-back
+    //request and at most one response slipped in after each
+    uint32_t request_bit = (uint32_t) (BRITER_Host_CAN_FrameTime_ns(&hcan, 4) * BPS / 1000000000ULL);
+    uint32_t response_bit = (uint32_t) (BRITER_Host_CAN_FrameTime_ns(&hcan, 7) * BPS / 1000000000ULL);
+    for (uint8_t i = 1; i < MEMBER; i++)
+	CHECK((int16_t) (first.tx_time[i] - first.tx_time[i - 1]) >= (int16_t) request_bit);
+    CHECK(first.skew == (uint16_t) (first.tx_time[MEMBER - 1] - first.tx_time[0]));
+    CHECK(first.skew >= (MEMBER - 1) * request_bit && first.skew <= (MEMBER - 1) * (request_bit + response_bit));
+    CHECK(group.skew_max == first.skew);
+    for (uint8_t i = 0; i < MEMBER; i++)
+	CHECK((int16_t) (first.rx_time[i] - first.tx_time[i]) > (int16_t) request_bit);
+
+    //Member not answering leave trigger incomplete, counted on next trigger
+    BRITER_Host_Run(5000);
+    encoder[2].drop_ppm = 1000000;
+    CHECK(!Sample(&group));
+    CHECK(callback_count == 1 && group.incomplete == 0);
+    encoder[2].drop_ppm = 0;
+    CHECK(Sample(&group));
+    CHECK(group.incomplete == 1);
+    CHECK(BRITER_CAN_Group_GetSnapshot(&group, &second) == HAL_OK && second.sequence == 2);
+    CHECK(group.skew_max == (first.skew > second.skew ? first.skew : second.skew));
+
+    //Every axis at one CAN time 3 ms after, value latched at request end so
+    //allow one request frame of travel
+    BRITER_Host_Run(3000);
+    uint16_t now = Timer_Now();
+    CHECK(BRITER_CAN_Group_Interpolate(&group, now, position) == HAL_OK);
+    for (uint8_t i = 0; i < MEMBER; i++) {
+	int32_t error = BRITER_Model_Delta(handler[i].model, position[i], BRITER_Host_Encoder_GetValue(&encoder[i]));
+	CHECK(position[i] < modulus);
+	CHECK(error >= -3 && error <= 3);
+    }
+    CHECK(second.position[MEMBER - 1] < first.position[MEMBER - 1]);
+
+    //Fewer encoder fit in first bank, second one no longer pass old ID
+    BRITER_CAN_Unregister(&handler[MEMBER - 1]);
+    CHECK(BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 2) == HAL_OK);
+    rx_count = 0;
+    CHECK(BRITER_CAN_ReadValue(&handler[0]) == HAL_OK && BRITER_CAN_ReadValue(&handler[MEMBER - 1]) == HAL_OK);
+    BRITER_Host_Run(2000);
+    CHECK(rx_count == 1 && encoder[MEMBER - 1].stats.reply > 0);
+
+    for (uint8_t i = 0; i < MEMBER - 1; i++)
+	BRITER_CAN_Unregister(&handler[i]);
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
@@ -0,0 +1,106 @@
+/**
+ * @file   test_can_queue.c
+ * @brief  Software transmit queue behind full CAN mailboxes, read ahead of
+ *         waiting setting, depth, high water and drop counter.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include "briter_encoder_can.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+#define SNIFF_MAX	32
+
+static CAN_HandleTypeDef hcan;
+static uint8_t sniff[SNIFF_MAX];
+static uint32_t sniff_count;
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *h) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(h, CAN_RX_FIFO0, &header, data) == HAL_OK)
+	BRITER_CAN_Dispatch(h, &header, data);
+}
+
+void HAL_CAN_TxMailbox0CompleteCallback(CAN_HandleTypeDef *h) {
+    BRITER_CAN_TxQueue_Callback(h);
+}
+
+void HAL_CAN_TxMailbox1CompleteCallback(CAN_HandleTypeDef *h) {
+    BRITER_CAN_TxQueue_Callback(h);
+}
+
+void HAL_CAN_TxMailbox2CompleteCallback(CAN_HandleTypeDef *h) {
+    BRITER_CAN_TxQueue_Callback(h);
+}
+
+//Command of every MCU frame in bus order
+static void Sniff(void *context, CAN_HandleTypeDef *h, const CAN_TxHeaderTypeDef *header, const uint8_t *data) {
+    (void) context;
+    (void) h;
+    (void) header;
+    if (sniff_count < SNIFF_MAX)
+	sniff[sniff_count] = data[2];
+    sniff_count++;
+}
+
+int main(void) {
+    static Briter_Host_Encoder_t encoder;
+    static Briter_CAN_Handler_t handler;
+    Briter_CAN_Queue_Stats_t stats;
+    uint32_t position;
+    uint32_t age;
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, 500000);
+    BRITER_Host_Encoder_Init(&encoder, 1);
+    BRITER_Host_Encoder_Attach_CAN(&encoder, &hcan);
+    BRITER_Host_CAN_Attach(&hcan, Sniff, NULL);
+    BRITER_Host_Encoder_SetMotion(&encoder, 4321, 0);
+    BRITER_CAN_Init(&handler, 1, &hcan);
+    BRITER_CAN_Register(&handler);
+    BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 1);
+    CHECK(BRITER_CAN_TxQueue_GetStats(&hcan, &stats) == HAL_ERROR);
+    CHECK(BRITER_CAN_TxQueue_Enable(&hcan) == HAL_OK);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    //Three setting take every mailbox, two more wait, then one read
+    for (uint8_t i = 0; i < 5; i++)
+	CHECK(BRITER_CAN_SetZero(&handler) == HAL_OK);
+    CHECK(HAL_CAN_GetTxMailboxesFreeLevel(&hcan) == 0);
+    CHECK(BRITER_CAN_ReadValue(&handler) == HAL_OK);
+    CHECK(BRITER_CAN_TxQueue_GetStats(&hcan, &stats) == HAL_OK);
+    CHECK(stats.depth[BRITER_CAN_PRIORITY_READ] == 1 && stats.depth[BRITER_CAN_PRIORITY_CONFIG] == 2);
+    CHECK(stats.queued[BRITER_CAN_PRIORITY_READ] == 1 && stats.queued[BRITER_CAN_PRIORITY_CONFIG] == 2);
+    CHECK(stats.high_water[BRITER_CAN_PRIORITY_READ] == 1 && stats.high_water[BRITER_CAN_PRIORITY_CONFIG] == 2);
+    CHECK(stats.dropped[BRITER_CAN_PRIORITY_READ] == 0 && stats.dropped[BRITER_CAN_PRIORITY_CONFIG] == 0);
+    BRITER_Host_Run(5000);
+    //Read take first mailbox freed, same ID so lowest mailbox win and it
+    //leave ahead of setting in mailbox and queued before it
+    CHECK(sniff_count == 6);
+    CHECK(sniff[0] == BRITER_CAN_SET_ZERO && sniff[1] == BRITER_CAN_GET_VALUE);
+    for (uint8_t i = 2; i < 6; i++)
+	CHECK(sniff[i] == BRITER_CAN_SET_ZERO);
+    //Value was zeroed by the first setting
+    CHECK(BRITER_CAN_GetLatest(&handler, &position, &age) == HAL_OK && position == 0);
+    CHECK(BRITER_CAN_TxQueue_GetStats(&hcan, &stats) == HAL_OK);
+    CHECK(stats.depth[BRITER_CAN_PRIORITY_READ] == 0 && stats.depth[BRITER_CAN_PRIORITY_CONFIG] == 0);
+    CHECK(stats.high_water[BRITER_CAN_PRIORITY_CONFIG] == 2);
+    //Full queue reject frame and count it, mailbox then queue
+    CHECK(BRITER_CAN_TxQueue_ResetStats(&hcan) == HAL_OK);
+    for (uint8_t i = 0; i < 3 + BRITER_CAN_TX_QUEUE_SIZE; i++)
+	CHECK(BRITER_CAN_SetZero(&handler) == HAL_OK);
+    CHECK(BRITER_CAN_SetZero(&handler) == HAL_ERROR);
+    CHECK(BRITER_CAN_TxQueue_GetStats(&hcan, &stats) == HAL_OK);
+    CHECK(stats.depth[BRITER_CAN_PRIORITY_CONFIG] == BRITER_CAN_TX_QUEUE_SIZE);
+    CHECK(stats.high_water[BRITER_CAN_PRIORITY_CONFIG] == BRITER_CAN_TX_QUEUE_SIZE);
+    CHECK(stats.dropped[BRITER_CAN_PRIORITY_CONFIG] == 1 && stats.dropped[BRITER_CAN_PRIORITY_READ] == 0);
+    //Read queue is its own, still take read
+    CHECK(BRITER_CAN_ReadValue(&handler) == HAL_OK);
+    BRITER_Host_Run(10000);
+    CHECK(BRITER_CAN_TxQueue_GetStats(&hcan, &stats) == HAL_OK);
+    CHECK(stats.depth[BRITER_CAN_PRIORITY_READ] == 0 && stats.depth[BRITER_CAN_PRIORITY_CONFIG] == 0);
+    CHECK(handler.sequence == 2);
+    BRITER_CAN_Unregister(&handler);
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
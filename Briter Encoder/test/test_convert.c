@@ -0,0 +1,142 @@
+/**
+ * @file   test_convert.c
+ * @brief  Fixed point conversion against double over full range, DSP path
+ *         arithmetic emulated on host, and cycle against naive float.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include <stdlib.h>
+#include "briter_encoder_convert.h"
+#include "briter_test.h"
+
+#define BENCH_SIZE	4096
+#define BENCH_ROUND	2000
+
+/** Unit under test, per revolution in BRITER_CONVERT_UNIT_Q*/
+static const struct {
+    const char *name;
+    uint64_t unit_per_rev;
+} unit[] = {
+    { "radian", BRITER_CONVERT_RADIAN },
+    { "degree", BRITER_CONVERT_DEGREE },
+    { "lead_5mm", 5ULL << BRITER_CONVERT_UNIT_Q },
+};
+
+/** Smaller variant, as a BRITER_MODEL_USER_LIST line would give*/
+static const Briter_Model_t model_1024x16 = { 1024, 16, 1024 * 16, 1, 3, NULL };
+
+/**
+ * @brief  SMMULR of Cortex-M4 DSP extension.
+ * @param  a first operand
+ * @param  b second operand
+ * @retval (a * b + 0x80000000) >> 32
+ */
+static int32_t SMMULR(int32_t a, int32_t b) {
+    return (int32_t) (((int64_t) a * b + 0x80000000LL) >> 32);
+}
+
+/**
+ * @brief  Exact value rounded to output LSB.
+ * @param  model model descriptor
+ * @param  unit_per_rev unit per revolution
+ * @param  count position
+ * @retval value in BRITER_CONVERT_Q
+ */
+static int64_t Reference(const Briter_Model_t *model, uint64_t unit_per_rev, int32_t count) {
+    double value = (double) count * (double) unit_per_rev / ((double) model->ppr * (double) (1ULL << (BRITER_CONVERT_UNIT_Q - BRITER_CONVERT_Q)));
+    return llround(value);
+}
+
+static void Test_Accuracy(const Briter_Model_t *model, const char *model_name) {
+    static uint32_t count[24 * 4096];
+    static int32_t out[24 * 4096];
+    static const Briter_Convert_t *gather_conv[24 * 4096];
+    static int32_t gather_out[24 * 4096];
+    for (uint32_t i = 0; i < model->modulus; i++)
+	count[i] = i;
+    for (uint8_t u = 0; u < sizeof(unit) / sizeof(unit[0]); u++) {
+	Briter_Convert_t conv;
+	CHECK(BRITER_Convert_Init(&conv, model, unit[u].unit_per_rev) == HAL_OK);
+	//Every built-in range take DSP path on target
+	CHECK(conv.msw_shift != BRITER_CONVERT_MSW_NONE);
+	BRITER_Convert_Array(&conv, count, out, model->modulus);
+	for (uint32_t i = 0; i < model->modulus; i++)
+	    gather_conv[i] = &conv;
+	BRITER_Convert_Gather(gather_conv, count, gather_out, model->modulus);
+	int64_t error_max = 0;
+	int64_t dsp_error_max = 0;
+	double float_error_max = 0;
+	uint32_t mismatch = 0;
+	//Naive float, one division per revolution folded as most consumer do
+	float float_scale = (float) ((double) unit[u].unit_per_rev / 4294967296.0 / model->ppr);
+	for (uint32_t i = 0; i < model->modulus; i++) {
+	    int64_t ref = Reference(model, unit[u].unit_per_rev, (int32_t) i);
+	    int64_t error = llabs(out[i] - ref);
+	    error_max = error > error_max ? error : error_max;
+	    mismatch += (gather_out[i] != out[i]);
+	    mismatch += (BRITER_Convert(&conv, (int32_t) i) != out[i]);
+	    //Signed motion
+	    error = llabs(BRITER_Convert(&conv, -(int32_t) i) + ref);
+	    error_max = error > error_max ? error : error_max;
+	    error = llabs(SMMULR((int32_t) (i << conv.msw_shift), conv.msw_scale) - ref);
+	    dsp_error_max = error > dsp_error_max ? error : dsp_error_max;
+	    double float_error = fabs((double) ((float) i * float_scale * 65536.0f) - (double) ref);
+	    float_error_max = float_error > float_error_max ? float_error : float_error_max;
+	}
+	CHECK(error_max <= 1);
+	CHECK(dsp_error_max <= 1);
+	CHECK(mismatch == 0);
+	//accuracy,<model>,<unit>,<max LSB error fixed>,<max LSB error DSP>,<max LSB error float>
+	printf("accuracy,%s,%s,%lld,%lld,%.2f\n", model_name, unit[u].name, (long long) error_max, (long long) dsp_error_max, float_error_max);
+    }
+}
+
+static void Test_Range(void) {
+    Briter_Convert_t conv;
+    //Output of full range do not fit int32
+    static const Briter_Model_t huge = { 1, 0x10000, 0x10000, 1, 3, NULL };
+    CHECK(BRITER_Convert_Init(&conv, &huge, BRITER_CONVERT_DEGREE) == HAL_ERROR);
+    static const Briter_Model_t no_turn = { 4096, 0, 0, 1, 3, NULL };
+    CHECK(BRITER_Convert_Init(&conv, &no_turn, BRITER_CONVERT_DEGREE) == HAL_ERROR);
+    CHECK(BRITER_Convert_Init(&conv, BRITER_MODEL(CAN_4096X24), 0) == HAL_ERROR);
+}
+
+static void Bench(void) {
+    static uint32_t count[BENCH_SIZE];
+    static int32_t out[BENCH_SIZE];
+    static float out_float[BENCH_SIZE];
+    const Briter_Model_t *model = BRITER_MODEL(CAN_4096X24);
+    Briter_Convert_t conv;
+    BRITER_Convert_Init(&conv, model, BRITER_CONVERT_RADIAN);
+    uint32_t seed = 1;
+    for (uint32_t i = 0; i < BENCH_SIZE; i++)
+	count[i] = BRITER_Host_Random(&seed) % model->modulus;
+    CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+    DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+    uint32_t start = DWT->CYCCNT;
+    for (uint32_t r = 0; r < BENCH_ROUND; r++)
+	BRITER_Convert_Array(&conv, count, out, BENCH_SIZE);
+    uint32_t fixed_cycle = DWT->CYCCNT - start;
+    //Naive float, division per sample
+    start = DWT->CYCCNT;
+    for (uint32_t r = 0; r < BENCH_ROUND; r++) {
+	for (uint32_t i = 0; i < BENCH_SIZE; i++)
+	    out_float[i] = (float) count[i] * 6.28318531f / (float) model->ppr;
+	__asm volatile ("" : : "r" (out_float) : "memory");
+    }
+    uint32_t float_cycle = DWT->CYCCNT - start;
+    //convert,<implementation>,<cycle per sample>
+    printf("convert,fixed_array,%.3f\n", (double) fixed_cycle / BENCH_ROUND / BENCH_SIZE);
+    printf("convert,naive_float,%.3f\n", (double) float_cycle / BENCH_ROUND / BENCH_SIZE);
+}
+
+int main(void) {
+    Test_Accuracy(BRITER_MODEL(RS485_4096X24), "4096x24");
+    Test_Accuracy(&model_1024x16, "1024x16");
+    Test_Range();
+    Bench();
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
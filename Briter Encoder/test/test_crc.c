@@ -0,0 +1,102 @@
+/**
+ * @file   test_crc.c
+ * @brief  Table CRC-16/Modbus against the bitwise one it replaced, and time
+ *         per byte of both. Built once per BRITER_CRC16_SLICE.
+ * @author Ang Chin Xian
+ *
+ * Only the host HAL header is needed, not its library:
+ *   cc -O2 -I.. -I../host -DBRITER_HAL_HEADER='"briter_host_hal.h"' \
+ *      -DBRITER_CRC16_SLICE=4 test_crc.c ../briter_encoder_crc.c
+ */
+
+#include <stdio.h>
+#include <time.h>
+#include "briter_encoder_crc.h"
+#include "briter_test.h"
+
+static uint64_t Time_ns(void) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (uint64_t) now.tv_sec * 1000000000ULL + (uint64_t) now.tv_nsec;
+}
+
+/**
+ * @brief  Calculate_CRC() of RS485 driver before table engine, kept as reference.
+ * @param  pbuf pointer to buffer
+ * @param  num size of buffer
+ * @retval CRC value
+ */
+static uint16_t Calculate_CRC(const uint8_t pbuf[], uint16_t num) {
+    uint16_t i;
+    uint8_t j;
+    uint16_t wcrc = 0xffff;
+    for (i = 0; i < num; i++) {
+	wcrc ^= (uint16_t) (pbuf[i]);
+	for (j = 0; j < 8; j++) {
+	    if (wcrc & 0x0001) {
+		wcrc >>= 1;
+		wcrc ^= 0xa001;
+	    }
+	    else
+		wcrc >>= 1;
+	}
+    }
+    return wcrc;
+}
+
+static void Test_Exact(void) {
+    static uint8_t buf[1024 + 4];
+    uint32_t seed = 1;
+    for (uint16_t i = 0; i < sizeof(buf); i++) {
+	seed = seed * 1664525U + 1013904223U;
+	buf[i] = (uint8_t) (seed >> 24);
+    }
+    //Check value of CRC-16/Modbus
+    CHECK(BRITER_CRC16_Calculate((const uint8_t*) "123456789", 9) == 0x4B37);
+    //Every length and alignment, slice loop and byte tail both used
+    for (uint16_t offset = 0; offset < 4; offset++) {
+	for (uint16_t num = 0; num <= 1024; num++)
+	    CHECK(BRITER_CRC16_Calculate(&buf[offset], num) == Calculate_CRC(&buf[offset], num));
+    }
+    //Running CRC over split buffer and byte by byte
+    for (uint16_t split = 0; split <= 64; split++) {
+	uint16_t crc = BRITER_CRC16_Update(BRITER_CRC16_INIT, buf, split);
+	CHECK(BRITER_CRC16_Update(crc, &buf[split], (uint16_t) (64 - split)) == Calculate_CRC(buf, 64));
+    }
+    uint16_t crc = BRITER_CRC16_INIT;
+    for (uint16_t i = 0; i < 64; i++)
+	crc = BRITER_CRC16_UpdateByte(crc, buf[i]);
+    CHECK(crc == Calculate_CRC(buf, 64));
+    //Frame with its CRC appended leave 0
+    crc = Calculate_CRC(buf, 6);
+    buf[6] = (uint8_t) crc;
+    buf[7] = (uint8_t) (crc >> 8);
+    CHECK(BRITER_CRC16_Calculate(buf, 8) == 0);
+}
+
+static void Bench(void) {
+    static const uint16_t size[] = { 6, 8, 37, 256 };
+    static uint8_t buf[256];
+    volatile uint16_t sink = 0;
+    for (uint8_t i = 0; i < sizeof(size) / sizeof(size[0]); i++) {
+	uint32_t round = 200000 / size[i];
+	uint64_t start = Time_ns();
+	for (uint32_t r = 0; r < round; r++)
+	    sink ^= Calculate_CRC(buf, size[i]);
+	uint64_t bitwise = Time_ns() - start;
+	start = Time_ns();
+	for (uint32_t r = 0; r < round; r++)
+	    sink ^= BRITER_CRC16_Calculate(buf, size[i]);
+	uint64_t table = Time_ns() - start;
+	printf("crc,slice%d,%u,%.2f,%.2f\n", BRITER_CRC16_SLICE, size[i], (double) bitwise / round / size[i], (double) table / round / size[i]);
+    }
+    (void) sink;
+}
+
+int main(void) {
+    Test_Exact();
+    //crc,<slice>,<byte>,<bitwise ns/byte>,<table ns/byte>
+    Bench();
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
@@ -0,0 +1,73 @@
+/**
+ * @file   test_estimator.c
+ * @brief  Estimator convergence on constant velocity and acceleration ramp,
+ *         across modulus wrap and with full 32 bit position, sample interval
+ *         jittered around nominal period.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include <math.h>
+#include "briter_encoder_estimator.h"
+#include "briter_test.h"
+
+#define PERIOD	10
+#define SAMPLES	1000
+
+/** Motion in count and period, from t = 0*/
+typedef struct {
+    const char *name;
+    uint32_t modulus; /*!< 0 for full 32 bit*/
+    double start;
+    double velocity; /*!< Count per period*/
+    double acceleration; /*!< Count per period^2*/
+    int64_t wrap_min; /*!< Modulus wrap the ramp must cross at least*/
+} Ramp_t;
+
+static const Ramp_t ramp[] = {
+    { "velocity", 98304, 1000.0, 37.3, 0.0, 0 },
+    { "acceleration", 98304, 500.0, -20.0, 0.15, 0 },
+    { "wrap", 4096, 100.0, -53.7, 0.0, 10 },
+    { "full_32bit", 0, 4294967296.0 - 20000.0, 41.9, 0.0, 1 },
+};
+
+static void Test_Ramp(const Ramp_t *r) {
+    Briter_Estimator_t estimator;
+    double modulus = r->modulus ? (double) r->modulus : 4294967296.0;
+    double t = 0.0;
+    uint32_t tick = 0;
+    CHECK(BRITER_Estimator_Init(&estimator, r->modulus, PERIOD, BRITER_ESTIMATOR_ALPHA_DEFAULT, BRITER_ESTIMATOR_BETA_DEFAULT, BRITER_ESTIMATOR_GAMMA_DEFAULT) == HAL_OK);
+    for (uint32_t i = 0; i < SAMPLES; i++) {
+	//Nominal period with +-2 tick jitter
+	tick += PERIOD - 2 + (i * 7) % 5;
+	t = (double) tick / PERIOD;
+	double position = r->start + r->velocity * t + 0.5 * r->acceleration * t * t;
+	BRITER_Estimator_Update(&estimator, (uint32_t) fmod(fmod(floor(position), modulus) + modulus, modulus), tick);
+    }
+    double end = r->start + r->velocity * t + 0.5 * r->acceleration * t * t;
+    double wrap = fabs(floor(end / modulus) - floor(r->start / modulus));
+    double velocity = r->velocity + r->acceleration * t;
+    double v = BRITER_Estimator_GetVelocity(&estimator) / 65536.0;
+    double a = BRITER_Estimator_GetAcceleration(&estimator) / 65536.0;
+    double error = fmod(floor(end) - BRITER_Estimator_GetPosition(&estimator), modulus);
+    if (error > modulus / 2)
+	error -= modulus;
+    if (error < -modulus / 2)
+	error += modulus;
+    printf("%-12s v %10.3f / %10.3f  a %7.4f / %7.4f  position error %.0f  wrap %.0f\n", r->name, v, velocity, a, r->acceleration, error, wrap);
+    CHECK(wrap >= r->wrap_min);
+    CHECK(fabs(v - velocity) <= 0.002 * fabs(velocity) + 0.1);
+    CHECK(fabs(a - r->acceleration) <= 0.015);
+    CHECK(fabs(error) <= 2);
+    CHECK(BRITER_Estimator_GetPosition(&estimator) < modulus);
+}
+
+int main(void) {
+    Briter_Estimator_t estimator;
+    CHECK(BRITER_Estimator_Init(&estimator, 4096, 0, BRITER_ESTIMATOR_ALPHA_DEFAULT, 0, 0) == HAL_ERROR);
+    CHECK(BRITER_Estimator_Init(&estimator, 4096, PERIOD, 0x10001, 0, 0) == HAL_ERROR);
+    for (uint8_t i = 0; i < sizeof(ramp) / sizeof(ramp[0]); i++)
+	Test_Ramp(&ramp[i]);
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
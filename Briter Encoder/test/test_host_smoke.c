@@ -0,0 +1,195 @@
+/**
+ * @file   test_host_smoke.c
+ * @brief  RS485 polling, bus scheduler and CAN read against virtual encoder,
+ *         with injected error seen in driver statistic, and CAN address
+ *         change through transport independent interface.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_rs485_bus.h"
+#include "briter_encoder_can.h"
+#include "briter_encoder.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+static UART_HandleTypeDef huart;
+static DMA_HandleTypeDef hdma_tx;
+static DMA_HandleTypeDef hdma_rx;
+static CAN_HandleTypeDef hcan;
+static Briter_RS485_Bus_t bus;
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *h) {
+    BRITER_RS485_Bus_TxCpltCallback(&bus, h);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *h, uint16_t Size) {
+    BRITER_RS485_Bus_RxEventCallback(&bus, h, Size);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *h) {
+    BRITER_RS485_Bus_ErrorCallback(&bus, h);
+}
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *h) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(h, CAN_RX_FIFO0, &header, data) == HAL_OK)
+	BRITER_CAN_Dispatch(h, &header, data);
+}
+
+static void Test_RS485_Polling(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_Encoder_t handler;
+    Briter_Stats_t stats;
+    BRITER_Host_Reset();
+    BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, 9600);
+    BRITER_Host_Encoder_Init(&encoder, 1);
+    BRITER_Host_Encoder_Attach_RS485(&encoder, &huart);
+    BRITER_Host_Encoder_SetMotion(&encoder, 12345, 0);
+    CHECK(BRITER_RS485_Init(&handler, 1, &huart) == HAL_OK);
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) == 12345);
+    CHECK(BRITER_RS485_SetZero(&handler) == HAL_OK);
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) == 0);
+    CHECK(BRITER_RS485_SetPosition(&handler, 70000) == HAL_OK);
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) == 70000);
+    //Echo leave at old address, then encoder move
+    CHECK(BRITER_RS485_SetAddress(&handler, 7) == HAL_OK);
+    CHECK(encoder.address == 7);
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) == 70000);
+    //Value keep moving between request
+    BRITER_Host_Encoder_SetMotion(&encoder, 1000, 4096);
+    BRITER_Host_Run(500000);
+    uint32_t value = BRITER_RS485_GetEncoderValue(&handler);
+    CHECK(value >= 1000 + 2048 && value <= 1000 + 2048 + 100);
+    //Lost request and corrupted reply are failure of their own class
+    BRITER_RS485_ResetStats(&handler);
+    encoder.drop_ppm = 1000000;
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) == (uint32_t) BRITER_RS485_ERROR);
+    encoder.drop_ppm = 0;
+    encoder.crc_ppm = 1000000;
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) == (uint32_t) BRITER_RS485_ERROR);
+    encoder.crc_ppm = 0;
+    CHECK(BRITER_RS485_GetEncoderValue(&handler) != (uint32_t) BRITER_RS485_ERROR);
+    BRITER_RS485_GetStats(&handler, &stats);
+    CHECK(stats.count[BRITER_STATS_RX_TIMEOUT] == 1);
+    CHECK(stats.count[BRITER_STATS_CRC] == 1);
+    CHECK(stats.count[BRITER_STATS_OK] == 1);
+    CHECK(encoder.stats.dropped == 1 && encoder.stats.corrupted == 1);
+}
+
+static void Test_RS485_Bus(void) {
+    Briter_Host_Encoder_t encoder[2];
+    Briter_Encoder_t handler[2];
+    Briter_Stats_t stats;
+    uint32_t total = 0;
+    BRITER_Host_Reset();
+    hdma_rx.Init.Mode = DMA_NORMAL;
+    BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, 115200);
+    CHECK(BRITER_RS485_Bus_Init(&bus, &huart, 5) == HAL_OK);
+    for (uint8_t i = 0; i < 2; i++) {
+	BRITER_Host_Encoder_Init(&encoder[i], (uint8_t) (i + 1));
+	BRITER_Host_Encoder_Attach_RS485(&encoder[i], &huart);
+	BRITER_Host_Encoder_SetMotion(&encoder[i], 100U * (i + 1), 0);
+	encoder[i].noise_ppm = 20000;
+	CHECK(BRITER_RS485_Init(&handler[i], (uint8_t) (i + 1), &huart) == HAL_OK);
+	CHECK(BRITER_RS485_Bus_Add(&bus, &handler[i], 0) == HAL_OK);
+    }
+    CHECK(BRITER_RS485_Bus_Start(&bus) == HAL_OK);
+    for (uint32_t ms = 0; ms < 1000; ms++) {
+	BRITER_Host_Run(1000);
+	BRITER_RS485_Bus_Process(&bus);
+    }
+    BRITER_RS485_Bus_Stop(&bus);
+    for (uint8_t i = 0; i < 2; i++) {
+	uint32_t value;
+	uint32_t timestamp;
+	CHECK(BRITER_RS485_Bus_GetLatest(&bus, &handler[i], &value, &timestamp) == HAL_OK);
+	CHECK(value == 100U * (i + 1));
+	BRITER_RS485_GetStats(&handler[i], &stats);
+	//No inter-frame timer, every request wait t3.5 out on 1 ms process tick
+	CHECK(stats.count[BRITER_STATS_OK] > 50);
+	//Flipped bit come out as CRC or mismatch, never as wrong value
+	CHECK(stats.count[BRITER_STATS_CRC] + stats.count[BRITER_STATS_MISMATCH] > 0);
+	total += stats.count[BRITER_STATS_OK];
+    }
+    printf("bus: %lu read in 1 s at 115200 bps\n", (unsigned long) total);
+}
+
+static void Test_CAN(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_CAN_Handler_t handler;
+    Briter_Host_Line_Stats_t line;
+    uint32_t position;
+    uint32_t age;
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, 500000);
+    BRITER_Host_Encoder_Init(&encoder, 3);
+    BRITER_Host_Encoder_Attach_CAN(&encoder, &hcan);
+    BRITER_Host_Encoder_SetMotion(&encoder, 54321, 0);
+    CHECK(BRITER_CAN_Init(&handler, 3, &hcan) == HAL_OK);
+    CHECK(BRITER_CAN_Register(&handler) == HAL_OK);
+    CHECK(BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 1) == HAL_OK);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    CHECK(BRITER_CAN_GetLatest(&handler, &position, &age) == HAL_ERROR);
+    CHECK(BRITER_CAN_ReadValue(&handler) == HAL_OK);
+    BRITER_Host_Run(2000);
+    CHECK(BRITER_CAN_GetLatest(&handler, &position, &age) == HAL_OK);
+    CHECK(position == 54321);
+    //Bus error cost resend, value still arrive
+    encoder.crc_ppm = 1000000;
+    CHECK(BRITER_CAN_SetZero(&handler) == HAL_OK);
+    BRITER_Host_Run(2000);
+    CHECK(BRITER_CAN_ReadValue(&handler) == HAL_OK);
+    BRITER_Host_Run(2000);
+    CHECK(BRITER_CAN_GetLatest(&handler, &position, &age) == HAL_OK);
+    CHECK(position == 0);
+    CHECK(handler.sequence == 2);
+    BRITER_Host_CAN_GetStats(&hcan, &line);
+    CHECK(line.error == 1);
+    BRITER_CAN_Unregister(&handler);
+}
+
+static void Test_CAN_SetAddress(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_CAN_Handler_t handler;
+    Briter_CAN_Handler_t other;
+    Briter_Encoder_Dev_t dev;
+    Briter_Sample_t sample;
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, 500000);
+    BRITER_Host_Encoder_Init(&encoder, 3);
+    BRITER_Host_Encoder_Attach_CAN(&encoder, &hcan);
+    BRITER_Host_Encoder_SetMotion(&encoder, 777, 0);
+    BRITER_CAN_Init(&handler, 3, &hcan);
+    BRITER_CAN_Init(&other, 4, &hcan);
+    BRITER_CAN_Register(&handler);
+    BRITER_CAN_Register(&other);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    CHECK(BRITER_Encoder_Init_CAN(&dev, &handler) == HAL_OK);
+    //Taken by another handler, nothing is sent
+    CHECK(BRITER_Encoder_SetAddress(&dev, 4) == HAL_ERROR);
+    CHECK(BRITER_Encoder_SetAddress(&dev, BRITER_CAN_MAX_ADDRESS) == HAL_ERROR);
+    CHECK(BRITER_Encoder_SetAddress(&dev, 9) == HAL_OK);
+    BRITER_Host_Run(2000);
+    CHECK(encoder.address == 9 && handler.address == 9);
+    //Filter follow registry once configured again
+    CHECK(BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 1) == HAL_OK);
+    CHECK(BRITER_Encoder_Request(&dev) == HAL_OK);
+    BRITER_Host_Run(2000);
+    CHECK(BRITER_Encoder_Poll(&dev, &sample) && sample.position == 777);
+    //Old address is free again
+    CHECK(BRITER_CAN_SetAddress(&other, 3) == HAL_OK);
+    BRITER_CAN_Unregister(&handler);
+    BRITER_CAN_Unregister(&other);
+}
+
+int main(void) {
+    Test_RS485_Polling();
+    Test_RS485_Bus();
+    Test_CAN();
+    Test_CAN_SetAddress();
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
@@ -0,0 +1,120 @@
+/**
+ * @file   test_record_replay.c
+ * @brief  Record CAN read of two moving virtual encoders, decode capture
+ *         back and write it to capture.bin for briter_replay.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include "briter_encoder_can.h"
+#include "briter_encoder_record.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+#define READ_ROUND	500
+
+static uint8_t capture[16384];
+static uint32_t capture_len;
+static Briter_Record_Sample_t expected[2 * READ_ROUND];
+static uint32_t expected_count;
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *hcan) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(hcan, CAN_RX_FIFO0, &header, data) == HAL_OK)
+	BRITER_CAN_Dispatch(hcan, &header, data);
+}
+
+//Block go to capture as flash write would
+static void Capture_Sink(void *context, const uint8_t *data, uint32_t size) {
+    (void) context;
+    if (capture_len + size > sizeof(capture)) {
+	failed = 1;
+	return;
+    }
+    for (uint32_t i = 0; i < size; i++)
+	capture[capture_len + i] = data[i];
+    capture_len += size;
+}
+
+static void Record(void) {
+    static CAN_HandleTypeDef hcan;
+    static Briter_Host_Encoder_t encoder[2];
+    static Briter_CAN_Handler_t handler[2];
+    static Briter_Sample_Ring_t ring[2];
+    static Briter_Recorder_t rec;
+    static uint8_t buf[BRITER_RECORD_BLOCK_MAX];
+    Briter_Sample_t sample;
+    BRITER_Host_Reset();
+    BRITER_Host_CAN_Init(&hcan, 500000);
+    HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    for (uint8_t i = 0; i < 2; i++) {
+	BRITER_Host_Encoder_Init(&encoder[i], (uint8_t) (i + 1));
+	BRITER_Host_Encoder_Attach_CAN(&encoder[i], &hcan);
+	//Opposite way, one wrap through zero
+	BRITER_Host_Encoder_SetMotion(&encoder[i], 1000U + 40000U * i, i ? 3000 : -3000);
+	BRITER_CAN_Init(&handler[i], (uint8_t) (i + 1), &hcan);
+	BRITER_CAN_Register(&handler[i]);
+	BRITER_Sample_Ring_Init(&ring[i]);
+	BRITER_CAN_AttachRing(&handler[i], &ring[i]);
+    }
+    BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 1);
+    CHECK(BRITER_Record_Init(&rec, buf, sizeof(buf), Capture_Sink, NULL, 32) == HAL_OK);
+    for (uint32_t r = 0; r < READ_ROUND; r++) {
+	for (uint8_t i = 0; i < 2; i++) {
+	    //Every 50th read of encoder 2 is lost
+	    encoder[i].drop_ppm = (i == 1 && r % 50 == 49) ? 1000000 : 0;
+	    BRITER_CAN_ReadValue(&handler[i]);
+	}
+	BRITER_Host_Run(2000);
+	for (uint8_t i = 0; i < 2; i++) {
+	    Briter_Record_Sample_t *record = &expected[expected_count++];
+	    record->address = (uint8_t) (i + 1);
+	    if (BRITER_CAN_ReadSample(&handler[i], &sample)) {
+		CHECK(BRITER_Record_AddSample(&rec, (uint8_t) (i + 1), &sample) == HAL_OK);
+		record->result = BRITER_STATS_OK;
+		record->position = sample.position;
+		record->timestamp = sample.timestamp;
+	    }
+	    else {
+		record->result = BRITER_STATS_RX_TIMEOUT;
+		record->position = 0;
+		record->timestamp = HAL_GetTick();
+		CHECK(BRITER_Record_Add(&rec, record) == HAL_OK);
+	    }
+	}
+    }
+    BRITER_Record_Flush(&rec);
+    for (uint8_t i = 0; i < 2; i++)
+	BRITER_CAN_Unregister(&handler[i]);
+}
+
+static void Replay(void) {
+    Briter_Replay_t rep;
+    Briter_Record_Sample_t sample;
+    uint32_t count = 0;
+    uint32_t mismatch = 0;
+    CHECK(BRITER_Replay_Init(&rep, capture, capture_len) == HAL_OK);
+    while (BRITER_Replay_Next(&rep, &sample) == HAL_OK && count < expected_count) {
+	const Briter_Record_Sample_t *record = &expected[count++];
+	mismatch += (sample.address != record->address || sample.result != record->result || sample.timestamp != record->timestamp);
+	mismatch += (record->result == BRITER_STATS_OK && sample.position != record->position);
+    }
+    CHECK(count == expected_count);
+    CHECK(mismatch == 0);
+    CHECK(rep.bad_block_count == 0);
+    //Raw sample would take 10 byte, address, result, position and tick
+    printf("capture,%lu,%lu,%.2f\n", (unsigned long) expected_count, (unsigned long) capture_len, (double) capture_len / expected_count);
+}
+
+int main(int argc, char *argv[]) {
+    Record();
+    Replay();
+    //Capture for briter_replay, capture.bin if no path is given
+    FILE *file = fopen(argc > 1 ? argv[1] : "capture.bin", "wb");
+    CHECK(file != NULL && fwrite(capture, 1, capture_len, file) == capture_len);
+    if (file)
+	fclose(file);
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
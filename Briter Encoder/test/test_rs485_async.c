@@ -0,0 +1,193 @@
+/**
+ * @file   test_rs485_async.c
+ * @brief  Asynchronous RS485 API under a stub scheduler behind
+ *         briter_encoder_os.h, task sleep once and is woken by interrupt.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_os.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+/** Task of stub scheduler*/
+typedef struct {
+    volatile uint8_t notified; /*!< Pending notification, taken by wait*/
+    uint32_t wait; /*!< Call of BRITER_OS_Wait()*/
+    uint32_t woken; /*!< Wait ended by notification*/
+    uint64_t blocked_ns; /*!< Time left to other task*/
+} Stub_Task_t;
+
+/** Running task, NULL in interrupt and bare metal*/
+static Stub_Task_t *current;
+
+static UART_HandleTypeDef huart;
+static DMA_HandleTypeDef hdma_tx;
+static DMA_HandleTypeDef hdma_rx;
+static Briter_Encoder_t handler;
+
+void* BRITER_OS_Self(void) {
+    return current;
+}
+
+void BRITER_OS_Notify(void *waiter) {
+    ((Stub_Task_t*) waiter)->notified = 1;
+}
+
+uint8_t BRITER_OS_Wait(uint32_t timeout) {
+    Stub_Task_t *task = current;
+    uint64_t start = BRITER_Host_Time_ns();
+    task->wait++;
+    //Task is blocked, interrupt run with no task until notified
+    current = NULL;
+    uint8_t woken = BRITER_Host_RunUntil(&task->notified, timeout * 1000U);
+    current = task;
+    task->notified = 0;
+    task->woken += woken;
+    task->blocked_ns += BRITER_Host_Time_ns() - start;
+    return woken;
+}
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *h) {
+    BRITER_RS485_Async_TxCpltCallback(&handler, h);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *h, uint16_t Size) {
+    BRITER_RS485_Async_RxEventCallback(&handler, h, Size);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *h) {
+    BRITER_RS485_Async_ErrorCallback(&handler, h);
+}
+
+/** Result seen by completion callback*/
+typedef struct {
+    uint32_t count;
+    HAL_StatusTypeDef status;
+    uint32_t value;
+    uint8_t in_task; /*!< Called with a task running*/
+} Result_t;
+
+static void Async_Done(void *context, HAL_StatusTypeDef status, uint32_t value) {
+    Result_t *result = (Result_t*) context;
+    result->count++;
+    result->status = status;
+    result->value = value;
+    result->in_task = (current != NULL);
+}
+
+static void Setup(Briter_Host_Encoder_t *encoder) {
+    BRITER_Host_Reset();
+    hdma_rx.Init.Mode = DMA_NORMAL;
+    BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, 19200);
+    BRITER_Host_Encoder_Init(encoder, 1);
+    BRITER_Host_Encoder_Attach_RS485(encoder, &huart);
+    BRITER_Host_Encoder_SetMotion(encoder, 4242, 0);
+    BRITER_RS485_Init(&handler, 1, &huart);
+}
+
+static void Test_Task_Wait(void) {
+    Briter_Host_Encoder_t encoder;
+    Stub_Task_t task = { 0 };
+    Result_t result = { 0 };
+    Setup(&encoder);
+    current = &task;
+    uint64_t start = BRITER_Host_Time_ns();
+    CHECK(BRITER_RS485_GetEncoderValue_Async(&handler, Async_Done, &result) == HAL_OK);
+    //Start return before request is on the line
+    CHECK(result.count == 0);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    uint64_t elapsed = BRITER_Host_Time_ns() - start;
+    CHECK(result.count == 1 && result.status == HAL_OK && result.value == 4242);
+    CHECK(handler.encoder_value == 4242);
+    //Slept once, woken by interrupt, whole transaction left to other task
+    CHECK(task.wait == 1 && task.woken == 1);
+    CHECK(task.blocked_ns == elapsed);
+    CHECK(!result.in_task);
+    //Setter, one at a time
+    CHECK(BRITER_RS485_SetReturnTime_Async(&handler, 20, Async_Done, &result) == HAL_OK);
+    CHECK(BRITER_RS485_SetZero_Async(&handler, Async_Done, &result) == HAL_BUSY);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    CHECK(result.count == 2 && result.status == HAL_OK);
+    CHECK(encoder.return_time == 20);
+    CHECK(BRITER_RS485_SetAddress_Async(&handler, 9, Async_Done, &result) == HAL_OK);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    CHECK(encoder.address == 9);
+    CHECK(BRITER_RS485_GetEncoderValue_Async(&handler, Async_Done, &result) == HAL_OK);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    CHECK(result.value == 4242);
+    CHECK(task.wait == 4 && task.woken == 4);
+    current = NULL;
+}
+
+static void Test_Shadow_Skip(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_Host_Line_Stats_t before;
+    Briter_Host_Line_Stats_t after;
+    Stub_Task_t task = { 0 };
+    Result_t result = { 0 };
+    Setup(&encoder);
+    current = &task;
+    CHECK(BRITER_RS485_SetDirection_Async(&handler, RS485_ENC_DIRECTION_COUNTERCLOCKWISE, Async_Done, &result) == HAL_OK);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    BRITER_Host_UART_GetStats(&huart, &before);
+    //Value encoder hold, done before start return and nothing on the line
+    CHECK(BRITER_RS485_SetDirection_Async(&handler, RS485_ENC_DIRECTION_COUNTERCLOCKWISE, Async_Done, &result) == HAL_OK);
+    CHECK(result.count == 2 && result.status == HAL_OK && result.in_task);
+    //No token left behind, wait return without sleeping
+    CHECK(!task.notified);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    CHECK(task.wait == 1);
+    BRITER_Host_UART_GetStats(&huart, &after);
+    CHECK(after.tx_frame == before.tx_frame);
+    current = NULL;
+}
+
+static void Test_Timeout(void) {
+    Briter_Host_Encoder_t encoder;
+    Stub_Task_t task = { 0 };
+    Result_t result = { 0 };
+    Briter_Stats_t stats;
+    Setup(&encoder);
+    encoder.drop_ppm = 1000000;
+    current = &task;
+    uint64_t timeout_ns = (handler.tx_timeout + handler.rx_timeout) * 1000000ULL;
+    CHECK(BRITER_RS485_GetEncoderValue_Async(&handler, Async_Done, &result) == HAL_OK);
+    //Wait wake on operation timeout, well before its own, and complete it
+    CHECK(BRITER_RS485_Async_Wait(&handler, 1000) == HAL_TIMEOUT);
+    CHECK(result.count == 1 && result.status == HAL_TIMEOUT && result.in_task);
+    CHECK(task.blocked_ns >= timeout_ns && task.blocked_ns <= timeout_ns + 1000000ULL);
+    CHECK(handler.async.state == BRITER_RS485_ASYNC_IDLE);
+    BRITER_RS485_GetStats(&handler, &stats);
+    CHECK(stats.count[BRITER_STATS_RX_TIMEOUT] == 1);
+    //Line is free again
+    encoder.drop_ppm = 0;
+    CHECK(BRITER_RS485_GetEncoderValue_Async(&handler, Async_Done, &result) == HAL_OK);
+    CHECK(BRITER_RS485_Async_Wait(&handler, 100) == HAL_OK);
+    CHECK(result.status == HAL_OK && result.value == 4242);
+    current = NULL;
+}
+
+static void Test_Bare_Metal(void) {
+    Briter_Host_Encoder_t encoder;
+    Result_t result = { 0 };
+    Setup(&encoder);
+    //No task, completion only through callback from interrupt
+    CHECK(BRITER_RS485_GetEncoderValue_Async(&handler, Async_Done, &result) == HAL_OK);
+    for (uint32_t ms = 0; ms < 50 && result.count == 0; ms++) {
+	BRITER_Host_Run(1000);
+	BRITER_RS485_Async_Process(&handler);
+    }
+    CHECK(result.count == 1 && result.status == HAL_OK && result.value == 4242);
+    CHECK(handler.async.waiter == NULL);
+}
+
+int main(void) {
+    Test_Task_Wait();
+    Test_Shadow_Skip();
+    Test_Timeout();
+    Test_Bare_Metal();
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
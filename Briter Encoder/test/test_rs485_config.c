@@ -0,0 +1,154 @@
+/**
+ * @file   test_rs485_config.c
+ * @brief  Configuration transaction on the wire, frame batching, echo check,
+ *         write order and shadow skip, and block register read, against
+ *         virtual encoder.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_crc.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+#define SNIFF_MAX	16
+
+static UART_HandleTypeDef huart;
+static DMA_HandleTypeDef hdma_tx;
+static DMA_HandleTypeDef hdma_rx;
+
+/** MCU frame seen on the line*/
+typedef struct {
+    uint8_t address;
+    uint8_t func;
+    uint16_t reg;
+    uint16_t count; /*!< Register count of write multi, value of write single*/
+} Sniff_Frame_t;
+
+static Sniff_Frame_t sniff[SNIFF_MAX];
+static uint32_t sniff_count;
+static uint8_t bad_echo;
+
+static void Sniff(void *context, UART_HandleTypeDef *h, const uint8_t *frame, uint16_t size) {
+    (void) context;
+    (void) size;
+    if (sniff_count < SNIFF_MAX) {
+	Sniff_Frame_t *f = &sniff[sniff_count];
+	f->address = frame[0];
+	f->func = frame[1];
+	f->reg = (uint16_t) (frame[2] << 8 | frame[3]);
+	f->count = (uint16_t) (frame[4] << 8 | frame[5]);
+    }
+    sniff_count++;
+    //Echo with valid CRC but other value, encoder itself stay silent
+    if (bad_echo) {
+	uint8_t reply[8];
+	memcpy(reply, frame, 6);
+	reply[5] ^= 0x01;
+	uint16_t crc = BRITER_CRC16_Calculate(reply, 6);
+	reply[6] = (uint8_t) crc;
+	reply[7] = (uint8_t) (crc >> 8);
+	BRITER_Host_UART_Reply(h, BRITER_RS485_T35_us(BRITER_Host_UART_GetBaudrate(h)) + BRITER_HOST_ENCODER_LATENCY_US, reply, NULL, sizeof(reply));
+    }
+}
+
+static void Setup(Briter_Host_Encoder_t *encoder, Briter_Encoder_t *handler) {
+    BRITER_Host_Reset();
+    BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, 19200);
+    BRITER_Host_Encoder_Init(encoder, 1);
+    BRITER_Host_Encoder_Attach_RS485(encoder, &huart);
+    BRITER_Host_UART_Attach(&huart, Sniff, NULL);
+    BRITER_Host_Encoder_SetMotion(encoder, 0, 0);
+    BRITER_RS485_Init(handler, 1, &huart);
+    sniff_count = 0;
+    bad_echo = 0;
+}
+
+static void Test_Commit(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_Encoder_t handler;
+    Briter_RS485_Config_t config;
+    uint16_t value;
+    Setup(&encoder, &handler);
+    //Added out of order, address first
+    BRITER_RS485_Config_Begin(&config);
+    CHECK(BRITER_RS485_Config_Add(&config, BRITER_RS485_ADDRESS_ADDR, 5) == HAL_OK);
+    CHECK(BRITER_RS485_Config_Add(&config, BRITER_RS485_INCREASING_DIRECTION_ADDR, RS485_ENC_DIRECTION_COUNTERCLOCKWISE) == HAL_OK);
+    CHECK(BRITER_RS485_Config_Add(&config, BRITER_RS485_RETURN_TIME_ADDR, 10) == HAL_OK);
+    CHECK(BRITER_RS485_Config_Add(&config, BRITER_RS485_MODE_ADDR, RS485_ENC_MODE_QUERY) == HAL_OK);
+    //Later write to same register replace it
+    CHECK(BRITER_RS485_Config_Add(&config, BRITER_RS485_RETURN_TIME_ADDR, 20) == HAL_OK);
+    CHECK(config.count == 4);
+    CHECK(BRITER_RS485_Config_Commit(&handler, &config) == HAL_OK);
+    //Mode and return time in one frame, direction alone, address last
+    CHECK(sniff_count == 3);
+    CHECK(sniff[0].address == 1 && sniff[0].func == 0x10 && sniff[0].reg == BRITER_RS485_MODE_ADDR && sniff[0].count == 2);
+    CHECK(sniff[1].address == 1 && sniff[1].func == 0x06 && sniff[1].reg == BRITER_RS485_INCREASING_DIRECTION_ADDR);
+    CHECK(sniff[2].address == 1 && sniff[2].func == 0x06 && sniff[2].reg == BRITER_RS485_ADDRESS_ADDR && sniff[2].count == 5);
+    CHECK(encoder.return_time == 20 && encoder.direction == 1 && encoder.address == 5);
+    CHECK(handler.addr == 5);
+    CHECK(BRITER_RS485_Shadow_Get(&handler, BRITER_RS485_RETURN_TIME_ADDR, &value) == HAL_OK && value == 20);
+    //Encoder hold every value, nothing left to send
+    sniff_count = 0;
+    CHECK(BRITER_RS485_Config_Commit(&handler, &config) == HAL_OK);
+    CHECK(sniff_count == 0);
+}
+
+static void Test_Echo(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_Encoder_t handler;
+    Briter_RS485_Config_t config;
+    uint16_t value;
+    Setup(&encoder, &handler);
+    encoder.drop_ppm = 1000000;
+    bad_echo = 1;
+    BRITER_RS485_Config_Begin(&config);
+    BRITER_RS485_Config_Add(&config, BRITER_RS485_RETURN_TIME_ADDR, 30);
+    BRITER_RS485_Config_Add(&config, BRITER_RS485_INCREASING_DIRECTION_ADDR, RS485_ENC_DIRECTION_COUNTERCLOCKWISE);
+    //Stop at first frame not echoed as sent, setting stay unknown
+    CHECK(BRITER_RS485_Config_Commit(&handler, &config) == HAL_ERROR);
+    CHECK(sniff_count == 1);
+    CHECK(BRITER_RS485_Shadow_Get(&handler, BRITER_RS485_RETURN_TIME_ADDR, &value) != HAL_OK);
+    //Right echo, whole transaction is sent again
+    encoder.drop_ppm = 0;
+    bad_echo = 0;
+    sniff_count = 0;
+    CHECK(BRITER_RS485_Config_Commit(&handler, &config) == HAL_OK);
+    CHECK(sniff_count == 2);
+    CHECK(encoder.return_time == 30 && encoder.direction == 1);
+}
+
+static void Test_ReadBlock(void) {
+    Briter_Host_Encoder_t encoder;
+    Briter_Encoder_t handler;
+    Briter_RS485_State_t state;
+    uint16_t value[BRITER_RS485_READ_MAX + 1];
+    Setup(&encoder, &handler);
+    //Count out of range never reach the line
+    CHECK(BRITER_RS485_ReadBlock(&handler, BRITER_RS485_VALUE_ADDR, 0, value) == HAL_ERROR);
+    CHECK(BRITER_RS485_ReadBlock(&handler, BRITER_RS485_VALUE_ADDR, BRITER_RS485_READ_MAX + 1, value) == HAL_ERROR);
+    CHECK(sniff_count == 0);
+    //Whole register map of encoder in one frame
+    CHECK(BRITER_RS485_ReadBlock(&handler, BRITER_RS485_VALUE_ADDR, BRITER_RS485_READ_MAX, value) == HAL_OK);
+    CHECK(sniff_count == 1 && sniff[0].func == 0x03 && sniff[0].count == BRITER_RS485_READ_MAX);
+    CHECK(value[BRITER_RS485_ADDRESS_ADDR] == 1 && value[BRITER_RS485_RETURN_TIME_ADDR] == encoder.return_time);
+    //Past last register, encoder answer exception
+    CHECK(BRITER_RS485_ReadBlock(&handler, BRITER_RS485_SET_MUL_5_ADDR, 2, value) == HAL_ERROR);
+    //Value above 16 bit, high word first
+    uint32_t position = 20 * encoder.ppr + 77;
+    BRITER_Host_Encoder_SetMotion(&encoder, position, 0);
+    CHECK(BRITER_RS485_GetState(&handler, &state) == HAL_OK);
+    CHECK(state.value == position && state.turn == 20 && state.single_turn == 77);
+    //Value register lead the block, kept as latest sample
+    CHECK(handler.encoder_value == position);
+}
+
+int main(void) {
+    Test_Commit();
+    Test_Echo();
+    Test_ReadBlock();
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
@@ -0,0 +1,129 @@
+/**
+ * @file   test_rs485_pipeline.c
+ * @brief  Read per second of bus scheduler against modeled bus time, with
+ *         and without pipeline, under late TX complete interrupt and with
+ *         no inter-frame timer.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include "briter_encoder_rs485_bus.h"
+#include "briter_host_encoder.h"
+#include "briter_test.h"
+
+#define ENCODER_COUNT	4
+#define RUN_MS		1000
+
+static UART_HandleTypeDef huart;
+static DMA_HandleTypeDef hdma_tx;
+static DMA_HandleTypeDef hdma_rx;
+static Briter_RS485_Bus_t bus;
+static uint8_t use_timer;
+
+void HAL_UART_TxCpltCallback(UART_HandleTypeDef *h) {
+    BRITER_RS485_Bus_TxCpltCallback(&bus, h);
+}
+
+void HAL_UARTEx_RxEventCallback(UART_HandleTypeDef *h, uint16_t Size) {
+    BRITER_RS485_Bus_RxEventCallback(&bus, h, Size);
+}
+
+void HAL_UART_ErrorCallback(UART_HandleTypeDef *h) {
+    BRITER_RS485_Bus_ErrorCallback(&bus, h);
+}
+
+static void Bus_Timer(void *context) {
+    BRITER_RS485_Bus_TimerCallback((Briter_RS485_Bus_t*) context);
+}
+
+//One shot timer of inter-frame gap, as default weak one when turned off
+uint8_t BRITER_RS485_Bus_StartTimer(Briter_RS485_Bus_t *b, uint32_t delay_us) {
+    if (!use_timer)
+	return 0;
+    return BRITER_Host_Schedule(delay_us, Bus_Timer, b) == HAL_OK;
+}
+
+/**
+ * @brief  Poll every encoder for RUN_MS.
+ * @param  bps line baudrate
+ * @param  pipeline 1 for pipeline mode
+ * @param  irq_us TX complete interrupt latency
+ * @param  fail number of failed read
+ * @param  line line statistic
+ * @retval read per second
+ */
+static double Run(uint32_t bps, uint8_t pipeline, uint32_t irq_us, uint32_t *fail, Briter_Host_Line_Stats_t *line) {
+    static Briter_Host_Encoder_t encoder[ENCODER_COUNT];
+    static Briter_Encoder_t handler[ENCODER_COUNT];
+    Briter_Stats_t stats;
+    uint32_t ok = 0;
+    *fail = 0;
+    BRITER_Host_Reset();
+    BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, bps);
+    BRITER_Host_UART_SetIrqLatency(&huart, irq_us);
+    //Timeout well above one transaction at 9600
+    BRITER_RS485_Bus_Init(&bus, &huart, 50);
+    for (uint8_t i = 0; i < ENCODER_COUNT; i++) {
+	BRITER_Host_Encoder_Init(&encoder[i], (uint8_t) (i + 1));
+	//Reply start exactly t3.5 after request, as the model
+	encoder[i].latency_us = 0;
+	BRITER_Host_Encoder_Attach_RS485(&encoder[i], &huart);
+	BRITER_RS485_Init(&handler[i], (uint8_t) (i + 1), &huart);
+	BRITER_RS485_Bus_Add(&bus, &handler[i], 0);
+    }
+    BRITER_RS485_Bus_SetPipeline(&bus, pipeline);
+    BRITER_RS485_Bus_Start(&bus);
+    for (uint32_t ms = 0; ms < RUN_MS; ms++) {
+	BRITER_Host_Run(1000);
+	BRITER_RS485_Bus_Process(&bus);
+    }
+    BRITER_RS485_Bus_Stop(&bus);
+    BRITER_Host_UART_GetStats(&huart, line);
+    //Mode is never changed behind user back
+    CHECK(bus.pipeline == pipeline);
+    for (uint8_t i = 0; i < ENCODER_COUNT; i++) {
+	BRITER_RS485_GetStats(&handler[i], &stats);
+	ok += stats.count[BRITER_STATS_OK];
+	for (uint8_t k = BRITER_STATS_TX_TIMEOUT; k < BRITER_STATS_CLASS_COUNT; k++)
+	    *fail += stats.count[k];
+    }
+    return ok * 1000.0 / RUN_MS;
+}
+
+int main(void) {
+    Briter_Host_Line_Stats_t line;
+    uint32_t fail;
+    //throughput,<mode>,<bps>,<irq us>,<read/s>,<modeled read/s>,<ratio>,<failed read>
+    for (uint8_t b = RS485_ENC_BAUDRATE_9600; b <= RS485_ENC_BAUDRATE_115200; b++) {
+	uint32_t bps = BRITER_RS485_BaudrateValue((RS485_Enc_Baudrate_e) b);
+	//Request, t3.5, response, t3.5
+	uint32_t model_us = BRITER_RS485_FrameTime_us(bps, BRITER_RS485_QUERY_FRAME_SIZE) + BRITER_RS485_FrameTime_us(bps, BRITER_RS485_READ_FRAME_SIZE(2))
+		+ 2 * BRITER_RS485_T35_us(bps);
+	double model = 1000000.0 / model_us;
+	for (uint8_t pipeline = 0; pipeline <= 1; pipeline++) {
+	    //TX complete served after response has started
+	    const uint32_t irq_us[] = { 0, BRITER_RS485_T35_us(bps) + 2 * BRITER_RS485_FrameTime_us(bps, 1) };
+	    for (uint8_t k = 0; k < 2; k++) {
+		use_timer = 1;
+		double rate = Run(bps, pipeline, irq_us[k], &fail, &line);
+		printf("throughput,%s,%lu,%lu,%.1f,%.1f,%.3f,%lu\n", pipeline ? "pipeline" : "single", (unsigned long) bps, (unsigned long) irq_us[k], rate,
+			model, rate / model, (unsigned long) fail);
+		//Within a few percent of bus limit and never above it, late interrupt cost nothing
+		CHECK(rate >= 0.97 * model);
+		CHECK(rate <= 1.01 * model);
+		CHECK(fail == 0);
+		//t3.5 kept, within microsecond rounding of gap
+		CHECK(line.tx_gap_min_ns + 1000 >= BRITER_RS485_T35_us(bps) * 1000ULL);
+	    }
+	}
+	//No timer, request wait for process tick after t3.5
+	use_timer = 0;
+	double rate = Run(bps, 1, 0, &fail, &line);
+	printf("throughput,pipeline_no_timer,%lu,0,%.1f,%.1f,%.3f,%lu\n", (unsigned long) bps, rate, model, rate / model, (unsigned long) fail);
+	CHECK(rate > 0);
+	CHECK(fail == 0);
+	CHECK(line.tx_gap_min_ns + 1000 >= BRITER_RS485_T35_us(bps) * 1000ULL);
+    }
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
@@ -0,0 +1,91 @@
+/**
+ * @file   test_unwrap.c
+ * @brief  Unwrap across modulus, warm restart through Save and Restore, and
+ *         rejection of corrupted or foreign backup.
+ * @author Ang Chin Xian
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include "briter_encoder_unwrap.h"
+#include "briter_test.h"
+
+/**
+ * @brief  Move by step count at a time, feed every raw value.
+ * @param  unwrap unwrap handler
+ * @param  position true continuous position, updated
+ * @param  step count per sample, below half modulus
+ * @param  count number of sample
+ * @retval none
+ */
+static void Move(Briter_Unwrap_t *unwrap, int64_t *position, int32_t step, uint32_t count) {
+    int64_t span = unwrap->modulus ? (int64_t) unwrap->modulus : (int64_t) 1 << 32;
+    for (uint32_t i = 0; i < count; i++) {
+	*position += step;
+	uint32_t raw = (uint32_t) (((*position % span) + span) % span);
+	CHECK(BRITER_Unwrap_Update(unwrap, raw) == *position);
+    }
+}
+
+static void Test_RoundTrip(uint32_t modulus, int64_t start, int32_t step) {
+    Briter_Unwrap_t unwrap;
+    Briter_Unwrap_t restored;
+    Briter_Unwrap_Backup_t backup;
+    int64_t span = modulus ? (int64_t) modulus : (int64_t) 1 << 32;
+    int64_t position = start;
+    CHECK(BRITER_Unwrap_Init(&unwrap, modulus) == HAL_OK);
+    //Nothing fed yet, no turn to save
+    CHECK(BRITER_Unwrap_Save(&unwrap, &backup) == HAL_ERROR);
+    //First value start at turn 0
+    CHECK(BRITER_Unwrap_Update(&unwrap, (uint32_t) start) == start);
+    //Several turn away from start, both direction
+    Move(&unwrap, &position, step, 40);
+    Move(&unwrap, &position, -step, 100);
+    CHECK(position < 0 && position / span <= -2);
+    CHECK(BRITER_Unwrap_Save(&unwrap, &backup) == HAL_OK);
+    CHECK(backup.turn == (int32_t) ((position - (int64_t) backup.last_raw) / span));
+
+    //Warm restart, first value after restore continue the saved turn, motion
+    //while off across wrap included
+    CHECK(BRITER_Unwrap_Init(&restored, modulus) == HAL_OK);
+    CHECK(BRITER_Unwrap_Restore(&restored, &backup) == HAL_OK);
+    CHECK(BRITER_Unwrap_GetPosition(&restored) == position);
+    Move(&restored, &position, step, 30);
+    Move(&restored, &position, -step, 10);
+}
+
+static void Test_Reject(void) {
+    Briter_Unwrap_t unwrap;
+    Briter_Unwrap_Backup_t backup;
+    Briter_Unwrap_Backup_t bad;
+    int64_t position = 0;
+    BRITER_Unwrap_Init(&unwrap, 4096);
+    BRITER_Unwrap_Update(&unwrap, 0);
+    Move(&unwrap, &position, -1500, 20);
+    CHECK(BRITER_Unwrap_Save(&unwrap, &backup) == HAL_OK);
+    //Any flipped bit of turn, raw or CRC is caught
+    for (uint32_t bit = 0; bit < 8 * (sizeof(int32_t) + sizeof(uint32_t)); bit++) {
+	memcpy(&bad, &backup, sizeof(bad));
+	((uint8_t*) &bad)[bit / 8] ^= (uint8_t) (1U << (bit % 8));
+	BRITER_Unwrap_Init(&unwrap, 4096);
+	CHECK(BRITER_Unwrap_Restore(&unwrap, &bad) == HAL_ERROR);
+	CHECK(!unwrap.initialized);
+    }
+    memcpy(&bad, &backup, sizeof(bad));
+    bad.crc ^= 0x0100;
+    CHECK(BRITER_Unwrap_Restore(&unwrap, &bad) == HAL_ERROR);
+    //Backup of other encoder model
+    BRITER_Unwrap_Init(&unwrap, 4096 * 24);
+    CHECK(BRITER_Unwrap_Restore(&unwrap, &backup) == HAL_ERROR);
+    //Rejected restore leave cold start, first value at turn 0
+    CHECK(BRITER_Unwrap_Update(&unwrap, 123) == 123);
+}
+
+int main(void) {
+    Test_RoundTrip(4096, 100, 1500);
+    Test_RoundTrip(4096 * 24, 98000, 40000);
+    Test_RoundTrip(0, 0xFFFFF000, 0x70000000);
+    Test_Reject();
+    printf(failed ? "FAIL\n" : "PASS\n");
+    return failed;
+}
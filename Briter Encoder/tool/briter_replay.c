@@ -0,0 +1,236 @@
+/**
+ * @file   briter_replay.c
+ * @brief  Linux replay of Briter record capture through simulated HAL, at
+ *         original or accelerated speed.
+ * @author Ang Chin Xian
+ *
+ * Every address of capture become a virtual encoder on simulated CAN bus
+ * or RS485 line, moved to recorded position at recorded tick and read back
+ * by the driver. Failed read in capture is replayed as lost request.
+ *
+ * usage: briter_replay [-t can|rs485] [-b bps] [-s speed] capture
+ *   -t  transport, default can
+ *   -b  bit rate, default 500000 for CAN, 115200 for RS485
+ *   -s  1 original speed (default), 10 ten time faster, 0 no wait
+ *
+ * Output CSV
+ *   sample,<tick>,<address>,<recorded result>,<replayed result>,<recorded position>,<replayed position>
+ *   replay,<sample>,<mismatch>,<bad block>,<skipped>
+ * Exit 0 if every replayed sample match capture.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include "briter_encoder_rs485.h"
+#include "briter_encoder_can.h"
+#include "briter_encoder_record.h"
+#include "briter_host_encoder.h"
+
+/** Virtual encoder and driver handler of one recorded address*/
+typedef struct {
+    uint8_t address;
+    Briter_Host_Encoder_t encoder;
+    Briter_Encoder_t rs485;
+    Briter_CAN_Handler_t can;
+} Replay_Node_t;
+
+static Replay_Node_t node[BRITER_RECORD_MAX_CHANNEL];
+static uint8_t node_count;
+static uint8_t use_can = 1;
+static UART_HandleTypeDef huart;
+static DMA_HandleTypeDef hdma_tx;
+static DMA_HandleTypeDef hdma_rx;
+static CAN_HandleTypeDef hcan;
+static volatile uint8_t can_received;
+
+void HAL_CAN_RxFifo0MsgPendingCallback(CAN_HandleTypeDef *h) {
+    CAN_RxHeaderTypeDef header;
+    uint8_t data[8];
+    if (HAL_CAN_GetRxMessage(h, CAN_RX_FIFO0, &header, data) == HAL_OK && BRITER_CAN_Dispatch(h, &header, data) != NULL)
+	can_received = 1;
+}
+
+/**
+ * @brief  Node of address, virtual encoder and driver are set up on first use.
+ * @param  address recorded address
+ * @retval node, NULL if every node is taken
+ */
+static Replay_Node_t* Replay_Node(uint8_t address) {
+    for (uint8_t i = 0; i < node_count; i++) {
+	if (node[i].address == address)
+	    return &node[i];
+    }
+    if (node_count >= BRITER_RECORD_MAX_CHANNEL)
+	return NULL;
+    Replay_Node_t *n = &node[node_count++];
+    n->address = address;
+    BRITER_Host_Encoder_Init(&n->encoder, address);
+    if (use_can) {
+	BRITER_Host_Encoder_Attach_CAN(&n->encoder, &hcan);
+	BRITER_CAN_Init(&n->can, address, &hcan);
+	BRITER_CAN_Register(&n->can);
+	BRITER_CAN_ConfigFilter(&hcan, CAN_FILTER_FIFO0, 0, 4);
+    }
+    else {
+	BRITER_Host_Encoder_Attach_RS485(&n->encoder, &huart);
+	BRITER_RS485_Init(&n->rs485, address, &huart);
+    }
+    return n;
+}
+
+/**
+ * @brief  Read node through driver.
+ * @param  n node
+ * @param  position output position if read is valid
+ * @retval result class of read
+ */
+static Briter_Stats_Class_e Replay_Read(Replay_Node_t *n, uint32_t *position) {
+    if (use_can) {
+	uint32_t age;
+	can_received = 0;
+	if (BRITER_CAN_ReadValue(&n->can) != HAL_OK)
+	    return BRITER_STATS_TX_TIMEOUT;
+	if (!BRITER_Host_RunUntil(&can_received, 10000))
+	    return BRITER_STATS_RX_TIMEOUT;
+	BRITER_CAN_GetLatest(&n->can, position, &age);
+	return BRITER_STATS_OK;
+    }
+    Briter_Stats_t before;
+    Briter_Stats_t after;
+    BRITER_RS485_GetStats(&n->rs485, &before);
+    *position = BRITER_RS485_GetEncoderValue(&n->rs485);
+    BRITER_RS485_GetStats(&n->rs485, &after);
+    for (uint8_t i = BRITER_STATS_OK; i < BRITER_STATS_CLASS_COUNT; i++) {
+	if (after.count[i] != before.count[i])
+	    return (Briter_Stats_Class_e) i;
+    }
+    return BRITER_STATS_MISMATCH;
+}
+
+/**
+ * @brief  Hold until wall clock catch up with simulated time.
+ * @param  start wall clock at replay start
+ * @param  speed replay speed, 0 for no wait
+ * @retval none
+ */
+static void Replay_Pace(const struct timespec *start, double speed) {
+    struct timespec now;
+    if (speed <= 0)
+	return;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double due_ns = (double) BRITER_Host_Time_ns() / speed;
+    double elapsed_ns = (double) (now.tv_sec - start->tv_sec) * 1e9 + (double) (now.tv_nsec - start->tv_nsec);
+    if (due_ns > elapsed_ns) {
+	double wait_ns = due_ns - elapsed_ns;
+	struct timespec wait = { (time_t) (wait_ns / 1e9), (long) (wait_ns - (double) (time_t) (wait_ns / 1e9) * 1e9) };
+	nanosleep(&wait, NULL);
+    }
+}
+
+/**
+ * @brief  Load whole capture file.
+ * @param  path file path
+ * @param  size output size
+ * @retval capture, NULL on error
+ */
+static uint8_t* Replay_Load(const char *path, uint32_t *size) {
+    FILE *file = fopen(path, "rb");
+    if (file == NULL) {
+	perror(path);
+	return NULL;
+    }
+    fseek(file, 0, SEEK_END);
+    long len = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    uint8_t *data = (len > 0) ? (uint8_t*) malloc((size_t) len) : NULL;
+    if (data == NULL || fread(data, 1, (size_t) len, file) != (size_t) len) {
+	fprintf(stderr, "%s: cannot read capture\n", path);
+	free(data);
+	fclose(file);
+	return NULL;
+    }
+    fclose(file);
+    *size = (uint32_t) len;
+    return data;
+}
+
+int main(int argc, char *argv[]) {
+    uint32_t bps = 0;
+    double speed = 1;
+    int opt;
+    while ((opt = getopt(argc, argv, "t:b:s:")) != -1) {
+	switch (opt) {
+	case 't':
+	    use_can = (strcmp(optarg, "rs485") != 0);
+	    break;
+	case 'b':
+	    bps = (uint32_t) strtoul(optarg, NULL, 10);
+	    break;
+	case 's':
+	    speed = strtod(optarg, NULL);
+	    break;
+	default:
+	    optind = argc + 1;
+	    break;
+	}
+    }
+    if (optind != argc - 1) {
+	fprintf(stderr, "usage: %s [-t can|rs485] [-b bps] [-s speed] capture\n", argv[0]);
+	return 2;
+    }
+    uint32_t size;
+    uint8_t *data = Replay_Load(argv[optind], &size);
+    if (data == NULL)
+	return 2;
+
+    BRITER_Host_Reset();
+    if (use_can) {
+	BRITER_Host_CAN_Init(&hcan, bps ? bps : 500000);
+	HAL_CAN_ActivateNotification(&hcan, CAN_IT_RX_FIFO0_MSG_PENDING);
+    }
+    else
+	BRITER_Host_UART_Init(&huart, &hdma_tx, &hdma_rx, bps ? bps : 115200);
+
+    Briter_Replay_t rep;
+    Briter_Record_Sample_t sample;
+    uint32_t count = 0;
+    uint32_t mismatch = 0;
+    uint32_t skipped = 0;
+    uint32_t base = 0;
+    struct timespec start;
+    BRITER_Replay_Init(&rep, data, size);
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    while (BRITER_Replay_Next(&rep, &sample) == HAL_OK) {
+	if (count++ == 0)
+	    base = sample.timestamp;
+	//Recorded tick is ms, read late if line is still busy with previous one
+	uint64_t due_us = (uint64_t) (uint32_t) (sample.timestamp - base) * 1000ULL;
+	while (BRITER_Host_Time_us() < due_us) {
+	    uint64_t left = due_us - BRITER_Host_Time_us();
+	    BRITER_Host_Run(left > 1000000 ? 1000000 : (uint32_t) left);
+	}
+	Replay_Pace(&start, speed);
+	Replay_Node_t *n = Replay_Node(sample.address);
+	if (n == NULL) {
+	    skipped++;
+	    continue;
+	}
+	uint32_t position = 0;
+	n->encoder.drop_ppm = (sample.result == BRITER_STATS_OK) ? 0 : 1000000;
+	if (sample.result == BRITER_STATS_OK)
+	    BRITER_Host_Encoder_SetMotion(&n->encoder, sample.position, 0);
+	Briter_Stats_Class_e result = Replay_Read(n, &position);
+	if (result != BRITER_STATS_OK)
+	    position = 0;
+	if ((result == BRITER_STATS_OK) != (sample.result == BRITER_STATS_OK) || (result == BRITER_STATS_OK && position != sample.position))
+	    mismatch++;
+	printf("sample,%lu,%u,%u,%u,%lu,%lu\n", (unsigned long) sample.timestamp, sample.address, sample.result, result,
+		(unsigned long) (sample.result == BRITER_STATS_OK ? sample.position : 0), (unsigned long) position);
+    }
+    printf("replay,%lu,%lu,%lu,%lu\n", (unsigned long) count, (unsigned long) mismatch, (unsigned long) rep.bad_block_count, (unsigned long) skipped);
+    free(data);
+    return (mismatch || skipped) ? 1 : 0;
+}